@@ -1,148 +1,445 @@
 namespace UnsafeYT{
-    std::string trim(const std::string& str) {
-        size_t first = str.find_first_not_of(" \n\r\t");
-        if (std::string::npos == first) {
-            return str;
-        }
-        size_t last = str.find_last_not_of(" \n\r\t");
-        return str.substr(first, (last - first + 1));
-    }
+    namespace detail {
+        // Sine oscillator held as eight phasors, one per lane and each one sample apart. A step
+        // rotates all of them by eight samples with a single complex multiply, so the inner loop
+        // is plain float SIMD. The phasors are re-seeded from the exact phase at the start of
+        // every block, so rounding error never builds up over a long file.
+        struct SineOscillator {
+            double frequency = 0.0;
+            int sample_rate = 44100;
+            int64_t position = 0;
 
-    std::string exec(const std::string& cmd) {
-        std::array<char, 128> buffer;
-        std::string result;
+            void Render(RemapKernel kernel, float* dst, int count, float gain, bool accumulate) {
+                alignas(32) float re[8];
+                alignas(32) float im[8];
+                for (int lane = 0; lane < 8; lane++) {
+                    double phase = 2.0 * M_PI * this->Cycles(this->position + lane);
+                    re[lane] = static_cast<float>(gain * std::cos(phase));
+                    im[lane] = static_cast<float>(gain * std::sin(phase));
+                }
+                double step = 2.0 * M_PI * 8.0 * this->frequency / this->sample_rate;
+                float step_re = static_cast<float>(std::cos(step));
+                float step_im = static_cast<float>(std::sin(step));
+
+                int done = 0;
+            #if defined(__x86_64__) || defined(__i386__)
+                if (kernel == RemapKernel::AVX2) {
+                    done = render_sine_avx(re, im, step_re, step_im, dst, count, accumulate);
+                }
+            #elif defined(__aarch64__)
+                if (kernel == RemapKernel::NEON) {
+                    done = render_sine_neon(re, im, step_re, step_im, dst, count, accumulate);
+                }
+            #endif
+                for (int i = done; i < count; i += 8) {
+                    for (int lane = 0; lane < 8 && i + lane < count; lane++) {
+                        dst[i + lane] = accumulate ? dst[i + lane] + im[lane] : im[lane];
+                    }
+                    for (int lane = 0; lane < 8; lane++) {
+                        float r = re[lane] * step_re - im[lane] * step_im;
+                        im[lane] = re[lane] * step_im + im[lane] * step_re;
+                        re[lane] = r;
+                    }
+                }
+                this->position += count;
+            }
 
+            // Phase in cycles, split into whole seconds and the remainder so the product stays
+            // exact for integer frequencies however long the file is.
+            double Cycles(int64_t sample) const {
+                double whole = std::fmod(this->frequency * static_cast<double>(sample / this->sample_rate), 1.0);
+                double part = this->frequency * static_cast<double>(sample % this->sample_rate) / this->sample_rate;
+                return std::fmod(whole + part, 1.0);
+            }
 
-        FILE* pipe = popen(cmd.c_str(), "r");
+        #if defined(__x86_64__) || defined(__i386__)
+            __attribute__((target("avx")))
+            static int render_sine_avx(float* re, float* im, float step_re, float step_im, float* dst, int count, bool accumulate) {
+                __m256 r = _mm256_load_ps(re);
+                __m256 i = _mm256_load_ps(im);
+                const __m256 c = _mm256_set1_ps(step_re);
+                const __m256 s = _mm256_set1_ps(step_im);
+                int x = 0;
+                for (; x + 8 <= count; x += 8) {
+                    __m256 out = accumulate ? _mm256_add_ps(_mm256_loadu_ps(dst + x), i) : i;
+                    _mm256_storeu_ps(dst + x, out);
+                    __m256 next_r = _mm256_sub_ps(_mm256_mul_ps(r, c), _mm256_mul_ps(i, s));
+                    i = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_mul_ps(i, c));
+                    r = next_r;
+                }
+                _mm256_store_ps(re, r);
+                _mm256_store_ps(im, i);
+                return x;
+            }
+        #endif
 
-        if (!pipe) {
-            throw std::runtime_error("Failed to open pipe for command: " + cmd);
-        }
+        #if defined(__aarch64__)
+            static int render_sine_neon(float* re, float* im, float step_re, float step_im, float* dst, int count, bool accumulate) {
+                float32x4_t r[2] = {vld1q_f32(re), vld1q_f32(re + 4)};
+                float32x4_t i[2] = {vld1q_f32(im), vld1q_f32(im + 4)};
+                int x = 0;
+                for (; x + 8 <= count; x += 8) {
+                    for (int h = 0; h < 2; h++) {
+                        float32x4_t out = accumulate ? vaddq_f32(vld1q_f32(dst + x + 4 * h), i[h]) : i[h];
+                        vst1q_f32(dst + x + 4 * h, out);
+                        float32x4_t next_r = vsubq_f32(vmulq_n_f32(r[h], step_re), vmulq_n_f32(i[h], step_im));
+                        i[h] = vaddq_f32(vmulq_n_f32(r[h], step_im), vmulq_n_f32(i[h], step_re));
+                        r[h] = next_r;
+                    }
+                }
+                vst1q_f32(re, r[0]); vst1q_f32(re + 4, r[1]);
+                vst1q_f32(im, i[0]); vst1q_f32(im + 4, i[1]);
+                return x;
+            }
+        #endif
+        };
 
-        try {
-            while (fgets(buffer.data(), buffer.size(), pipe) != nullptr) {
-                result += buffer.data();
+        // dst = src * gain + add
+    #if defined(__x86_64__) || defined(__i386__)
+        __attribute__((target("avx")))
+        inline int mix_scaled_avx(float* dst, const float* src, float gain, const float* add, int count) {
+            const __m256 g = _mm256_set1_ps(gain);
+            int x = 0;
+            for (; x + 8 <= count; x += 8) {
+                __m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + x), g);
+                _mm256_storeu_ps(dst + x, _mm256_add_ps(v, _mm256_loadu_ps(add + x)));
             }
-        } catch (...) {
-            pclose(pipe);
+            return x;
+        }
 
-            throw;
+        __attribute__((target("sse4.1")))
+        inline int mix_scaled_sse(float* dst, const float* src, float gain, const float* add, int count) {
+            const __m128 g = _mm_set1_ps(gain);
+            int x = 0;
+            for (; x + 4 <= count; x += 4) {
+                __m128 v = _mm_mul_ps(_mm_loadu_ps(src + x), g);
+                _mm_storeu_ps(dst + x, _mm_add_ps(v, _mm_loadu_ps(add + x)));
+            }
+            return x;
         }
+    #endif
 
-        int status = 0;
-        status = pclose(pipe);
+    #if defined(__aarch64__)
+        inline int mix_scaled_neon(float* dst, const float* src, float gain, const float* add, int count) {
+            int x = 0;
+            for (; x + 4 <= count; x += 4) {
+                vst1q_f32(dst + x, vmlaq_n_f32(vld1q_f32(add + x), vld1q_f32(src + x), gain));
+            }
+            return x;
+        }
+    #endif
 
-        if (status != 0) {
-            std::string error_message = "Command exited with non-zero status: " + std::to_string(status);
-            error_message += "\nCommand: " + cmd;
-            error_message += "\nChild process stderr:\n" + result;
-            throw std::runtime_error(error_message);
+        inline void mix_scaled(RemapKernel kernel, float* dst, const float* src, float gain, const float* add, int count) {
+            int done = 0;
+            switch (kernel) {
+            #if defined(__x86_64__) || defined(__i386__)
+                case RemapKernel::AVX2: done = mix_scaled_avx(dst, src, gain, add, count); break;
+                case RemapKernel::SSE41: done = mix_scaled_sse(dst, src, gain, add, count); break;
+            #endif
+            #if defined(__aarch64__)
+                case RemapKernel::NEON: done = mix_scaled_neon(dst, src, gain, add, count); break;
+            #endif
+                default: break;
+            }
+            for (int x = done; x < count; x++) {
+                dst[x] = src[x] * gain + add[x];
+            }
         }
-        return result;
     }
 
-
-    void mixAudioAndAddSine(
-        std::string input_video_path,
-        std::string source_audio_video_path,
-        std::string output_video_path,
-        double frequency = 600.0,
-        double amplitude = 0.1 
-    ) {
-        if (!std::filesystem::exists(input_video_path)) {
-            std::cerr << "Error: Input video file '" << input_video_path << "' does not exist." << std::endl;
-            return;
+    // Audio track of the output file: the source audio at 0.03 gain plus two sine tones,
+    // encoded to AAC into the same muxer as the video. It reproduces what the old ffmpeg
+    // command line did: lavfi `sine` tones (amplitude 1/8) at `amplitude` gain, summed by an
+    // amix that halves each of them, the source added on top without normalization, and the
+    // result cut to the shorter of the video and the source file.
+    // The source is demuxed on its own with every other stream discarded, so the video
+    // samples are skipped rather than read a second time.
+    class AudioTrack {
+    public:
+        ~AudioTrack() {
+            this->Close();
         }
-        if (!std::filesystem::exists(source_audio_video_path)) {
-            std::cerr << "Error: Source audio video file '" << source_audio_video_path << "' does not exist." << std::endl;
-            return;
+
+        // Frees the track so it can be opened again for another file.
+        void Close() {
+            av_packet_free(&packet);
+            av_frame_free(&decoded);
+            av_frame_free(&mixed);
+            swr_free(&swr);
+            if (decoder) avcodec_free_context(&decoder);
+            if (encoder) avcodec_free_context(&encoder);
+            if (source_fmt_ctx) avformat_close_input(&source_fmt_ctx);
+            this->out_fmt_ctx = nullptr;
+            this->stream = nullptr;
+            this->source_stream = -1;
+            this->duration = 0.0;
+            this->source_done = false;
+            this->failed = false;
+            this->total = 0;
+            this->written = 0;
+            this->tones = {};
+            this->pending.clear();
+            this->pending_offset = 0;
         }
 
-        try {
-            #ifdef _WIN32
-                std::string cmd_duration = "ffprobe.exe -v error -show_entries format=duration -of default=noprint_wrappers=1:nokey=1 \"" + source_audio_video_path + "\"";
-            #else
-                std::string cmd_duration = "ffprobe -v error -show_entries format=duration -of default=noprint_wrappers=1:nokey=1 \"" + source_audio_video_path + "\"";
-            #endif
+        // Adds the audio stream to out_fmt_ctx; call before avformat_write_header. An empty
+        // source path writes the tones only, for as long as the video lasts.
+        int Open(const std::string& source_path, AVFormatContext* out_fmt_ctx) {
+            try {
+                this->out_fmt_ctx = out_fmt_ctx;
+                if (source_path.empty()) {
+                    std::cout << "Info: No source audio for streamed input; writing the tones only." << std::endl;
+                } else {
+                    this->OpenSource(source_path);
+                }
+                this->OpenEncoder();
+            }
+            catch (const std::runtime_error& e) {
+                std::cerr << "Audio Error: " << e.what() << std::endl;
+                return -1;
+            }
+
+            for (SineOscillator& tone : this->tones) tone.sample_rate = this->encoder->sample_rate;
+            this->tones[0].frequency = this->frequency + 6000;
+            this->tones[1].frequency = this->frequency + 15000;
+            this->tone_gain = static_cast<float>(this->amplitude * 0.125 * 0.5);
+            this->total = this->source_fmt_ctx ? std::llround(this->duration * this->encoder->sample_rate) : std::numeric_limits<int64_t>::max();
+            return 0;
+        }
 
-            std::string duration_str = exec(cmd_duration);
-            double duration = 0.0;
+        // Encodes audio up to `seconds` of output time, called as video frames are written so
+        // the muxer only ever holds a frame or two of either stream.
+        // A failure is reported once and ends the track; the video keeps going.
+        void WriteUntil(double seconds) {
+            if (this->failed || !this->encoder) return;
+            int64_t target = std::min(this->total, static_cast<int64_t>(std::ceil(seconds * this->encoder->sample_rate)));
             try {
-                duration = std::stod(trim(duration_str));
-            } catch (const std::exception& e) {
-                std::cerr << "Warning: Could not parse duration from '" << duration_str << "'. Defaulting to 0.0. Error: " << e.what() << std::endl;
-                duration = 0.0;
+                while (this->written < target) {
+                    int count = static_cast<int>(std::min<int64_t>(this->encoder->frame_size, this->total - this->written));
+                    this->EncodeAudio(this->written, count);
+                    this->written += count;
+                }
+            }
+            catch (const std::runtime_error& e) {
+                std::cerr << "Audio Error: " << e.what() << std::endl;
+                this->failed = true;
+            }
+        }
+
+        // -shortest: the audio ends where the video does.
+        void Finish(double video_seconds) {
+            if (!this->encoder) return;
+            this->total = std::min(this->total, static_cast<int64_t>(std::llround(video_seconds * this->encoder->sample_rate)));
+            this->WriteUntil(video_seconds);
+            avcodec_send_frame(this->encoder, NULL);
+            this->WritePackets();
+        }
+
+        double frequency = 600.0;
+        double amplitude = 0.1;
+
+    private:
+        using SineOscillator = detail::SineOscillator;
+
+        void OpenSource(const std::string& path) {
+            if (avformat_open_input(&this->source_fmt_ctx, path.c_str(), NULL, NULL) != 0 || avformat_find_stream_info(this->source_fmt_ctx, NULL) < 0) {
+                throw std::runtime_error("Could not open source audio video '" + path + "'.");
             }
-            
-            if (duration == 0.0) {
+            this->duration = this->source_fmt_ctx->duration > 0 ? static_cast<double>(this->source_fmt_ctx->duration) / AV_TIME_BASE : 0.0;
+            if (this->duration == 0.0) {
                 throw std::runtime_error("Could not determine duration of source audio video. Is the file valid?");
             }
 
-            
-            #ifdef _WIN32
-                std::string cmd_samplerate = "ffprobe.exe -v error -select_streams a:0 -show_entries stream=sample_rate -of default=noprint_wrappers=1:nokey=1 \"" + source_audio_video_path + "\"";
-            #else
-                std::string cmd_samplerate = "ffprobe -v error -select_streams a:0 -show_entries stream=sample_rate -of default=noprint_wrappers=1:nokey=1 \"" + source_audio_video_path + "\"";
-            #endif
+            const AVCodec* codec = nullptr;
+            this->source_stream = av_find_best_stream(this->source_fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+            for (unsigned int i = 0; i < this->source_fmt_ctx->nb_streams; i++) {
+                if (static_cast<int>(i) != this->source_stream) {
+                    this->source_fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+                }
+            }
+            if (this->source_stream < 0 || !codec) {
+                std::cout << "Info: Source audio video has no decodable audio stream; writing the tones only." << std::endl;
+                this->source_stream = -1;
+                return;
+            }
 
-            std::string samplerate_str = exec(cmd_samplerate);
-            int sample_rate = 44100;
-            bool has_source_audio = false;
+            this->decoder = avcodec_alloc_context3(codec);
+            if (!this->decoder) {
+                throw std::runtime_error("Failed to allocate audio decoder context.");
+            }
+            avcodec_parameters_to_context(this->decoder, this->source_fmt_ctx->streams[this->source_stream]->codecpar);
+            if (avcodec_open2(this->decoder, codec, NULL) < 0) {
+                throw std::runtime_error("Could not open audio decoder.");
+            }
+        }
 
-            try {
-                sample_rate = std::stoi(trim(samplerate_str));
-                has_source_audio = true;
-            } catch (const std::exception& e) {
-                std::cerr << "Info: Source audio video appears to have no audio stream or sample rate could not be determined. Error: " << e.what() << std::endl;
-                sample_rate = 44100;
-                has_source_audio = false;
-            }
-            
-            double freq1 = frequency + 6000;
-            double freq2 = frequency + 15000;
-
-            std::ostringstream ffmpeg_cmd_stream;
-
-            #ifdef _WIN32
-                ffmpeg_cmd_stream << "ffmpeg.exe -nostdin -loglevel error -i \"" << input_video_path << "\" ";
-            #else
-                ffmpeg_cmd_stream << "ffmpeg -i \"" << input_video_path << "\" ";
-            #endif
-            
-
-            ffmpeg_cmd_stream << "-i \"" << source_audio_video_path << "\" ";
-            ffmpeg_cmd_stream << "-f lavfi -i \"sine=frequency=" << freq1 << ":r=" << sample_rate << ":d=" << duration << "\" ";
-            ffmpeg_cmd_stream << "-f lavfi -i \"sine=frequency=" << freq2 << ":r=" << sample_rate << ":d=" << duration << "\" ";
-            ffmpeg_cmd_stream << "-filter_complex \"";
-
-            if (has_source_audio) {
-                ffmpeg_cmd_stream << "[1:a]volume=0.03[source_audio_scaled];"; 
-                ffmpeg_cmd_stream << "[2:a]volume=" << amplitude << "[sine1_vol];";
-                ffmpeg_cmd_stream << "[3:a]volume=" << amplitude << "[sine2_vol];";
-                ffmpeg_cmd_stream << "[sine1_vol][sine2_vol]amix=inputs=2:duration=longest:weights=1 1[sine_sum];";
-                ffmpeg_cmd_stream << "[source_audio_scaled][sine_sum]amix=inputs=2:duration=longest:normalize=0[final_audio]";
+        void OpenEncoder() {
+            const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_AAC);
+            if (!codec) {
+                throw std::runtime_error("Could not find AAC encoder.");
+            }
+            this->encoder = avcodec_alloc_context3(codec);
+            if (!this->encoder) {
+                throw std::runtime_error("Failed to allocate AAC encoder context.");
+            }
+            this->encoder->sample_fmt = AV_SAMPLE_FMT_FLTP;
+            this->encoder->sample_rate = this->decoder ? this->decoder->sample_rate : 44100;
+            if (this->decoder && this->decoder->ch_layout.nb_channels > 0) {
+                av_channel_layout_copy(&this->encoder->ch_layout, &this->decoder->ch_layout);
             } else {
-                ffmpeg_cmd_stream << "[1:a]volume=" << amplitude << "[sine1_vol];";
-                ffmpeg_cmd_stream << "[2:a]volume=" << amplitude << "[sine2_vol];";
-                ffmpeg_cmd_stream << "[sine1_vol][sine2_vol]amix=inputs=2:duration=longest:weights=1 1[final_audio]";
+                av_channel_layout_default(&this->encoder->ch_layout, 1);
+            }
+            this->encoder->bit_rate = 128'000;
+            this->encoder->time_base = (AVRational){1, this->encoder->sample_rate};
+            if (this->out_fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
+                this->encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+            }
+            if (avcodec_open2(this->encoder, codec, NULL) < 0) {
+                throw std::runtime_error("Could not open AAC encoder.");
+            }
+
+            this->stream = avformat_new_stream(this->out_fmt_ctx, NULL);
+            if (!this->stream) {
+                throw std::runtime_error("Failed to create output audio stream.");
+            }
+            avcodec_parameters_from_context(this->stream->codecpar, this->encoder);
+            this->stream->time_base = this->encoder->time_base;
+
+            if (this->decoder) {
+                swr_alloc_set_opts2(&this->swr,
+                    &this->encoder->ch_layout, AV_SAMPLE_FMT_FLTP, this->encoder->sample_rate,
+                    &this->decoder->ch_layout, this->decoder->sample_fmt, this->decoder->sample_rate,
+                    0, NULL);
+                if (!this->swr || swr_init(this->swr) < 0) {
+                    throw std::runtime_error("Could not set up audio resampling.");
+                }
             }
 
-            ffmpeg_cmd_stream << "\" ";
-            ffmpeg_cmd_stream << "-map 0:v ";
-            ffmpeg_cmd_stream << "-map \"[final_audio]\" ";
-            ffmpeg_cmd_stream << "-c:v copy -c:a aac -shortest -y \""
-                              << output_video_path << "\"";
+            this->packet = av_packet_alloc();
+            this->decoded = av_frame_alloc();
+            this->mixed = av_frame_alloc();
+            if (!this->packet || !this->decoded || !this->mixed) {
+                throw std::runtime_error("Failed to allocate audio frames or packets.");
+            }
+            this->mixed->format = AV_SAMPLE_FMT_FLTP;
+            this->mixed->sample_rate = this->encoder->sample_rate;
+            this->mixed->nb_samples = this->encoder->frame_size;
+            av_channel_layout_copy(&this->mixed->ch_layout, &this->encoder->ch_layout);
+            if (av_frame_get_buffer(this->mixed, 0) < 0) {
+                throw std::runtime_error("Failed to allocate audio frame buffer.");
+            }
+            this->pending.resize(this->encoder->ch_layout.nb_channels);
+            this->tone.resize(this->encoder->frame_size);
+        }
 
-            std::string ffmpeg_command = ffmpeg_cmd_stream.str();
-            
-            std::cout << "Executing FFmpeg command:\n" << ffmpeg_command << std::endl;
-            exec(ffmpeg_command);
+        // Decodes and resamples source audio until `count` samples are buffered or it runs out.
+        void FillSource(int count) {
+            while (!this->source_done && this->Buffered() < count) {
+                if (av_read_frame(this->source_fmt_ctx, this->packet) < 0) {
+                    avcodec_send_packet(this->decoder, NULL);
+                    this->ReceiveSource();
+                    this->AppendResampled(nullptr, 0);
+                    this->source_done = true;
+                    break;
+                }
+                if (this->packet->stream_index == this->source_stream && avcodec_send_packet(this->decoder, this->packet) >= 0) {
+                    this->ReceiveSource();
+                }
+                av_packet_unref(this->packet);
+            }
+        }
 
-            std::cout << 100 << std::endl;
-        } catch (const std::runtime_error& e) {
-            std::cerr << "FFmpeg Error: " << e.what() << std::endl;
-        } catch (const std::exception& e) {
-            std::cerr << "An unexpected error occurred: " << e.what() << std::endl;
+        void ReceiveSource() {
+            while (avcodec_receive_frame(this->decoder, this->decoded) >= 0) {
+                this->AppendResampled(const_cast<const uint8_t**>(this->decoded->extended_data), this->decoded->nb_samples);
+                av_frame_unref(this->decoded);
+            }
         }
-    }
-}
\ No newline at end of file
+
+        // in == nullptr drains the resampler.
+        void AppendResampled(const uint8_t** in, int in_samples) {
+            int capacity = swr_get_out_samples(this->swr, in_samples);
+            if (capacity <= 0) return;
+
+            std::vector<uint8_t*> out(this->pending.size());
+            for (size_t c = 0; c < this->pending.size(); c++) {
+                this->pending[c].resize(this->pending[c].size() + capacity);
+                out[c] = reinterpret_cast<uint8_t*>(this->pending[c].data() + this->pending[c].size() - capacity);
+            }
+            int converted = std::max(swr_convert(this->swr, out.data(), capacity, in, in_samples), 0);
+            for (std::vector<float>& channel : this->pending) {
+                channel.resize(channel.size() - capacity + converted);
+            }
+        }
+
+        int Buffered() const {
+            return this->pending.empty() ? 0 : static_cast<int>(this->pending[0].size() - this->pending_offset);
+        }
+
+        void EncodeAudio(int64_t pts, int count) {
+            if (av_frame_make_writable(this->mixed) < 0) {
+                throw std::runtime_error("Audio frame is not writable.");
+            }
+            this->mixed->nb_samples = count;
+            this->mixed->pts = pts;
+
+            this->tones[0].Render(this->kernel, this->tone.data(), count, this->tone_gain, false);
+            this->tones[1].Render(this->kernel, this->tone.data(), count, this->tone_gain, true);
+
+            int from_source = 0;
+            if (this->decoder) {
+                this->FillSource(count);
+                from_source = std::min(count, this->Buffered());
+            }
+            for (size_t c = 0; c < this->pending.size(); c++) {
+                float* dst = reinterpret_cast<float*>(this->mixed->extended_data[c]);
+                detail::mix_scaled(this->kernel, dst, this->pending[c].data() + this->pending_offset, 0.03f, this->tone.data(), from_source);
+                std::copy(this->tone.begin() + from_source, this->tone.begin() + count, dst + from_source);
+            }
+            this->pending_offset += from_source;
+            if (this->pending_offset >= (1 << 16)) {
+                for (std::vector<float>& channel : this->pending) {
+                    channel.erase(channel.begin(), channel.begin() + this->pending_offset);
+                }
+                this->pending_offset = 0;
+            }
+
+            if (avcodec_send_frame(this->encoder, this->mixed) < 0) {
+                throw std::runtime_error("Failed to encode audio frame.");
+            }
+            this->WritePackets();
+        }
+
+        void WritePackets() {
+            while (avcodec_receive_packet(this->encoder, this->packet) >= 0) {
+                av_packet_rescale_ts(this->packet, this->encoder->time_base, this->stream->time_base);
+                this->packet->stream_index = this->stream->index;
+                av_interleaved_write_frame(this->out_fmt_ctx, this->packet);
+                av_packet_unref(this->packet);
+            }
+        }
+
+        AVFormatContext* source_fmt_ctx = nullptr;
+        AVFormatContext* out_fmt_ctx = nullptr;
+        AVCodecContext* decoder = nullptr;
+        AVCodecContext* encoder = nullptr;
+        SwrContext* swr = nullptr;
+        AVStream* stream = nullptr;
+        AVPacket* packet = nullptr;
+        AVFrame* decoded = nullptr;
+        AVFrame* mixed = nullptr;
+        int source_stream = -1;
+        double duration = 0.0;
+        bool source_done = false;
+        bool failed = false;
+        int64_t total = 0;
+        int64_t written = 0;
+
+        RemapKernel kernel = detect_remap_kernel();
+        std::array<SineOscillator, 2> tones;
+        float tone_gain = 0.0f;
+        std::vector<float> tone;
+        std::vector<std::vector<float>> pending;
+        size_t pending_offset = 0;
+    };
+}
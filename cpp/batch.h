@@ -0,0 +1,210 @@
+namespace UnsafeYT{
+    // Batched variant of the GL transform. Up to `batch_size` frames are staged into one
+    // upload buffer, copied into a GL_TEXTURE_2D_ARRAY with a single glTexSubImage3D, remapped
+    // by one instanced draw into a layered framebuffer (the geometry shader routes instance i
+    // to layer i) and read back with a single glGetTexImage. The driver overhead of a frame
+    // is then paid once per batch.
+    //
+    // Batches are double-buffered: the readback of a batch is only waited for once the next
+    // batch has been submitted. The upload buffer is orphaned on every map, so one is enough;
+    // each slot has its own readback buffer and fence. Memory is roughly five frames of RGB24
+    // per unit of batch size: upload, two readbacks, and the input and output arrays.
+    class BatchRenderer {
+    public:
+        static constexpr int SLOTS = 2;
+
+        int Init(int width, int height, int batch_size) {
+            GLint max_layers = 0;
+            glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+            this->width = width;
+            this->height = height;
+            this->batch_size = std::min(std::max(batch_size, 1), std::max(static_cast<int>(max_layers), 1));
+            this->frame_bytes = static_cast<GLsizeiptr>(width) * height * 3;
+            GLsizeiptr batch_bytes = this->frame_bytes * this->batch_size;
+
+            glGenTextures(1, &this->input_texture);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, this->input_texture);
+            AllocateArray(width, height, this->batch_size);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+            glGenTextures(1, &this->output_texture);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, this->output_texture);
+            AllocateArray(width, height, this->batch_size);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+            glGenFramebuffers(1, &this->fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, this->output_texture, 0);
+            GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            if (status != GL_FRAMEBUFFER_COMPLETE) {
+                std::cerr << "ERROR::FRAMEBUFFER:: Layered framebuffer is not complete! Status: " << status << std::endl;
+                return -1;
+            }
+
+            glGenBuffers(1, &this->upload);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->upload);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, batch_bytes, NULL, GL_STREAM_DRAW);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+            glGenBuffers(SLOTS, this->readbacks);
+            for (int i = 0; i < SLOTS; i++) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, this->readbacks[i]);
+                glBufferData(GL_PIXEL_PACK_BUFFER, batch_bytes, NULL, GL_STREAM_READ);
+                this->fences[i] = nullptr;
+                this->layers[i] = 0;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            if (glGetError() != GL_NO_ERROR) {
+                std::cerr << "Error: Failed to allocate batch textures or pixel buffer objects." << std::endl;
+                return -1;
+            }
+            return 0;
+        }
+
+        void Release() {
+            if (this->staging) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->upload);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                this->staging = nullptr;
+            }
+            for (GLsync& fence : this->fences) {
+                if (fence) glDeleteSync(fence);
+                fence = nullptr;
+            }
+            if (this->upload) glDeleteBuffers(1, &this->upload);
+            if (this->readbacks[0]) glDeleteBuffers(SLOTS, this->readbacks);
+            if (this->fbo) glDeleteFramebuffers(1, &this->fbo);
+            if (this->input_texture) glDeleteTextures(1, &this->input_texture);
+            if (this->output_texture) glDeleteTextures(1, &this->output_texture);
+            this->upload = 0;
+            this->readbacks[0] = this->readbacks[1] = 0;
+            this->fbo = 0;
+            this->input_texture = 0;
+            this->output_texture = 0;
+            this->filled = 0;
+            this->pending = 0;
+        }
+
+        int Stride() const { return this->width * 3; }
+        int BatchSize() const { return this->batch_size; }
+
+        // Returns where the next frame of the batch being filled goes. The upload buffer is
+        // mapped with the first frame and stays mapped until Submit().
+        uint8_t* BeginFrame() {
+            if (!this->staging) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->upload);
+                this->staging = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, this->frame_bytes * this->batch_size,
+                                                                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                if (!this->staging) return nullptr;
+            }
+            return this->staging + this->frame_bytes * this->filled;
+        }
+
+        void EndFrame() { this->filled++; }
+
+        bool BatchReady() const { return this->filled == this->batch_size; }
+        bool Filling() const { return this->filled > 0; }
+
+        // Uploads the staged frames, remaps them in one instanced draw of `program` and queues
+        // one readback of the whole array into the current slot. The program's samplers must
+        // already point at units 0 (frames) and 1 (map).
+        void Submit(GLuint program, GLuint map_texture, GLuint vao) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->upload);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            this->staging = nullptr;
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, this->input_texture);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, this->width, this->height, this->filled, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+            glViewport(0, 0, this->width, this->height);
+            glUseProgram(program);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, this->input_texture);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, map_texture);
+            glBindVertexArray(vao);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, this->filled);
+            glBindVertexArray(0);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            // Every fragment of the drawn layers is written, so nothing needs clearing; layers
+            // past `filled` hold stale frames and are skipped when the slot is consumed.
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, this->readbacks[this->head]);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, this->output_texture);
+            glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            this->fences[this->head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            this->layers[this->head] = this->filled;
+            this->head = (this->head + 1) % SLOTS;
+            this->pending++;
+            this->filled = 0;
+        }
+
+        bool Full() const { return this->pending == SLOTS; }
+        bool Empty() const { return this->pending == 0; }
+
+        // Waits for the oldest batch and maps it for reading; frame i of the batch starts at
+        // i * FrameBytes(). Valid until UnmapOldest().
+        const uint8_t* MapOldest(int& frames) {
+            int tail = (this->head + SLOTS - this->pending) % SLOTS;
+            GLsync& fence = this->fences[tail];
+            if (fence) {
+                GLenum status;
+                do {
+                    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+                } while (status == GL_TIMEOUT_EXPIRED);
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+            frames = this->layers[tail];
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, this->readbacks[tail]);
+            return static_cast<const uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, this->frame_bytes * frames, GL_MAP_READ_BIT));
+        }
+
+        void UnmapOldest() {
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            this->pending--;
+        }
+
+        GLsizeiptr FrameBytes() const { return this->frame_bytes; }
+
+        int width = 0;
+        int height = 0;
+        int batch_size = 1;
+        GLsizeiptr frame_bytes = 0;
+        GLuint input_texture = 0;
+        GLuint output_texture = 0;
+        GLuint fbo = 0;
+        GLuint upload = 0;
+        GLuint readbacks[SLOTS] = {0, 0};
+        GLsync fences[SLOTS] = {nullptr, nullptr};
+        int layers[SLOTS] = {0, 0};
+        uint8_t* staging = nullptr;
+        int filled = 0;
+        int head = 0;
+        int pending = 0;
+
+    private:
+        static void AllocateArray(int width, int height, int layers) {
+            if (GLEW_ARB_texture_storage) {
+                glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGB8, width, height, layers);
+            } else {
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB8, width, height, layers, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+            }
+        }
+    };
+}
@@ -0,0 +1,210 @@
+// Cost of the planar and tiled remaps for every sample container and plane packing they are
+// specialized on: 8-bit planar (yuv420p, yuv444p), 8-bit semi-planar (nv12), 10-bit planar
+// (yuv420p10le, yuv422p10le) and 10-bit semi-planar (p010le). Every format is remapped with
+// each kernel this machine supports and with the tiled remap. All outputs have to match the
+// scalar planar remap bit for bit and stay inside the format's code range, with p010's
+// padding bits clear. Prints milliseconds per frame.
+//
+//     bitdepth_bench [--size=WxH] [--frames=N]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <stdexcept>
+
+extern "C" {
+    #include <libavutil/frame.h>
+    #include <libavutil/pixdesc.h>
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#elif defined(__aarch64__)
+    #include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#include "../hash.h"
+#include "../offset.h"
+#include "../remap.h"
+#include "../planar.h"
+#include "../tiles.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    AVFrame* make_frame(AVPixelFormat pix_fmt, int width, int height) {
+        AVFrame* frame = av_frame_alloc();
+        frame->format = pix_fmt;
+        frame->width = width;
+        frame->height = height;
+        if (av_frame_get_buffer(frame, 0) < 0) {
+            throw std::runtime_error("Could not allocate a frame.");
+        }
+        return frame;
+    }
+
+    // Calls fn(plane, row pointer, samples in the row) for every row of every plane.
+    void for_each_row(AVFrame* frame, const UnsafeYT::YuvLayout& layout, const std::function<void(int, uint8_t*, int)>& fn) {
+        for (int c = 0; c < layout.Planes(); c++) {
+            int width = c == 0 ? frame->width : -((-frame->width) >> layout.log2_chroma_w);
+            int height = c == 0 ? frame->height : -((-frame->height) >> layout.log2_chroma_h);
+            int samples = width * (layout.semi_planar && c == 1 ? 2 : 1);
+            for (int y = 0; y < height; y++) {
+                fn(c, frame->data[c] + static_cast<size_t>(y) * frame->linesize[c], samples);
+            }
+        }
+    }
+
+    void fill(AVFrame* frame, const UnsafeYT::YuvLayout& layout) {
+        uint32_t state = 2463534242u;
+        for_each_row(frame, layout, [&](int, uint8_t* row, int samples) {
+            for (int x = 0; x < samples; x++) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                uint32_t value = (state % (1u << layout.depth)) << layout.shift;
+                if (layout.bytes == 1) {
+                    row[x] = static_cast<uint8_t>(value);
+                } else {
+                    reinterpret_cast<uint16_t*>(row)[x] = static_cast<uint16_t>(value);
+                }
+            }
+        });
+    }
+
+    bool same_picture(AVFrame* a, AVFrame* b, const UnsafeYT::YuvLayout& layout) {
+        bool same = true;
+        std::vector<uint8_t*> rows;
+        for_each_row(b, layout, [&](int, uint8_t* row, int) { rows.push_back(row); });
+        size_t i = 0;
+        for_each_row(a, layout, [&](int, uint8_t* row, int samples) {
+            same = same && std::memcmp(row, rows[i++], static_cast<size_t>(samples) * layout.bytes) == 0;
+        });
+        return same;
+    }
+
+    bool in_range(AVFrame* frame, const UnsafeYT::YuvLayout& layout) {
+        uint32_t maximum = ((1u << layout.depth) - 1) << layout.shift;
+        uint32_t padding = (1u << layout.shift) - 1;
+        bool valid = true;
+        for_each_row(frame, layout, [&](int, uint8_t* row, int samples) {
+            for (int x = 0; x < samples && valid; x++) {
+                uint32_t value = layout.bytes == 1 ? row[x] : reinterpret_cast<uint16_t*>(row)[x];
+                valid = value <= maximum && (value & padding) == 0;
+            }
+        });
+        return valid;
+    }
+
+    double time_ms(int frames, const std::function<void()>& fn) {
+        auto started = Clock::now();
+        for (int f = 0; f < frames; f++) {
+            fn();
+        }
+        return std::chrono::duration<double, std::milli>(Clock::now() - started).count() / frames;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int width = 1920, height = 1080, frames = 100;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--size=", 0) == 0) {
+            if (std::sscanf(arg.c_str() + 7, "%dx%d", &width, &height) != 2) {
+                std::cerr << "Error: --size takes WIDTHxHEIGHT." << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--frames=", 0) == 0) {
+            frames = std::max(std::stoi(arg.substr(9)), 1);
+        } else {
+            std::cerr << "Error: Unknown option '" << arg << "'." << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<UnsafeYT::RemapKernel> kernels = {UnsafeYT::RemapKernel::Scalar};
+    UnsafeYT::RemapKernel best = UnsafeYT::detect_remap_kernel();
+#if defined(__x86_64__) || defined(__i386__)
+    if (best == UnsafeYT::RemapKernel::SSE41 || best == UnsafeYT::RemapKernel::AVX2) kernels.push_back(UnsafeYT::RemapKernel::SSE41);
+#endif
+    if (best != UnsafeYT::RemapKernel::Scalar && best != UnsafeYT::RemapKernel::SSE41) kernels.push_back(best);
+
+    // The tile map makes the planar plans integer, which is the addressing the tiled remap
+    // always uses, so both have to produce the same picture.
+    std::vector<float> offsets = UnsafeYT::generate_offset_map(80, 80, "my_secret_seed_123", UnsafeYT::MapDirection::Shuffle);
+    std::vector<uint32_t> tiles = UnsafeYT::offsets_to_tile_map(offsets, 80, 80);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << width << "x" << height << ", " << frames << " frames, ms/frame" << std::endl;
+    std::cout << std::left << std::setw(14) << "format" << std::setw(22) << "specialization" << std::right;
+    for (UnsafeYT::RemapKernel kernel : kernels) {
+        std::cout << std::setw(10) << UnsafeYT::remap_kernel_name(kernel);
+    }
+    std::cout << std::setw(10) << "tiled" << std::endl;
+
+    const AVPixelFormat formats[] = {
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV444P, AV_PIX_FMT_NV12,
+        AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV422P10LE, AV_PIX_FMT_P010LE,
+    };
+    for (AVPixelFormat pix_fmt : formats) {
+        UnsafeYT::YuvLayout layout;
+        if (!UnsafeYT::PlanarRemapper::Describe(pix_fmt, layout)) {
+            std::cerr << "Error: " << av_get_pix_fmt_name(pix_fmt) << " is not a layout the remappers take." << std::endl;
+            return 1;
+        }
+        AVFrame* src = make_frame(pix_fmt, width, height);
+        AVFrame* reference = make_frame(pix_fmt, width, height);
+        AVFrame* dst = make_frame(pix_fmt, width, height);
+        fill(src, layout);
+
+        UnsafeYT::PlanarRemapper planar;
+        planar.Prepare(offsets, tiles, 80, 80, src, false);
+        UnsafeYT::TiledRemapper tiled;
+        tiled.Prepare(offsets, tiles, 80, 80, pix_fmt, width, height, false);
+        planar.kernel = UnsafeYT::RemapKernel::Scalar;
+        planar.Apply(src, reference);
+        if (!in_range(reference, layout)) {
+            std::cerr << "Error: The " << av_get_pix_fmt_name(pix_fmt) << " remap left the format's code range." << std::endl;
+            return 1;
+        }
+
+        std::string specialization = std::string(layout.bytes == 1 ? "uint8_t" : "uint16_t") + (layout.semi_planar ? ", semi-planar" : ", planar");
+        std::cout << std::left << std::setw(14) << av_get_pix_fmt_name(pix_fmt) << std::setw(22) << specialization << std::right;
+        for (UnsafeYT::RemapKernel kernel : kernels) {
+            planar.kernel = kernel;
+            planar.Apply(src, dst);
+            if (!same_picture(dst, reference, layout)) {
+                std::cerr << std::endl << "Error: The " << UnsafeYT::remap_kernel_name(kernel) << " kernel disagrees with the scalar one on "
+                          << av_get_pix_fmt_name(pix_fmt) << "." << std::endl;
+                return 1;
+            }
+            std::cout << std::setw(10) << time_ms(frames, [&] { planar.Apply(src, dst); });
+        }
+        tiled.Apply(src, dst, 1);
+        if (!same_picture(dst, reference, layout)) {
+            std::cerr << std::endl << "Error: The tiled remap disagrees with the planar one on " << av_get_pix_fmt_name(pix_fmt) << "." << std::endl;
+            return 1;
+        }
+        std::cout << std::setw(10) << time_ms(frames, [&] { tiled.Apply(src, dst, 1); }) << std::endl;
+
+        av_frame_free(&src);
+        av_frame_free(&reference);
+        av_frame_free(&dst);
+    }
+    return 0;
+}
@@ -0,0 +1,239 @@
+// Measures GL remap throughput per batch size: frames are streamed through upload, draw and
+// readback exactly as Video does, once with the single-frame PBO ring and once with the
+// texture-array batches of 1, 4, 8 and 16 frames. Needs a display or a software GL driver.
+//
+//     gl_batch_bench [width] [height] [frames]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <stdexcept>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#include "../hash.h"
+#include "../offset.h"
+#include "../shader.h"
+#include "../pbo.h"
+#include "../batch.h"
+#include "../shaders.h"
+
+namespace {
+    constexpr int SOURCE_FRAMES = 8;
+
+    struct Scene {
+        int width;
+        int height;
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint map_texture = 0;
+        std::vector<std::vector<uint8_t>> frames;
+        std::vector<uint8_t> sink;
+    };
+
+    void setup_scene(Scene& scene) {
+        float vertices[] = {
+            -1.0f,  1.0f,  0.0f, 1.0f,
+            -1.0f, -1.0f,  0.0f, 0.0f,
+            1.0f, -1.0f,  1.0f, 0.0f,
+            -1.0f,  1.0f,  0.0f, 1.0f,
+            1.0f, -1.0f,  1.0f, 0.0f,
+            1.0f,  1.0f,  1.0f, 1.0f
+        };
+        glGenVertexArrays(1, &scene.vao);
+        glGenBuffers(1, &scene.vbo);
+        glBindVertexArray(scene.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, scene.vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+
+        std::vector<float> map = UnsafeYT::generate_offset_map(80, 80, "bench_seed", UnsafeYT::MapDirection::Shuffle);
+        glGenTextures(1, &scene.map_texture);
+        glBindTexture(GL_TEXTURE_2D, scene.map_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, 80, 80, 0, GL_RG, GL_FLOAT, map.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        size_t frame_bytes = static_cast<size_t>(scene.width) * scene.height * 3;
+        uint32_t state = 12345;
+        for (int f = 0; f < SOURCE_FRAMES; f++) {
+            std::vector<uint8_t> frame(frame_bytes);
+            for (uint8_t& byte : frame) {
+                state = state * 1664525u + 1013904223u;
+                byte = static_cast<uint8_t>(state >> 24);
+            }
+            scene.frames.push_back(std::move(frame));
+        }
+        scene.sink.resize(frame_bytes);
+    }
+
+    // Unbatched path: one upload, draw and readback per frame through the PBO ring.
+    double run_ring(Scene& scene, GLuint program, int frames) {
+        GLuint input = 0, output = 0, fbo = 0;
+        glGenTextures(1, &input);
+        glBindTexture(GL_TEXTURE_2D, input);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, scene.width, scene.height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenTextures(1, &output);
+        glBindTexture(GL_TEXTURE_2D, output);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, scene.width, scene.height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, output, 0);
+
+        UnsafeYT::PixelTransferRing ring;
+        if (ring.Init(scene.width, scene.height, 3) != 0) return 0.0;
+
+        auto consume = [&]() {
+            const uint8_t* pixels = ring.MapOldest();
+            if (pixels) std::memcpy(scene.sink.data(), pixels, scene.sink.size());
+            ring.UnmapOldest();
+        };
+
+        auto started = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++) {
+            uint8_t* upload = ring.BeginUpload();
+            if (upload) std::memcpy(upload, scene.frames[i % SOURCE_FRAMES].data(), scene.sink.size());
+            ring.EndUpload(input);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glViewport(0, 0, scene.width, scene.height);
+            glUseProgram(program);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, input);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, scene.map_texture);
+            glBindVertexArray(scene.vao);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+            ring.QueueReadback();
+            if (ring.Full()) consume();
+        }
+        while (!ring.Empty()) consume();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        ring.Release();
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(1, &input);
+        glDeleteTextures(1, &output);
+        return frames / elapsed;
+    }
+
+    double run_batched(Scene& scene, GLuint program, int batch_size, int frames) {
+        UnsafeYT::BatchRenderer batches;
+        if (batches.Init(scene.width, scene.height, batch_size) != 0) {
+            batches.Release();
+            return 0.0;
+        }
+
+        auto consume = [&]() {
+            int count = 0;
+            const uint8_t* pixels = batches.MapOldest(count);
+            for (int i = 0; pixels && i < count; i++) {
+                std::memcpy(scene.sink.data(), pixels + batches.FrameBytes() * i, scene.sink.size());
+            }
+            batches.UnmapOldest();
+        };
+
+        auto started = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++) {
+            uint8_t* upload = batches.BeginFrame();
+            if (upload) std::memcpy(upload, scene.frames[i % SOURCE_FRAMES].data(), scene.sink.size());
+            batches.EndFrame();
+            if (batches.BatchReady()) {
+                batches.Submit(program, scene.map_texture, scene.vao);
+                if (batches.Full()) consume();
+            }
+        }
+        if (batches.Filling()) batches.Submit(program, scene.map_texture, scene.vao);
+        while (!batches.Empty()) consume();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        batches.Release();
+        return frames / elapsed;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Scene scene;
+    scene.width = argc > 1 ? std::atoi(argv[1]) : 1920;
+    scene.height = argc > 2 ? std::atoi(argv[2]) : 1080;
+    int frames = argc > 3 ? std::atoi(argv[3]) : 480;
+    if (scene.width <= 0 || scene.height <= 0 || frames <= 0) {
+        std::cerr << "Usage: gl_batch_bench [width] [height] [frames]" << std::endl;
+        return 1;
+    }
+
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(1, 1, "OpenGL Context", NULL, NULL);
+    if (!window) {
+        std::cerr << "Failed to create GLFW window or OpenGL context" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW" << std::endl;
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 1;
+    }
+
+    GLuint single = UnsafeYT::createShaderProgram(vertexShaderSource, fragmentShaderSource);
+    GLuint batched = UnsafeYT::createShaderProgram(batchVertexShaderSource, batchGeometryShaderSource, batchFragmentShaderSource);
+    if (single == 0 || batched == 0) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 1;
+    }
+    UnsafeYT::configureRemapProgram(single, scene.width, scene.height, 80, 80);
+    UnsafeYT::configureRemapProgram(batched, scene.width, scene.height, 80, 80);
+    setup_scene(scene);
+
+    std::cout << "GL remap, " << scene.width << "x" << scene.height << ", " << frames << " frames ("
+              << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << ")" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  ring      " << std::setw(10) << run_ring(scene, single, frames) << " fps" << std::endl;
+    for (int batch_size : {1, 4, 8, 16}) {
+        std::cout << "  batch " << std::setw(3) << batch_size << " " << std::setw(10) << run_batched(scene, batched, batch_size, frames) << " fps" << std::endl;
+    }
+
+    glDeleteProgram(single);
+    glDeleteProgram(batched);
+    glDeleteTextures(1, &scene.map_texture);
+    glDeleteVertexArrays(1, &scene.vao);
+    glDeleteBuffers(1, &scene.vbo);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,68 @@
+// Compares GL startup cost of the headless EGL context against the hidden GLFW window:
+// context creation, GLEW, compiling the remap program and a glFinish, then teardown. The
+// first run of each backend includes loading the driver, so it is reported on its own.
+//
+//     gl_context_bench [runs]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <chrono>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#ifdef HAVE_EGL
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+#endif
+
+#include "../context.h"
+#include "../shader.h"
+#include "../shaders.h"
+
+namespace {
+    // Milliseconds for one start-up and tear-down, or a negative value on failure.
+    double startup_ms(UnsafeYT::ContextBackend backend) {
+        auto started = std::chrono::steady_clock::now();
+        UnsafeYT::GLContext context;
+        if (context.Create(backend) != 0) return -1.0;
+        GLuint program = UnsafeYT::createShaderProgram(vertexShaderSource, fragmentShaderSource);
+        if (program == 0) return -1.0;
+        glFinish();
+        glDeleteProgram(program);
+        context.Destroy();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int runs = argc > 1 ? std::atoi(argv[1]) : 10;
+    if (runs <= 0) {
+        std::cerr << "Usage: gl_context_bench [runs]" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "GL context startup, " << runs << " runs (ms)" << std::endl;
+    std::cout << "  backend      first     median        min" << std::endl;
+    for (UnsafeYT::ContextBackend backend : {UnsafeYT::ContextBackend::EGL, UnsafeYT::ContextBackend::GLFW}) {
+        std::vector<double> times;
+        double first = startup_ms(backend);
+        for (int i = 0; first >= 0.0 && i < runs; i++) {
+            double ms = startup_ms(backend);
+            if (ms < 0.0) break;
+            times.push_back(ms);
+        }
+        std::cout << "  " << std::left << std::setw(8) << UnsafeYT::context_backend_name(backend) << std::right;
+        if (first < 0.0 || times.empty()) {
+            std::cout << "  unavailable" << std::endl;
+            continue;
+        }
+        std::sort(times.begin(), times.end());
+        std::cout << std::setw(10) << first << std::setw(11) << times[times.size() / 2] << std::setw(11) << times.front() << std::endl;
+    }
+    return 0;
+}
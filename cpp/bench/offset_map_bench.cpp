@@ -0,0 +1,90 @@
+// Times the offset map generator at the default grid and at grids approaching per-pixel
+// permutations, serial and threaded, against the original std::sort formulation, and
+// checks that both produce the same maps.
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <stdexcept>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#include "../hash.h"
+#include "../offset.h"
+
+// The generator as it was before the radix sort: sort (value, index) pairs, then build the
+// shuffle map from the inverse permutation.
+std::vector<float> reference_shuffle_map(int map_width, int map_height, const std::string& seed) {
+    size_t total_pixels = static_cast<size_t>(map_width) * map_height;
+    double start_hash = UnsafeYT::deterministic_hash(seed, 31, std::numeric_limits<unsigned int>::max());
+    double step_hash = UnsafeYT::deterministic_hash(seed + "_step", 37, std::numeric_limits<unsigned int>::max() - 1);
+    double start_angle = start_hash * M_PI * 2.0;
+    double angle_increment = step_hash * M_PI / std::max(static_cast<double>(map_width), static_cast<double>(map_height));
+
+    std::vector<std::pair<double, size_t>> indexed_values(total_pixels);
+    for (size_t i = 0; i < total_pixels; ++i) {
+        indexed_values[i] = {std::sin(start_angle + i * angle_increment), i};
+    }
+    std::sort(indexed_values.begin(), indexed_values.end());
+
+    std::vector<float> map(total_pixels * 2);
+    for (size_t k = 0; k < total_pixels; ++k) {
+        size_t original = indexed_values[k].second;
+        int tx = static_cast<int>(k % map_width), ty = static_cast<int>(k / map_width);
+        int ox = static_cast<int>(original % map_width), oy = static_cast<int>(original / map_width);
+        map[k * 2] = static_cast<float>(static_cast<double>(ox - tx) / static_cast<double>(map_width));
+        map[k * 2 + 1] = static_cast<float>(static_cast<double>(oy - ty) / static_cast<double>(map_height));
+    }
+    return map;
+}
+
+double median_ms(int runs, const std::function<void()>& fn) {
+    std::vector<double> times;
+    for (int i = 0; i < runs; i++) {
+        auto started = std::chrono::steady_clock::now();
+        fn();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+int main(int argc, char* argv[]) {
+    std::string seed = argc > 1 ? argv[1] : "my_secret_seed_123";
+    int threads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    const std::pair<int, int> grids[] = {{80, 80}, {480, 270}, {1920, 1080}};
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "grid (ms)     reference    serial  " << std::setw(3) << threads << " threads  match" << std::endl;
+    bool all_match = true;
+    for (const auto& grid : grids) {
+        int w = grid.first, h = grid.second;
+        int runs = w * h > 100000 ? 5 : 50;
+
+        std::vector<float> expected;
+        std::vector<float> serial;
+        std::vector<float> threaded;
+        double reference_time = median_ms(runs, [&]() { expected = reference_shuffle_map(w, h, seed); });
+        double serial_time = median_ms(runs, [&]() { serial = UnsafeYT::generate_offset_map(w, h, seed, UnsafeYT::MapDirection::Shuffle, 1); });
+        double threaded_time = median_ms(runs, [&]() { threaded = UnsafeYT::generate_offset_map(w, h, seed, UnsafeYT::MapDirection::Shuffle, threads); });
+        bool match = serial == expected && threaded == expected;
+        all_match = all_match && match;
+
+        std::cout << std::left << std::setw(12) << (std::to_string(w) + "x" + std::to_string(h)) << std::right
+                  << std::setw(11) << reference_time
+                  << std::setw(10) << serial_time
+                  << std::setw(12) << threaded_time
+                  << "  " << (match ? "yes" : "NO") << std::endl;
+    }
+    return all_match ? 0 : 1;
+}
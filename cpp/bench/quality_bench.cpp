@@ -0,0 +1,148 @@
+// Cost of the inline quality metrics: PSNR and SSIM of a synthetic yuv420p frame against a
+// lightly distorted copy, with every kernel this machine supports. Checks that the kernels
+// agree and prints milliseconds per frame, which with the sampling interval bounds what
+// --metrics adds to an encode.
+//
+//     quality_bench [--size=WxH] [--frames=N]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <stdexcept>
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/frame.h>
+    #include <libavutil/pixdesc.h>
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#elif defined(__aarch64__)
+    #include <arm_neon.h>
+#endif
+
+#include "../remap.h"
+#include "../quality.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Plane {
+        int width = 0;
+        int height = 0;
+        int linesize = 0;
+        std::vector<uint8_t> source;
+        std::vector<uint8_t> encoded;
+    };
+
+    // A gradient with texture, and a copy off by a few levels with the odd outlier, about what
+    // a lossy encode leaves behind.
+    Plane make_plane(int width, int height, int seed) {
+        Plane plane;
+        plane.width = width;
+        plane.height = height;
+        plane.linesize = (width + 63) & ~63;
+        plane.source.resize(static_cast<size_t>(plane.linesize) * height);
+        plane.encoded.resize(plane.source.size());
+        uint32_t state = 2463534242u + seed;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                size_t i = static_cast<size_t>(y) * plane.linesize + x;
+                int value = (x * 3 + y * 5 + seed * 40 + static_cast<int>(state % 24)) & 0xFF;
+                int noise = static_cast<int>((state >> 8) % 7) - 3;
+                if ((state >> 16) % 97 == 0) noise = static_cast<int>((state >> 4) % 61) - 30;
+                plane.source[i] = static_cast<uint8_t>(value);
+                plane.encoded[i] = static_cast<uint8_t>(std::min(std::max(value + noise, 0), 255));
+            }
+        }
+        return plane;
+    }
+
+    UnsafeYT::FrameQuality measure(UnsafeYT::RemapKernel kernel, const std::array<Plane, 3>& planes) {
+        UnsafeYT::FrameQuality quality;
+        quality.planes = 3;
+        uint64_t sse = 0, samples = 0, windows = 0;
+        double ssim = 0.0;
+        for (int c = 0; c < 3; c++) {
+            const Plane& p = planes[c];
+            UnsafeYT::PlaneStats stats = UnsafeYT::compare_plane(kernel, p.source.data(), p.linesize, p.encoded.data(), p.linesize, p.width, p.height);
+            quality.psnr[c] = UnsafeYT::psnr_from_sse(stats.sse, stats.samples);
+            quality.ssim[c] = stats.windows ? stats.ssim_sum / stats.windows : 1.0;
+            sse += stats.sse;
+            samples += stats.samples;
+            ssim += stats.ssim_sum;
+            windows += stats.windows;
+        }
+        quality.psnr_all = UnsafeYT::psnr_from_sse(sse, samples);
+        quality.ssim_all = windows ? ssim / windows : 1.0;
+        return quality;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int width = 1920, height = 1080, frames = 200;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--size=", 0) == 0) {
+            if (std::sscanf(arg.c_str() + 7, "%dx%d", &width, &height) != 2) {
+                std::cerr << "Error: --size takes WIDTHxHEIGHT." << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--frames=", 0) == 0) {
+            frames = std::max(std::stoi(arg.substr(9)), 1);
+        } else {
+            std::cerr << "Error: Unknown option '" << arg << "'." << std::endl;
+            return 1;
+        }
+    }
+
+    std::array<Plane, 3> planes = {
+        make_plane(width, height, 0),
+        make_plane((width + 1) / 2, (height + 1) / 2, 1),
+        make_plane((width + 1) / 2, (height + 1) / 2, 2),
+    };
+
+    std::vector<UnsafeYT::RemapKernel> kernels = {UnsafeYT::RemapKernel::Scalar};
+    UnsafeYT::RemapKernel best = UnsafeYT::detect_remap_kernel();
+#if defined(__x86_64__) || defined(__i386__)
+    if (best == UnsafeYT::RemapKernel::SSE41 || best == UnsafeYT::RemapKernel::AVX2) kernels.push_back(UnsafeYT::RemapKernel::SSE41);
+#endif
+    if (best != UnsafeYT::RemapKernel::Scalar && best != UnsafeYT::RemapKernel::SSE41) kernels.push_back(best);
+
+    UnsafeYT::FrameQuality reference = measure(UnsafeYT::RemapKernel::Scalar, planes);
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << width << "x" << height << " yuv420p, " << frames << " frames: PSNR " << reference.psnr_all
+              << " dB, SSIM " << std::setprecision(5) << reference.ssim_all << std::setprecision(3) << std::endl;
+
+    double scalar_ms = 0.0;
+    for (UnsafeYT::RemapKernel kernel : kernels) {
+        UnsafeYT::FrameQuality quality = measure(kernel, planes);
+        if (quality.psnr_all != reference.psnr_all || quality.ssim_all != reference.ssim_all) {
+            std::cerr << "Error: The " << UnsafeYT::remap_kernel_name(kernel) << " kernel disagrees with the scalar one." << std::endl;
+            return 1;
+        }
+        auto started = Clock::now();
+        for (int f = 0; f < frames; f++) {
+            measure(kernel, planes);
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - started).count() / frames;
+        if (kernel == UnsafeYT::RemapKernel::Scalar) scalar_ms = ms;
+        std::cout << std::left << std::setw(8) << UnsafeYT::remap_kernel_name(kernel) << std::right << std::setw(9) << ms << " ms/frame"
+                  << std::setw(8) << scalar_ms / ms << "x" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,189 @@
+// Cost of map rotation on the planar CPU path: the same synthetic yuv420p frames are remapped
+// with one fixed map, then with a new map every N frames built by MapRotation ahead of the
+// frame loop. Every run is repeated and the fastest one counts, which keeps scheduler noise
+// out of the comparison. Prints frames per second and the overhead of each period against
+// the fixed map, and fails when one costs more than --max-overhead percent (1 by default).
+// The builds need a core the frame loop leaves free to stay under that.
+//
+//     rotation_bench [--size=WxH] [--frames=N] [--every=N,N,...] [--ahead=N] [--repeats=N] [--max-overhead=PCT]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <array>
+#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+extern "C" {
+    #include <libavutil/frame.h>
+    #include <libavutil/pixdesc.h>
+    #include <libavutil/imgutils.h>
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#elif defined(__aarch64__)
+    #include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#include "../hash.h"
+#include "../offset.h"
+#include "../remap.h"
+#include "../planar.h"
+#include "../tiles.h"
+#include "../rotation.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    AVFrame* make_frame(int width, int height) {
+        AVFrame* frame = av_frame_alloc();
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width = width;
+        frame->height = height;
+        if (av_frame_get_buffer(frame, 0) < 0) {
+            throw std::runtime_error("Could not allocate a frame.");
+        }
+        return frame;
+    }
+
+    struct Result {
+        double fps = 0.0;
+        long stalls = 0;
+        double stall_ms = 0.0;
+        int deepest = 0;
+        long builds = 0;
+        double build_ms = 0.0;
+    };
+
+    // every == 0 keeps the first map for the whole run.
+    Result run(const std::string& seed, AVFrame* src, AVFrame* dst, int frames, int every, int ahead) {
+        std::vector<float> offsets = UnsafeYT::generate_offset_map(80, 80, seed, UnsafeYT::MapDirection::Shuffle);
+        UnsafeYT::PlanarRemapper fixed;
+        fixed.Prepare(offsets, {}, 80, 80, src, false);
+
+        UnsafeYT::MapRotation rotation;
+        std::array<int, 3> linesizes = {src->linesize[0], src->linesize[1], src->linesize[2]};
+        int width = src->width, height = src->height;
+        if (every > 0) {
+            rotation.Start(seed, UnsafeYT::MapDirection::Shuffle, 80, 80, false, 0, ahead, [=](UnsafeYT::RotatedMap& map) {
+                map.planar_remapper.Prepare(map.offset_map, map.tile_map, 80, 80, AV_PIX_FMT_YUV420P, width, height, linesizes.data(), false);
+            });
+        }
+
+        // The first map is built before the clock starts, as the fixed one is.
+        std::shared_ptr<const UnsafeYT::RotatedMap> map = every > 0 ? rotation.Get(0) : nullptr;
+        auto started = Clock::now();
+        for (int f = 0; f < frames; f++) {
+            if (every > 0 && (!map || map->index != f / every)) {
+                map = rotation.Get(f / every);
+            }
+            (map ? map->planar_remapper : fixed).Apply(src, dst);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+
+        Result result;
+        result.fps = frames / seconds;
+        result.stalls = rotation.Stalls();
+        result.stall_ms = rotation.StallMs();
+        result.deepest = every > 0 ? rotation.Deepest() : 0;
+        result.builds = rotation.Builds();
+        result.build_ms = rotation.BuildMs();
+        return result;
+    }
+
+    Result fastest(const std::string& seed, AVFrame* src, AVFrame* dst, int frames, int every, int ahead, int repeats) {
+        Result best;
+        for (int r = 0; r < repeats; r++) {
+            Result result = run(seed, src, dst, frames, every, ahead);
+            if (result.fps > best.fps) best = result;
+        }
+        return best;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int width = 1920, height = 1080, frames = 600, ahead = 3, repeats = 3;
+    double max_overhead = 1.0;
+    std::vector<int> everies = {30, 300};
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--size=", 0) == 0) {
+            if (std::sscanf(arg.c_str() + 7, "%dx%d", &width, &height) != 2) {
+                std::cerr << "Error: --size takes WIDTHxHEIGHT." << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--frames=", 0) == 0) {
+            frames = std::max(std::stoi(arg.substr(9)), 1);
+        } else if (arg.rfind("--ahead=", 0) == 0) {
+            ahead = std::max(std::stoi(arg.substr(8)), 2);
+        } else if (arg.rfind("--repeats=", 0) == 0) {
+            repeats = std::max(std::stoi(arg.substr(10)), 1);
+        } else if (arg.rfind("--max-overhead=", 0) == 0) {
+            max_overhead = std::stod(arg.substr(15));
+        } else if (arg.rfind("--every=", 0) == 0) {
+            everies.clear();
+            std::stringstream list(arg.substr(8));
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                everies.push_back(std::max(std::stoi(item), 1));
+            }
+        } else {
+            std::cerr << "Error: Unknown option '" << arg << "'." << std::endl;
+            return 1;
+        }
+    }
+
+    AVFrame* src = make_frame(width, height);
+    AVFrame* dst = make_frame(width, height);
+    for (int c = 0; c < 3; c++) {
+        int rows = c == 0 ? height : (height + 1) / 2;
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < src->linesize[c]; x++) {
+                src->data[c][static_cast<size_t>(y) * src->linesize[c] + x] = static_cast<uint8_t>(x * 7 + y * 13 + c * 50);
+            }
+        }
+    }
+
+    const std::string seed = "my_secret_seed_123";
+    Result fixed = fastest(seed, src, dst, frames, 0, ahead, repeats);
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << width << "x" << height << " yuv420p, " << frames << " frames, planar remap, best of " << repeats
+              << ", " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << std::left << std::setw(16) << "fixed map" << std::right << std::setw(9) << fixed.fps << " fps" << std::endl;
+    bool within = true;
+    for (int every : everies) {
+        Result rotated = fastest(seed, src, dst, frames, every, ahead, repeats);
+        double overhead = 100.0 * (fixed.fps / rotated.fps - 1.0);
+        within = within && overhead <= max_overhead;
+        std::cout << std::left << std::setw(16) << "every " + std::to_string(every) << std::right << std::setw(9) << rotated.fps << " fps  "
+                  << std::setw(7) << overhead << "% overhead, " << rotated.stalls << " stalls (" << rotated.stall_ms << " ms), up to "
+                  << rotated.deepest << " built ahead, " << rotated.build_ms / std::max(rotated.builds, 1L) << " ms per build" << std::endl;
+    }
+
+    av_frame_free(&src);
+    av_frame_free(&dst);
+    if (!within) {
+        std::cerr << "Error: Rotation costs more than " << max_overhead << "% of the fixed map's throughput." << std::endl;
+        return 1;
+    }
+    return 0;
+}
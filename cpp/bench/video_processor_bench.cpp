@@ -0,0 +1,751 @@
+// Per-stage timings of the transform path on synthetic video. For every size a testsrc2 clip
+// is rendered through libavfilter and encoded to a temporary H.264 file, which is then run
+// through the same stages Video uses, each one timed on its own in ns/frame: demux, decode,
+// sws (decoded -> RGB24), cpu_remap, upload, draw, readback, out_sws (RGB24 -> yuv420p),
+// encode and mux. GL stages end in glFinish so their cost is not hidden in a later stage;
+// this serialises the GPU, so the sum is an upper bound on the pipelined frame time. The
+// offset map generator is timed as well. Results are written as JSON. Every clip is also run
+// through Video's own frame loops, and the bench fails when one of them drops frames.
+//
+// The bench also fails when a vector CPU remap kernel differs from the scalar one in any
+// byte, or when the GL output differs from the CPU remap by more than 1 on pixels sampled
+// between texels, or at all on pixels copied from one texel. Bit-identical GL output cannot
+// be promised across drivers: GL leaves the subtexel precision of GL_LINEAR to them.
+//
+//     video_processor_bench [--sizes=720p,1080p,4k] [--frames=N] [--json=PATH] [--label=TEXT] [--no-gl]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+#include <numeric>
+#include <limits>
+#include <type_traits>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libswscale/swscale.h>
+    #include <libavutil/imgutils.h>
+    #include <libavformat/avformat.h>
+    #include <libavfilter/avfilter.h>
+    #include <libavfilter/buffersink.h>
+    #include <libavfilter/buffersrc.h>
+    #include <libavutil/opt.h>
+    #include <libavutil/avstring.h>
+    #include <libavutil/frame.h>
+    #include <libavutil/avutil.h>
+    #include <libavutil/error.h>
+    #include <libavutil/fifo.h>
+    #include <libavutil/pixdesc.h>
+    #include <libavformat/avio.h>
+    #include <libswresample/swresample.h>
+}
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#ifdef HAVE_EGL
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+#endif
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <psapi.h>
+    #include <io.h>
+    #include <fcntl.h>
+#else
+    #include <cstdio>
+    #include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#elif defined(__aarch64__)
+    #include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#include "../hash.h"
+#include "../json.h"
+#include "../offset.h"
+#include "../mapcache.h"
+#include "../context.h"
+#include "../shader.h"
+#include "../remap.h"
+#include "../planar.h"
+#include "../tiles.h"
+#include "../pbo.h"
+#include "../batch.h"
+#include "../yuv.h"
+#include "../rotation.h"
+#include "../quality.h"
+#include "../pipeline.h"
+#include "../telemetry.h"
+#include "../workers.h"
+#include "../audio.h"
+#include "../stream.h"
+#include "../encoder.h"
+#include "../video.h"
+#include "../shaders.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    int64_t elapsed_ns(Clock::time_point since) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count();
+    }
+
+    const char* const STAGES[] = {"demux", "decode", "sws", "cpu_remap", "upload", "draw", "readback", "out_sws", "encode", "mux"};
+
+    struct StageSamples {
+        std::vector<int64_t> ns;
+
+        // Nearest-rank percentile of the sorted samples.
+        static int64_t Percentile(const std::vector<int64_t>& sorted, double p) {
+            size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+            return sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1];
+        }
+
+        std::string Json() const {
+            if (this->ns.empty()) return "null";
+            std::vector<int64_t> sorted = this->ns;
+            std::sort(sorted.begin(), sorted.end());
+            double mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+            std::ostringstream out;
+            out << "{\"samples\": " << sorted.size() << ", \"mean\": " << static_cast<int64_t>(mean)
+                << ", \"min\": " << sorted.front() << ", \"p50\": " << Percentile(sorted, 50) << ", \"p90\": " << Percentile(sorted, 90)
+                << ", \"p99\": " << Percentile(sorted, 99) << ", \"max\": " << sorted.back() << "}";
+            return out.str();
+        }
+
+        double MeanMs() const {
+            return this->ns.empty() ? 0.0 : std::accumulate(this->ns.begin(), this->ns.end(), 0.0) / this->ns.size() / 1e6;
+        }
+    };
+
+    struct SizeResult {
+        std::string name;
+        int width = 0;
+        int height = 0;
+        int frames = 0;
+        std::map<std::string, StageSamples> stages;
+        // Bytes where the vector remap kernels differ from the scalar one, which must be none,
+        // and where the GL output differs from the CPU remap, with the largest difference.
+        int64_t kernel_differences = 0;
+        int64_t gl_differences = -1;
+        int gl_max_difference = 0;
+    };
+
+    // Compares two RGB24 pictures byte for byte. Pixels the plan samples between texels may
+    // differ by up to `blend_tolerance`: GL_LINEAR's subtexel precision and rounding are up to
+    // the driver, while the plan uses 8-bit weights rounded to nearest. Pixels copied from a
+    // single texel have to match exactly. Returns the number of bytes that differ at all.
+    int64_t compare_rgb(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, const UnsafeYT::RemapPlan& plan,
+                        int blend_tolerance, int& max_difference, bool& within_tolerance) {
+        int64_t differing = 0;
+        for (int y = 0; y < plan.height; y++) {
+            const uint8_t* row_a = a + static_cast<size_t>(y) * a_stride;
+            const uint8_t* row_b = b + static_cast<size_t>(y) * b_stride;
+            if (std::memcmp(row_a, row_b, static_cast<size_t>(plan.width) * 3) == 0) continue;
+            for (int x = 0; x < plan.width; x++) {
+                size_t i = static_cast<size_t>(y) * plan.width + x;
+                bool blended = !plan.exact() && (plan.weight_x[i] != 0 || plan.weight_y[i] != 0);
+                for (int c = 0; c < 3; c++) {
+                    int difference = std::abs(row_a[x * 3 + c] - row_b[x * 3 + c]);
+                    if (difference == 0) continue;
+                    differing++;
+                    max_difference = std::max(max_difference, difference);
+                    within_tolerance = within_tolerance && difference <= (blended ? blend_tolerance : 0);
+                }
+            }
+        }
+        return differing;
+    }
+
+    // Renders `frames` frames of testsrc2 and encodes them to `path` as H.264 in MP4.
+    int make_source(const std::string& path, int width, int height, int frames) {
+        AVFilterGraph* graph = avfilter_graph_alloc();
+        AVFilterContext* source = nullptr;
+        AVFilterContext* format = nullptr;
+        AVFilterContext* sink = nullptr;
+        std::string args = "size=" + std::to_string(width) + "x" + std::to_string(height) + ":rate=30";
+        if (!graph
+            || avfilter_graph_create_filter(&source, avfilter_get_by_name("testsrc2"), "source", args.c_str(), NULL, graph) < 0
+            || avfilter_graph_create_filter(&format, avfilter_get_by_name("format"), "format", "pix_fmts=yuv420p", NULL, graph) < 0
+            || avfilter_graph_create_filter(&sink, avfilter_get_by_name("buffersink"), "sink", NULL, NULL, graph) < 0
+            || avfilter_link(source, 0, format, 0) < 0
+            || avfilter_link(format, 0, sink, 0) < 0
+            || avfilter_graph_config(graph, NULL) < 0) {
+            std::cerr << "Error: Could not build the testsrc2 filter graph." << std::endl;
+            avfilter_graph_free(&graph);
+            return -1;
+        }
+
+        AVFormatContext* fmt = nullptr;
+        const AVCodec* codec = avcodec_find_encoder_by_name("libx264");
+        if (!codec) codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+        AVCodecContext* enc = codec ? avcodec_alloc_context3(codec) : nullptr;
+        AVPacket* packet = av_packet_alloc();
+        AVFrame* frame = av_frame_alloc();
+        int ret = -1;
+        if (enc && packet && frame && avformat_alloc_output_context2(&fmt, NULL, NULL, path.c_str()) >= 0) {
+            AVStream* stream = avformat_new_stream(fmt, codec);
+            enc->width = width;
+            enc->height = height;
+            enc->pix_fmt = AV_PIX_FMT_YUV420P;
+            enc->time_base = AVRational{1, 30};
+            enc->gop_size = 30;
+            if (fmt->oformat->flags & AVFMT_GLOBALHEADER) enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+            AVDictionary* options = nullptr;
+            av_dict_set(&options, "preset", "ultrafast", 0);
+            av_dict_set(&options, "crf", "18", 0);
+            if (stream && avcodec_open2(enc, codec, &options) >= 0 && avcodec_parameters_from_context(stream->codecpar, enc) >= 0
+                && avio_open(&fmt->pb, path.c_str(), AVIO_FLAG_WRITE) >= 0 && avformat_write_header(fmt, NULL) >= 0) {
+                auto drain = [&]() {
+                    while (avcodec_receive_packet(enc, packet) >= 0) {
+                        av_packet_rescale_ts(packet, enc->time_base, stream->time_base);
+                        packet->stream_index = stream->index;
+                        av_interleaved_write_frame(fmt, packet);
+                    }
+                };
+                for (int i = 0; i < frames && av_buffersink_get_frame(sink, frame) >= 0; i++) {
+                    frame->pts = i;
+                    avcodec_send_frame(enc, frame);
+                    av_frame_unref(frame);
+                    drain();
+                }
+                avcodec_send_frame(enc, NULL);
+                drain();
+                av_write_trailer(fmt);
+                ret = 0;
+            }
+            av_dict_free(&options);
+        }
+        if (ret != 0) std::cerr << "Error: Could not encode the synthetic source." << std::endl;
+
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+        avcodec_free_context(&enc);
+        if (fmt && fmt->pb) avio_closep(&fmt->pb);
+        avformat_free_context(fmt);
+        avfilter_graph_free(&graph);
+        return ret;
+    }
+
+    // The GL objects of Video's single-frame path, with a one-slot transfer ring so every
+    // transfer can be timed on its own.
+    struct GLStage {
+        GLuint program = 0, input = 0, map = 0, output = 0, fbo = 0, vao = 0, vbo = 0;
+        UnsafeYT::PixelTransferRing ring;
+
+        int Init(int width, int height, const std::vector<float>& offset_map, int map_width, int map_height) {
+            this->program = UnsafeYT::createShaderProgram(vertexShaderSource, fragmentShaderSource);
+            if (this->program == 0) return -1;
+            UnsafeYT::configureRemapProgram(this->program, width, height, map_width, map_height);
+
+            float vertices[] = {
+                -1.0f,  1.0f,  0.0f, 1.0f,
+                -1.0f, -1.0f,  0.0f, 0.0f,
+                1.0f, -1.0f,  1.0f, 0.0f,
+                -1.0f,  1.0f,  0.0f, 1.0f,
+                1.0f, -1.0f,  1.0f, 0.0f,
+                1.0f,  1.0f,  1.0f, 1.0f
+            };
+            glGenVertexArrays(1, &this->vao);
+            glGenBuffers(1, &this->vbo);
+            glBindVertexArray(this->vao);
+            glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+            glEnableVertexAttribArray(1);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindVertexArray(0);
+
+            glGenTextures(1, &this->map);
+            glBindTexture(GL_TEXTURE_2D, this->map);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, map_width, map_height, 0, GL_RG, GL_FLOAT, offset_map.data());
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+            glGenTextures(1, &this->input);
+            glBindTexture(GL_TEXTURE_2D, this->input);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+            glGenTextures(1, &this->output);
+            glBindTexture(GL_TEXTURE_2D, this->output);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+            glGenFramebuffers(1, &this->fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->output, 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) return -1;
+            return this->ring.Init(width, height, 1);
+        }
+
+        void Draw(int width, int height) {
+            glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+            glViewport(0, 0, width, height);
+            glUseProgram(this->program);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, this->input);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, this->map);
+            glBindVertexArray(this->vao);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+        }
+
+        void Release() {
+            this->ring.Release();
+            glDeleteFramebuffers(1, &this->fbo);
+            glDeleteTextures(1, &this->output);
+            glDeleteTextures(1, &this->input);
+            glDeleteTextures(1, &this->map);
+            glDeleteVertexArrays(1, &this->vao);
+            glDeleteBuffers(1, &this->vbo);
+            glDeleteProgram(this->program);
+        }
+    };
+
+    int run_size(SizeResult& result, const std::string& source_path, const std::string& output_path, const std::vector<float>& offset_map, bool use_gl) {
+        AVFormatContext* in_fmt = nullptr;
+        if (avformat_open_input(&in_fmt, source_path.c_str(), NULL, NULL) != 0 || avformat_find_stream_info(in_fmt, NULL) < 0) {
+            std::cerr << "Error: Could not open the synthetic source." << std::endl;
+            avformat_close_input(&in_fmt);
+            return -1;
+        }
+        int stream_index = av_find_best_stream(in_fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+        const AVCodec* decoder = stream_index >= 0 ? avcodec_find_decoder(in_fmt->streams[stream_index]->codecpar->codec_id) : nullptr;
+        AVCodecContext* dec = decoder ? avcodec_alloc_context3(decoder) : nullptr;
+        UnsafeYT::EncoderProfile profile = UnsafeYT::EncoderProfile::Preset("throughput", "libx264");
+        if (!dec) {
+            avformat_close_input(&in_fmt);
+            return -1;
+        }
+        avcodec_parameters_to_context(dec, in_fmt->streams[stream_index]->codecpar);
+        profile.ConfigureDecoder(dec);
+        if (avcodec_open2(dec, decoder, NULL) < 0) {
+            avcodec_free_context(&dec);
+            avformat_close_input(&in_fmt);
+            return -1;
+        }
+        int width = dec->width;
+        int height = dec->height;
+
+        AVFormatContext* out_fmt = nullptr;
+        const AVCodec* encoder = avcodec_find_encoder_by_name(profile.codec.c_str());
+        AVCodecContext* enc = encoder ? avcodec_alloc_context3(encoder) : nullptr;
+        AVStream* out_stream = nullptr;
+        int ret = -1;
+        if (enc && avformat_alloc_output_context2(&out_fmt, NULL, NULL, output_path.c_str()) >= 0) {
+            out_stream = avformat_new_stream(out_fmt, encoder);
+            enc->width = width;
+            enc->height = height;
+            enc->pix_fmt = AV_PIX_FMT_YUV420P;
+            enc->time_base = AVRational{1, 30};
+            profile.ConfigureEncoder(enc);
+            if (out_fmt->oformat->flags & AVFMT_GLOBALHEADER) enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+            AVDictionary* options = profile.EncoderOptions();
+            if (out_stream && avcodec_open2(enc, encoder, &options) >= 0 && avcodec_parameters_from_context(out_stream->codecpar, enc) >= 0
+                && avio_open(&out_fmt->pb, output_path.c_str(), AVIO_FLAG_WRITE) >= 0 && avformat_write_header(out_fmt, NULL) >= 0) {
+                ret = 0;
+            }
+            av_dict_free(&options);
+        }
+
+        SwsContext* sws = sws_getContext(width, height, dec->pix_fmt, width, height, AV_PIX_FMT_RGB24, SWS_POINT, NULL, NULL, NULL);
+        SwsContext* out_sws = sws_getContext(width, height, AV_PIX_FMT_RGB24, width, height, AV_PIX_FMT_YUV420P, SWS_POINT, NULL, NULL, NULL);
+        AVFrame* decoded = av_frame_alloc();
+        AVFrame* rgb = av_frame_alloc();
+        AVFrame* remapped = av_frame_alloc();
+        AVFrame* reference = av_frame_alloc();
+        AVFrame* candidate = av_frame_alloc();
+        AVFrame* yuv = av_frame_alloc();
+        AVPacket* packet = av_packet_alloc();
+        AVPacket* out_packet = av_packet_alloc();
+        auto allocate = [&](AVFrame* frame, AVPixelFormat format) {
+            frame->format = format;
+            frame->width = width;
+            frame->height = height;
+            return av_frame_get_buffer(frame, 0) >= 0;
+        };
+        if (ret == 0 && (!sws || !out_sws || !decoded || !packet || !out_packet || !allocate(rgb, AV_PIX_FMT_RGB24)
+                         || !allocate(remapped, AV_PIX_FMT_RGB24) || !allocate(reference, AV_PIX_FMT_RGB24) || !allocate(candidate, AV_PIX_FMT_RGB24) || !allocate(yuv, AV_PIX_FMT_YUV420P))) {
+            ret = -1;
+        }
+
+        UnsafeYT::CpuRemapper remapper;
+        UnsafeYT::CpuRemapper scalar;
+        UnsafeYT::CpuRemapper checked;
+        scalar.kernel = UnsafeYT::RemapKernel::Scalar;
+        // Every vector kernel this machine runs is checked against the scalar one.
+        std::vector<UnsafeYT::RemapKernel> vector_kernels;
+        UnsafeYT::RemapKernel failed_kernel = UnsafeYT::RemapKernel::Scalar;
+#if defined(__x86_64__) || defined(__i386__)
+        if (remapper.kernel == UnsafeYT::RemapKernel::AVX2) vector_kernels.push_back(UnsafeYT::RemapKernel::SSE41);
+#endif
+        if (remapper.kernel != UnsafeYT::RemapKernel::Scalar) vector_kernels.push_back(remapper.kernel);
+        GLStage gl;
+        bool gl_ready = false;
+        if (ret == 0) {
+            try {
+                remapper.Prepare(offset_map, {}, 80, 80, width, height, rgb->linesize[0]);
+                scalar.plan = remapper.plan;
+                checked.plan = remapper.plan;
+            }
+            catch (const std::runtime_error& e) {
+                std::cerr << "Error preparing CPU remap: " << e.what() << std::endl;
+                ret = -1;
+            }
+            gl_ready = use_gl && gl.Init(width, height, offset_map, 80, 80) == 0;
+            if (use_gl && !gl_ready) std::cerr << "Warning: GL stages skipped for " << result.name << "." << std::endl;
+            if (gl_ready) result.gl_differences = 0;
+        }
+        bool kernel_exact = true;
+        bool gl_within_tolerance = true;
+
+        int64_t pts = 0;
+        auto encode = [&](AVFrame* frame) {
+            auto started = Clock::now();
+            avcodec_send_frame(enc, frame);
+            int64_t mux_ns = 0;
+            int64_t encode_ns = 0;
+            while (true) {
+                auto receive_started = Clock::now();
+                int received = avcodec_receive_packet(enc, out_packet);
+                encode_ns += elapsed_ns(receive_started);
+                if (received < 0) break;
+                av_packet_rescale_ts(out_packet, enc->time_base, out_stream->time_base);
+                out_packet->stream_index = out_stream->index;
+                auto mux_started = Clock::now();
+                av_interleaved_write_frame(out_fmt, out_packet);
+                mux_ns += elapsed_ns(mux_started);
+            }
+            if (frame) {
+                result.stages["encode"].ns.push_back(elapsed_ns(started) - mux_ns);
+                result.stages["mux"].ns.push_back(mux_ns);
+            }
+        };
+
+        auto process = [&](int64_t decode_ns) {
+            result.stages["decode"].ns.push_back(decode_ns);
+
+            auto started = Clock::now();
+            sws_scale(sws, decoded->data, decoded->linesize, 0, height, rgb->data, rgb->linesize);
+            result.stages["sws"].ns.push_back(elapsed_ns(started));
+
+            started = Clock::now();
+            remapper.Apply(rgb, remapped);
+            result.stages["cpu_remap"].ns.push_back(elapsed_ns(started));
+
+            if (!vector_kernels.empty()) {
+                scalar.Apply(rgb, reference);
+                for (UnsafeYT::RemapKernel kernel : vector_kernels) {
+                    int max_difference = 0;
+                    checked.kernel = kernel;
+                    checked.Apply(rgb, candidate);
+                    int64_t differing = compare_rgb(candidate->data[0], candidate->linesize[0], reference->data[0], reference->linesize[0],
+                                                    remapper.plan, 0, max_difference, kernel_exact);
+                    if (differing) failed_kernel = kernel;
+                    result.kernel_differences += differing;
+                }
+            }
+
+            const uint8_t* converted_data[4] = {remapped->data[0], nullptr, nullptr, nullptr};
+            int converted_linesize[4] = {remapped->linesize[0], 0, 0, 0};
+            const uint8_t* pixels = nullptr;
+            if (gl_ready) {
+                started = Clock::now();
+                uint8_t* upload = gl.ring.BeginUpload();
+                for (int y = 0; upload && y < height; y++) {
+                    std::memcpy(upload + static_cast<size_t>(y) * gl.ring.Stride(), rgb->data[0] + static_cast<size_t>(y) * rgb->linesize[0], gl.ring.Stride());
+                }
+                gl.ring.EndUpload(gl.input);
+                glFinish();
+                result.stages["upload"].ns.push_back(elapsed_ns(started));
+
+                started = Clock::now();
+                gl.Draw(width, height);
+                glFinish();
+                result.stages["draw"].ns.push_back(elapsed_ns(started));
+
+                started = Clock::now();
+                gl.ring.QueueReadback();
+                pixels = gl.ring.MapOldest();
+                result.stages["readback"].ns.push_back(elapsed_ns(started));
+                if (pixels) {
+                    converted_data[0] = pixels;
+                    converted_linesize[0] = gl.ring.Stride();
+                    result.gl_differences += compare_rgb(pixels, gl.ring.Stride(), remapped->data[0], remapped->linesize[0],
+                                                         remapper.plan, 1, result.gl_max_difference, gl_within_tolerance);
+                }
+            }
+
+            started = Clock::now();
+            av_frame_make_writable(yuv);
+            sws_scale(out_sws, converted_data, converted_linesize, 0, height, yuv->data, yuv->linesize);
+            result.stages["out_sws"].ns.push_back(elapsed_ns(started));
+            if (gl_ready) gl.ring.UnmapOldest();
+
+            yuv->pts = pts++;
+            encode(yuv);
+            result.frames++;
+        };
+
+        while (ret == 0) {
+            auto started = Clock::now();
+            int read = av_read_frame(in_fmt, packet);
+            int64_t demux_ns = elapsed_ns(started);
+            if (read < 0) break;
+            if (packet->stream_index == stream_index) {
+                result.stages["demux"].ns.push_back(demux_ns);
+                started = Clock::now();
+                int sent = avcodec_send_packet(dec, packet);
+                int64_t send_ns = elapsed_ns(started);
+                while (sent >= 0) {
+                    started = Clock::now();
+                    int received = avcodec_receive_frame(dec, decoded);
+                    int64_t receive_ns = elapsed_ns(started);
+                    if (received < 0) break;
+                    process(send_ns + receive_ns);
+                    send_ns = 0;
+                    av_frame_unref(decoded);
+                }
+            }
+            av_packet_unref(packet);
+        }
+        if (ret == 0) {
+            avcodec_send_packet(dec, NULL);
+            while (true) {
+                auto started = Clock::now();
+                if (avcodec_receive_frame(dec, decoded) < 0) break;
+                process(elapsed_ns(started));
+                av_frame_unref(decoded);
+            }
+            encode(nullptr);
+            av_write_trailer(out_fmt);
+
+            if (!kernel_exact) {
+                std::cerr << "Error: The " << UnsafeYT::remap_kernel_name(failed_kernel) << " kernel differs from the scalar one in "
+                          << result.kernel_differences << " bytes at " << result.name << "." << std::endl;
+                ret = -1;
+            }
+            if (!gl_within_tolerance) {
+                std::cerr << "Error: The GL output differs from the CPU remap by up to " << result.gl_max_difference << " in "
+                          << result.gl_differences << " bytes at " << result.name << ", beyond 1 on blended pixels or on copied ones." << std::endl;
+                ret = -1;
+            }
+        }
+
+        if (gl_ready) gl.Release();
+        av_packet_free(&out_packet);
+        av_packet_free(&packet);
+        av_frame_free(&yuv);
+        av_frame_free(&candidate);
+        av_frame_free(&reference);
+        av_frame_free(&remapped);
+        av_frame_free(&rgb);
+        av_frame_free(&decoded);
+        sws_freeContext(out_sws);
+        sws_freeContext(sws);
+        avcodec_free_context(&enc);
+        if (out_fmt && out_fmt->pb) avio_closep(&out_fmt->pb);
+        avformat_free_context(out_fmt);
+        avcodec_free_context(&dec);
+        avformat_close_input(&in_fmt);
+        return ret;
+    }
+
+    // Runs the source through Video on the CPU path with each of its frame loops: serial,
+    // pipelined and the worker pool. Each has to write exactly as many frames as the source
+    // holds. The decoder gets several frame threads whatever the core count, because those
+    // hold frames back until the decoder is drained at the end of the input.
+    int check_frame_counts(const std::string& source_path, const std::string& output_path, int frames) {
+        struct Loop {
+            const char* name;
+            bool pipelined;
+            int workers;
+        };
+        const Loop loops[] = {{"serial", false, 1}, {"pipelined", true, 1}, {"parallel", true, 2}};
+
+        // Video reports on stdout, where the JSON goes.
+        std::ostringstream discarded;
+        std::streambuf* stdout_buffer = std::cout.rdbuf(discarded.rdbuf());
+        int ret = 0;
+        for (const Loop& loop : loops) {
+            UnsafeYT::Video video(vertexShaderSource, fragmentShaderSource, source_path, output_path, "bench_seed");
+            video.backend = UnsafeYT::Backend::CPU;
+            video.pipelined = loop.pipelined;
+            video.workers = loop.workers;
+            video.report_progress = false;
+            video.encoder_profile = UnsafeYT::EncoderProfile::Preset("throughput", "libx264");
+            video.encoder_profile.decoder_threads = 8;
+            if (video.Start() != 0) {
+                std::cerr << "Error: The " << loop.name << " frame loop failed." << std::endl;
+                ret = -1;
+            } else if (video.frameCount != frames) {
+                std::cerr << "Error: The " << loop.name << " frame loop wrote " << video.frameCount << " of " << frames << " frames." << std::endl;
+                ret = -1;
+            }
+        }
+        std::cout.rdbuf(stdout_buffer);
+        return ret;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> sizes = {"720p", "1080p", "4k"};
+    int frames = 120;
+    std::string json_path;
+    std::string label;
+    bool use_gl = true;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        std::string key = arg.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+        if (key == "--sizes" && !value.empty()) {
+            sizes.clear();
+            std::stringstream list(value);
+            for (std::string size; std::getline(list, size, ',');) sizes.push_back(size);
+        } else if (key == "--frames" && !value.empty()) {
+            frames = std::max(std::atoi(value.c_str()), 1);
+        } else if (key == "--json" && !value.empty()) {
+            json_path = value;
+        } else if (key == "--label") {
+            label = value;
+        } else if (key == "--no-gl") {
+            use_gl = false;
+        } else {
+            std::cerr << "Usage: video_processor_bench [--sizes=720p,1080p,4k] [--frames=N] [--json=PATH] [--label=TEXT] [--no-gl]" << std::endl;
+            return 1;
+        }
+    }
+
+    const std::map<std::string, std::pair<int, int>> known = {{"720p", {1280, 720}}, {"1080p", {1920, 1080}}, {"4k", {3840, 2160}}};
+    for (const std::string& size : sizes) {
+        if (!known.count(size)) {
+            std::cerr << "Error: Unknown size '" << size << "' (expected 720p, 1080p or 4k)." << std::endl;
+            return 1;
+        }
+    }
+
+    // The generator is timed on its own; the remap stages reuse its last map.
+    StageSamples map_samples;
+    std::vector<float> offset_map;
+    for (int i = 0; i < 20; i++) {
+        auto started = Clock::now();
+        auto maps = UnsafeYT::generate_offset_maps(80, 80, "bench_seed");
+        map_samples.ns.push_back(elapsed_ns(started));
+        offset_map = std::move(maps.first);
+    }
+
+    UnsafeYT::GLContext context;
+    std::string renderer;
+    if (use_gl) {
+        if (context.Create(UnsafeYT::ContextBackend::Auto) == 0) {
+            const GLubyte* name = glGetString(GL_RENDERER);
+            renderer = name ? reinterpret_cast<const char*>(name) : "";
+        } else {
+            std::cerr << "Warning: No GL context; GL stages are skipped." << std::endl;
+            use_gl = false;
+        }
+    }
+
+    std::filesystem::path temp = std::filesystem::temp_directory_path();
+    std::string tag = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    std::vector<SizeResult> results;
+    for (const std::string& size : sizes) {
+        SizeResult result;
+        result.name = size;
+        result.width = known.at(size).first;
+        result.height = known.at(size).second;
+        std::string source = (temp / ("uyt_bench_source_" + tag + "_" + size + ".mp4")).string();
+        std::string output = (temp / ("uyt_bench_output_" + tag + "_" + size + ".mp4")).string();
+
+        std::cerr << "Benchmarking " << size << " (" << frames << " frames)..." << std::endl;
+        int ret = make_source(source, result.width, result.height, frames);
+        if (ret == 0) ret = run_size(result, source, output, offset_map, use_gl);
+        if (ret == 0) ret = check_frame_counts(source, output, frames);
+        std::error_code error;
+        std::filesystem::remove(source, error);
+        std::filesystem::remove(output, error);
+        if (ret != 0) return 1;
+
+        std::cerr << std::fixed << std::setprecision(3);
+        for (const char* stage : STAGES) {
+            if (result.stages.count(stage)) {
+                std::cerr << "  " << std::left << std::setw(10) << stage << std::right << std::setw(10) << result.stages[stage].MeanMs() << " ms/frame" << std::endl;
+            }
+        }
+        results.push_back(std::move(result));
+    }
+
+    std::ostringstream json;
+    json << "{\n  \"label\": " << UnsafeYT::json_quote(label) << ",\n";
+    json << "  \"machine\": {\"hardware_concurrency\": " << std::thread::hardware_concurrency()
+         << ", \"gl_renderer\": " << (use_gl ? UnsafeYT::json_quote(renderer) : std::string("null"))
+         << ", \"gl_context\": " << UnsafeYT::json_quote(use_gl ? UnsafeYT::context_backend_name(context.backend) : "none")
+         << ", \"ffmpeg\": " << UnsafeYT::json_quote(av_version_info())
+         << ", \"remap_kernel\": " << UnsafeYT::json_quote(UnsafeYT::remap_kernel_name(UnsafeYT::detect_remap_kernel())) << "},\n";
+    json << "  \"unit\": \"ns/frame\",\n";
+    json << "  \"offset_maps\": " << map_samples.Json() << ",\n";
+    json << "  \"sizes\": [";
+    for (size_t r = 0; r < results.size(); r++) {
+        const SizeResult& result = results[r];
+        json << (r ? ",\n" : "\n") << "    {\"name\": " << UnsafeYT::json_quote(result.name) << ", \"width\": " << result.width
+             << ", \"height\": " << result.height << ", \"frames\": " << result.frames
+             << ", \"kernel_differences\": " << result.kernel_differences
+             << ", \"gl_differences\": " << (result.gl_differences < 0 ? std::string("null") : std::to_string(result.gl_differences))
+             << ", \"gl_max_difference\": " << result.gl_max_difference << ", \"stages\": {";
+        bool first = true;
+        for (const char* stage : STAGES) {
+            auto found = result.stages.find(stage);
+            json << (first ? "\n" : ",\n") << "      \"" << stage << "\": " << (found == result.stages.end() ? "null" : found->second.Json());
+            first = false;
+        }
+        json << "\n    }}";
+    }
+    json << "\n  ]\n}\n";
+
+    if (json_path.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream out(json_path);
+        out << json.str();
+        if (!out) {
+            std::cerr << "Error: Could not write '" << json_path << "'." << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,212 @@
+namespace UnsafeYT{
+    enum class ContextBackend {Auto, EGL, GLFW};
+
+    inline const char* context_backend_name(ContextBackend backend) {
+        switch (backend) {
+            case ContextBackend::EGL: return "EGL";
+            case ContextBackend::GLFW: return "GLFW";
+            default: return "auto";
+        }
+    }
+
+    // The OpenGL 3.3 core context of the GL path. All rendering goes to framebuffer objects,
+    // so no window surface is ever needed. EGL runs without a display server: it uses Mesa's
+    // surfaceless platform, else the first EGL device, and makes the context current with no
+    // surface at all. GLFW opens a hidden 1x1 window and so needs X11 or Wayland. Auto tries
+    // EGL first and falls back to GLFW. Setting window_width and window_height opens a visible
+    // GLFW window of that size instead (see Player); EGL is skipped then, having no surfaces.
+    class GLContext {
+    public:
+        GLContext() = default;
+        GLContext(const GLContext&) = delete;
+        GLContext& operator=(const GLContext&) = delete;
+        ~GLContext() { this->Destroy(); }
+
+        int Create(ContextBackend requested) {
+            this->Destroy();
+            bool visible = this->window_width > 0 && this->window_height > 0;
+            if (visible && requested == ContextBackend::EGL) {
+                std::cerr << "Error: EGL contexts have no window; use a GLFW context to show frames." << std::endl;
+                return -1;
+            }
+            if (requested != ContextBackend::GLFW && !visible) {
+                if (this->CreateEGL() == 0) {
+                    this->backend = ContextBackend::EGL;
+                    return 0;
+                }
+                this->Destroy();
+                if (requested == ContextBackend::EGL) {
+                    std::cerr << "Failed to create a headless EGL context" << std::endl;
+                    return -1;
+                }
+                std::cerr << "Warning: No headless EGL context available; falling back to GLFW." << std::endl;
+            }
+            if (this->CreateGLFW() == 0) {
+                this->backend = ContextBackend::GLFW;
+                return 0;
+            }
+            this->Destroy();
+            return -1;
+        }
+
+        void Destroy() {
+            if (this->window) {
+                glfwDestroyWindow(this->window);
+                this->window = nullptr;
+            }
+            if (this->glfw_initialized) {
+                glfwTerminate();
+                this->glfw_initialized = false;
+            }
+        #ifdef HAVE_EGL
+            if (this->display != EGL_NO_DISPLAY) {
+                eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                if (this->context != EGL_NO_CONTEXT) eglDestroyContext(this->display, this->context);
+                eglTerminate(this->display);
+                eglReleaseThread();
+            }
+            this->display = EGL_NO_DISPLAY;
+            this->context = EGL_NO_CONTEXT;
+        #endif
+            this->active = false;
+        }
+
+        bool Active() const { return this->active; }
+
+        // Processes window events; false once the window was asked to close, or Escape was
+        // pressed in a visible one. Always true for EGL, which has no window.
+        bool Poll() {
+            if (this->window) {
+                glfwPollEvents();
+                if (this->window_width > 0 && glfwGetKey(this->window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+                    return false;
+                }
+                return !glfwWindowShouldClose(this->window);
+            }
+            return true;
+        }
+
+        // Shows the back buffer of a visible window.
+        void SwapBuffers() {
+            if (this->window) glfwSwapBuffers(this->window);
+        }
+
+        // Drawable size of the window in pixels, which differs from the window size on HiDPI
+        // displays.
+        void FramebufferSize(int& width, int& height) const {
+            width = height = 0;
+            if (this->window) glfwGetFramebufferSize(this->window, &width, &height);
+        }
+
+        ContextBackend backend = ContextBackend::Auto;
+        int window_width = 0;
+        int window_height = 0;
+        std::string window_title = "UnsafeYT";
+
+    private:
+        int CreateEGL() {
+        #ifdef HAVE_EGL
+            auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            if (!get_platform_display) return -1;
+
+            const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+            std::string extensions = client_extensions ? client_extensions : "";
+            if (extensions.find("EGL_MESA_platform_surfaceless") != std::string::npos) {
+                this->display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            }
+            if (this->display == EGL_NO_DISPLAY && extensions.find("EGL_EXT_platform_device") != std::string::npos) {
+                auto query_devices = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(eglGetProcAddress("eglQueryDevicesEXT"));
+                EGLDeviceEXT device;
+                EGLint devices = 0;
+                if (query_devices && query_devices(1, &device, &devices) && devices > 0) {
+                    this->display = get_platform_display(EGL_PLATFORM_DEVICE_EXT, device, NULL);
+                }
+            }
+            if (this->display == EGL_NO_DISPLAY) return -1;
+
+            EGLint major = 0, minor = 0;
+            if (!eglInitialize(this->display, &major, &minor)) {
+                eglTerminate(this->display);
+                this->display = EGL_NO_DISPLAY;
+                return -1;
+            }
+            const char* display_extensions = eglQueryString(this->display, EGL_EXTENSIONS);
+            if (!display_extensions || std::string(display_extensions).find("EGL_KHR_surfaceless_context") == std::string::npos) {
+                return -1;
+            }
+            if (!eglBindAPI(EGL_OPENGL_API)) return -1;
+
+            // A surface type of 0 matches every config; the context never gets a surface.
+            const EGLint config_attributes[] = {
+                EGL_SURFACE_TYPE, 0,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_NONE
+            };
+            EGLConfig config;
+            EGLint configs = 0;
+            if (!eglChooseConfig(this->display, config_attributes, &config, 1, &configs) || configs < 1) return -1;
+
+            const EGLint context_attributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, 3,
+                EGL_CONTEXT_MINOR_VERSION, 3,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE
+            };
+            this->context = eglCreateContext(this->display, config, EGL_NO_CONTEXT, context_attributes);
+            if (this->context == EGL_NO_CONTEXT) return -1;
+            if (!eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, this->context)) return -1;
+
+            // GLEW built for GLX reports a missing X display after loading the core entry
+            // points; that is expected here.
+            glewExperimental = GL_TRUE;
+            GLenum glew = glewInit();
+            if (glew != GLEW_OK && glew != GLEW_ERROR_NO_GLX_DISPLAY) return -1;
+            glGetError();
+            this->active = true;
+            return 0;
+        #else
+            return -1;
+        #endif
+        }
+
+        int CreateGLFW() {
+            if (!glfwInit()) {
+                std::cerr << "Failed to initialize GLFW" << std::endl;
+                return -1;
+            }
+            this->glfw_initialized = true;
+
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+            bool visible = this->window_width > 0 && this->window_height > 0;
+            glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+
+            this->window = visible ? glfwCreateWindow(this->window_width, this->window_height, this->window_title.c_str(), NULL, NULL)
+                                   : glfwCreateWindow(1, 1, "OpenGL Context", NULL, NULL);
+            if (!this->window) {
+                std::cerr << "Failed to create GLFW window or OpenGL context" << std::endl;
+                return -1;
+            }
+            glfwMakeContextCurrent(this->window);
+            // Frames are paced by their timestamps; waiting for vblank on top would only add latency.
+            if (visible) glfwSwapInterval(0);
+
+            glewExperimental = GL_TRUE;
+            if (glewInit() != GLEW_OK) {
+                std::cerr << "Failed to initialize GLEW" << std::endl;
+                return -1;
+            }
+            this->active = true;
+            return 0;
+        }
+
+        bool active = false;
+        GLFWwindow* window = nullptr;
+        bool glfw_initialized = false;
+    #ifdef HAVE_EGL
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLContext context = EGL_NO_CONTEXT;
+    #endif
+    };
+}
@@ -0,0 +1,202 @@
+namespace UnsafeYT{
+    // Encoder and decoder settings of a run. A profile starts from a named preset for its codec
+    // and is then overridden member by member, from a JSON file and then from the command line,
+    // with objects such as
+    //
+    //     {"profile": "balanced", "codec": "libx265", "gop_size": 120, "encoder_threads": 8,
+    //      "encoder_thread_type": "frame", "options": {"crf": 20}}
+    //
+    // Thread counts of 0 let libavcodec pick; thread types are "frame", "slice", "frame+slice"
+    // or "auto" (the codec's own choice). "options" are the codec's private AVOptions.
+    struct EncoderProfile {
+        std::string name = "throughput";
+        std::string codec = "libx264";
+        int gop_size = 5;
+        int max_b_frames = 2;
+        int64_t bit_rate = 0;
+        int encoder_threads = 0;
+        int encoder_thread_type = 0;
+        int decoder_threads = 0;
+        int decoder_thread_type = 0;
+        std::vector<std::pair<std::string, std::string>> options;
+
+        static bool IsPreset(const std::string& name) {
+            return name == "throughput" || name == "balanced" || name == "archive";
+        }
+
+        // throughput: fastest lossless-ish encode, short GOPs (the historical settings).
+        // balanced:   visually lossless at a fraction of the size.
+        // archive:    mathematically lossless, slow.
+        // Codecs without a table entry get the shared GOP and threading settings only.
+        static EncoderProfile Preset(const std::string& name, const std::string& codec) {
+            if (!IsPreset(name)) {
+                throw std::runtime_error("Unknown encoder profile '" + name + "' (expected throughput, balanced or archive).");
+            }
+            EncoderProfile profile;
+            profile.name = name;
+            profile.codec = codec;
+            profile.encoder_thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+            profile.decoder_thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+            if (name == "throughput") {
+                profile.gop_size = 5;
+                profile.max_b_frames = 2;
+                profile.bit_rate = 64'000'000;
+            } else if (name == "balanced") {
+                profile.gop_size = 120;
+                profile.max_b_frames = 3;
+            } else {
+                profile.gop_size = 250;
+                profile.max_b_frames = 3;
+            }
+
+            if (codec == "libx264") {
+                if (name == "throughput") profile.options = {{"preset", "ultrafast"}, {"crf", "0"}, {"qp", "0"}};
+                else if (name == "balanced") profile.options = {{"preset", "veryfast"}, {"crf", "16"}};
+                else profile.options = {{"preset", "slower"}, {"qp", "0"}};
+            } else if (codec == "libx265") {
+                if (name == "throughput") profile.options = {{"preset", "ultrafast"}, {"x265-params", "lossless=1"}};
+                else if (name == "balanced") profile.options = {{"preset", "fast"}, {"crf", "18"}};
+                else profile.options = {{"preset", "slow"}, {"x265-params", "lossless=1"}};
+            } else if (codec == "ffv1") {
+                // Intra-only; B-frames and GOP length do not apply.
+                profile.gop_size = 1;
+                profile.max_b_frames = 0;
+                profile.bit_rate = 0;
+                profile.encoder_thread_type = FF_THREAD_SLICE;
+                if (name == "archive") profile.options = {{"level", "3"}, {"slicecrc", "1"}, {"context", "1"}};
+                else profile.options = {{"level", "3"}};
+            }
+            return profile;
+        }
+
+        // Builds the profile described by `layers`, applied in order: each may name the preset
+        // and codec, and overrides the members it mentions.
+        static EncoderProfile Resolve(const std::vector<JsonValue>& layers) {
+            std::string name = "throughput";
+            std::string codec = "libx264";
+            for (const JsonValue& layer : layers) {
+                if (const JsonValue* v = layer.Find("profile")) name = v->AsString("profile");
+                if (const JsonValue* v = layer.Find("codec")) codec = v->AsString("codec");
+            }
+            EncoderProfile profile = Preset(name, codec);
+            for (const JsonValue& layer : layers) {
+                profile.Apply(layer);
+            }
+            return profile;
+        }
+
+        static JsonValue LoadFile(const std::string& path) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) throw std::runtime_error("Could not read encoder profile '" + path + "'.");
+            std::stringstream text;
+            text << in.rdbuf();
+            JsonValue value = JsonValue::Parse(text.str());
+            if (!value.IsObject()) throw std::runtime_error("Encoder profile '" + path + "' must be a JSON object.");
+            return value;
+        }
+
+        static int ParseThreadType(const std::string& value) {
+            if (value == "frame") return FF_THREAD_FRAME;
+            if (value == "slice") return FF_THREAD_SLICE;
+            if (value == "frame+slice") return FF_THREAD_FRAME | FF_THREAD_SLICE;
+            if (value == "auto") return 0;
+            throw std::runtime_error("Thread type must be frame, slice, frame+slice or auto.");
+        }
+
+        static std::string ThreadTypeName(int type) {
+            if (type == (FF_THREAD_FRAME | FF_THREAD_SLICE)) return "frame+slice";
+            if (type == FF_THREAD_FRAME) return "frame";
+            if (type == FF_THREAD_SLICE) return "slice";
+            return "none";
+        }
+
+        void SetOption(const std::string& key, const std::string& value) {
+            for (auto& option : this->options) {
+                if (option.first == key) {
+                    option.second = value;
+                    return;
+                }
+            }
+            this->options.emplace_back(key, value);
+        }
+
+        void Apply(const JsonValue& layer) {
+            if (!layer.IsObject()) throw std::runtime_error("Encoder profile must be a JSON object.");
+            for (const auto& member : layer.object) {
+                const std::string& key = member.first;
+                const JsonValue& value = member.second;
+                if (key == "profile" || key == "codec") {
+                    continue;
+                } else if (key == "gop_size") {
+                    this->gop_size = static_cast<int>(value.AsInteger(key));
+                } else if (key == "max_b_frames") {
+                    this->max_b_frames = static_cast<int>(value.AsInteger(key));
+                } else if (key == "bit_rate") {
+                    this->bit_rate = value.AsInteger(key);
+                } else if (key == "encoder_threads") {
+                    this->encoder_threads = static_cast<int>(value.AsInteger(key));
+                } else if (key == "decoder_threads") {
+                    this->decoder_threads = static_cast<int>(value.AsInteger(key));
+                } else if (key == "encoder_thread_type") {
+                    this->encoder_thread_type = ParseThreadType(value.AsString(key));
+                } else if (key == "decoder_thread_type") {
+                    this->decoder_thread_type = ParseThreadType(value.AsString(key));
+                } else if (key == "options") {
+                    if (!value.IsObject()) throw std::runtime_error("options must be a JSON object.");
+                    for (const auto& option : value.object) {
+                        this->SetOption(option.first, option.second.AsText("options." + option.first));
+                    }
+                } else {
+                    throw std::runtime_error("Unknown encoder profile setting '" + key + "'.");
+                }
+            }
+            if (this->gop_size < 0 || this->max_b_frames < 0 || this->bit_rate < 0 || this->encoder_threads < 0 || this->decoder_threads < 0) {
+                throw std::runtime_error("Encoder profile values must not be negative.");
+            }
+        }
+
+        // Thread settings must be in place before avcodec_open2.
+        void ConfigureDecoder(AVCodecContext* ctx) const {
+            ctx->thread_count = this->decoder_threads;
+            if (this->decoder_thread_type) ctx->thread_type = this->decoder_thread_type;
+        }
+
+        void ConfigureEncoder(AVCodecContext* ctx) const {
+            ctx->gop_size = this->gop_size;
+            ctx->max_b_frames = this->max_b_frames;
+            ctx->bit_rate = this->bit_rate;
+            ctx->thread_count = this->encoder_threads;
+            if (this->encoder_thread_type) ctx->thread_type = this->encoder_thread_type;
+        }
+
+        AVDictionary* EncoderOptions() const {
+            AVDictionary* dict = nullptr;
+            for (const auto& option : this->options) {
+                av_dict_set(&dict, option.first.c_str(), option.second.c_str(), 0);
+            }
+            return dict;
+        }
+
+        // What the opened codec contexts actually use. `unused` is the option dictionary as
+        // avcodec_open2 left it: whatever the encoder did not recognise.
+        void Print(std::ostream& out, const AVCodecContext* decoder, const AVCodecContext* encoder, const AVDictionary* unused) const {
+            out << "Encoder profile: " << this->name << ", " << encoder->codec->name << " (" << av_get_pix_fmt_name(encoder->pix_fmt) << ")" << std::endl;
+            out << "  gop " << encoder->gop_size << ", b-frames " << encoder->max_b_frames
+                << ", bit rate " << (encoder->bit_rate ? std::to_string(encoder->bit_rate) : std::string("codec default")) << std::endl;
+            out << "  encoder threads " << encoder->thread_count << " (" << ThreadTypeName(encoder->active_thread_type) << ")"
+                << ", decoder threads " << decoder->thread_count << " (" << ThreadTypeName(decoder->active_thread_type) << ")" << std::endl;
+            if (!this->options.empty()) {
+                out << "  options";
+                for (const auto& option : this->options) {
+                    if (!av_dict_get(unused, option.first.c_str(), NULL, 0)) out << " " << option.first << "=" << option.second;
+                }
+                out << std::endl;
+            }
+            const AVDictionaryEntry* entry = nullptr;
+            while ((entry = av_dict_get(unused, "", entry, AV_DICT_IGNORE_SUFFIX))) {
+                std::cerr << "Warning: Encoder " << encoder->codec->name << " ignored option " << entry->key << "=" << entry->value << std::endl;
+            }
+        }
+    };
+}
@@ -0,0 +1,199 @@
+namespace UnsafeYT{
+    struct Job {
+        std::string id;
+        std::string input;
+        std::string output;
+        std::string seed;
+    };
+
+    // Batch mode: runs jobs from a manifest or from newline-delimited JSON on stdin, such as
+    //
+    //     {"id": "clip-1", "input": "a.mp4", "output": "a.out.mp4", "seed": "token"}
+    //
+    // on up to `concurrency` workers at once. "id" defaults to the job's line (or array index)
+    // and "seed" to the seed given on the command line. A manifest is either a JSON array of
+    // such objects or one object per line.
+    //
+    // Every worker keeps one Video for its whole life, so its GL context and program, offset
+    // map, remap plans and conversion contexts are built once and only redone when a job's
+    // seed or resolution differs from the worker's previous job. Each job ends with one record
+    // on stdout:
+    //
+    //     {"event":"job","job":"clip-1","ok":true,"frames":900,"elapsed":15.2,"setup_ms":3.1,
+    //      "map_reused":true,"gl_reused":true}
+    //
+    // Jobs that cannot be parsed get {"event":"job","job":...,"ok":false,"error":...}.
+    class JobRunner {
+    public:
+        using Factory = std::function<std::unique_ptr<Video>()>;
+
+        JobRunner(Factory factory, std::string default_seed, int concurrency)
+            : factory(std::move(factory)), default_seed(std::move(default_seed)), concurrency(std::max(concurrency, 1)) {}
+
+        // Returns 0 once every job succeeded, 1 if any failed.
+        int Run(std::istream& in) {
+            std::thread reader([&]() { this->Read(in); });
+
+            // Worker 0 runs on the calling thread, which keeps a GLFW context on the main
+            // thread; the others can only use EGL, which has no such restriction.
+            std::vector<std::thread> threads;
+            for (int i = 1; i < this->concurrency; i++) {
+                threads.emplace_back([this, i]() { this->Work(i); });
+            }
+            this->Work(0);
+
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            reader.join();
+            return this->failures.load() == 0 ? 0 : 1;
+        }
+
+        static Job ParseJob(const JsonValue& value, const std::string& fallback_id, const std::string& default_seed) {
+            if (!value.IsObject()) throw std::runtime_error("A job must be a JSON object.");
+            Job job;
+            job.id = fallback_id;
+            job.seed = default_seed;
+            for (const auto& member : value.object) {
+                const std::string& key = member.first;
+                if (key == "id") job.id = member.second.AsText(key);
+                else if (key == "input") job.input = member.second.AsString(key);
+                else if (key == "output") job.output = member.second.AsString(key);
+                else if (key == "seed") job.seed = member.second.AsText(key);
+                else throw std::runtime_error("Unknown job setting '" + key + "'.");
+            }
+            if (job.input.empty() || job.output.empty()) {
+                throw std::runtime_error("A job needs an input and an output.");
+            }
+            if (PipeIO::IsPipe(job.input) || PipeIO::IsPipe(job.output)) {
+                throw std::runtime_error("Jobs cannot use stdin or stdout; those carry the jobs and their records.");
+            }
+            return job;
+        }
+
+    private:
+        void Read(std::istream& in) {
+            std::string line;
+            long number = 0;
+            while (std::getline(in, line)) {
+                number++;
+                size_t start = line.find_first_not_of(" \t\r");
+                if (start == std::string::npos) continue;
+
+                // A manifest that is one JSON array, possibly spread over many lines.
+                if (line[start] == '[') {
+                    std::stringstream rest;
+                    rest << line << '\n' << in.rdbuf();
+                    this->ReadArray(rest.str());
+                    break;
+                }
+
+                std::string id = std::to_string(number);
+                try {
+                    this->Push(ParseJob(JsonValue::Parse(line), id, this->default_seed));
+                }
+                catch (const std::exception& e) {
+                    this->Reject(id, e.what());
+                }
+            }
+            this->Close();
+        }
+
+        void ReadArray(const std::string& text) {
+            JsonValue manifest;
+            try {
+                manifest = JsonValue::Parse(text);
+            }
+            catch (const std::exception& e) {
+                this->Reject("manifest", e.what());
+                return;
+            }
+            if (manifest.type != JsonValue::Type::Array) {
+                this->Reject("manifest", "A manifest must be a JSON array of jobs.");
+                return;
+            }
+            for (size_t i = 0; i < manifest.array.size(); i++) {
+                std::string id = std::to_string(i + 1);
+                try {
+                    this->Push(ParseJob(manifest.array[i], id, this->default_seed));
+                }
+                catch (const std::exception& e) {
+                    this->Reject(id, e.what());
+                }
+            }
+        }
+
+        void Push(Job job) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->pending.push_back(std::move(job));
+            this->ready.notify_one();
+        }
+
+        void Close() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->closed = true;
+            this->ready.notify_all();
+        }
+
+        bool Pop(Job& job) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->ready.wait(lock, [this]() { return this->closed || !this->pending.empty(); });
+            if (this->pending.empty()) return false;
+            job = std::move(this->pending.front());
+            this->pending.pop_front();
+            return true;
+        }
+
+        // The Video is created lazily so an idle worker holds no GL context.
+        void Work(int worker) {
+            std::unique_ptr<Video> video;
+            Job job;
+            while (this->Pop(job)) {
+                if (!video) {
+                    video = this->factory();
+                    if (worker > 0 && video->context_backend == ContextBackend::Auto) {
+                        video->context_backend = ContextBackend::EGL;
+                    }
+                }
+                video->inpath = job.input;
+                video->outpath = job.output;
+                video->seed = job.seed;
+                video->telemetry.SetJob(job.id);
+
+                auto started = std::chrono::steady_clock::now();
+                bool ok = video->Start() == 0;
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+                if (!ok) {
+                    video->telemetry.Done(false, video->frameCount);
+                    this->failures++;
+                }
+
+                char numbers[256];
+                std::snprintf(numbers, sizeof(numbers), "\"frames\":%ld,\"elapsed\":%.3f,\"setup_ms\":%.2f,\"map_reused\":%s,\"gl_reused\":%s}\n",
+                              video->frameCount, elapsed, video->setup_ms, video->map_reused ? "true" : "false", video->gl_reused ? "true" : "false");
+                Write("{\"event\":\"job\",\"job\":" + json_quote(job.id) + ",\"ok\":" + (ok ? "true," : "false,") + numbers);
+                video->Close();
+            }
+        }
+
+        void Reject(const std::string& id, const std::string& error) {
+            this->failures++;
+            Write("{\"event\":\"job\",\"job\":" + json_quote(id) + ",\"ok\":false,\"error\":" + json_quote(error) + "}\n");
+        }
+
+        // One fwrite per record, so records of concurrent jobs never interleave.
+        static void Write(const std::string& record) {
+            std::fwrite(record.data(), 1, record.size(), stdout);
+            std::fflush(stdout);
+        }
+
+        Factory factory;
+        std::string default_seed;
+        int concurrency;
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<Job> pending;
+        bool closed = false;
+        std::atomic<int> failures{0};
+    };
+}
@@ -0,0 +1,268 @@
+namespace UnsafeYT{
+    // Small JSON document model for profile files and other structured input. Objects keep
+    // their members in file order; numbers are doubles.
+    class JsonValue {
+    public:
+        enum class Type {Null, Bool, Number, String, Array, Object};
+
+        JsonValue() = default;
+        static JsonValue Bool(bool value) { JsonValue v; v.type = Type::Bool; v.boolean = value; return v; }
+        static JsonValue Number(double value) { JsonValue v; v.type = Type::Number; v.number = value; return v; }
+        static JsonValue String(std::string value) { JsonValue v; v.type = Type::String; v.string = std::move(value); return v; }
+        static JsonValue Object() { JsonValue v; v.type = Type::Object; return v; }
+
+        bool IsNull() const { return this->type == Type::Null; }
+        bool IsObject() const { return this->type == Type::Object; }
+
+        const JsonValue* Find(const std::string& key) const {
+            for (const auto& member : this->object) {
+                if (member.first == key) return &member.second;
+            }
+            return nullptr;
+        }
+
+        // Adds the member, replacing an existing one with the same key.
+        void Set(const std::string& key, JsonValue value) {
+            for (auto& member : this->object) {
+                if (member.first == key) {
+                    member.second = std::move(value);
+                    return;
+                }
+            }
+            this->object.emplace_back(key, std::move(value));
+        }
+
+        std::string AsString(const std::string& what) const {
+            if (this->type != Type::String) throw std::runtime_error(what + " must be a string.");
+            return this->string;
+        }
+
+        // Integers may also be given as strings, as they are on the command line.
+        long long AsInteger(const std::string& what) const {
+            if (this->type == Type::Number && this->number == std::floor(this->number)) return static_cast<long long>(this->number);
+            if (this->type == Type::String) {
+                size_t used = 0;
+                long long value = std::stoll(this->string, &used);
+                if (used == this->string.size()) return value;
+            }
+            throw std::runtime_error(what + " must be an integer.");
+        }
+
+        // Strings as they are, numbers and booleans in their JSON spelling.
+        std::string AsText(const std::string& what) const {
+            if (this->type == Type::String) return this->string;
+            if (this->type == Type::Bool) return this->boolean ? "true" : "false";
+            if (this->type == Type::Number) {
+                if (this->number == std::floor(this->number) && std::fabs(this->number) < 1e15) {
+                    return std::to_string(static_cast<long long>(this->number));
+                }
+                std::ostringstream text;
+                text << this->number;
+                return text.str();
+            }
+            throw std::runtime_error(what + " must be a string, number or boolean.");
+        }
+
+        static JsonValue Parse(const std::string& text) {
+            size_t pos = 0;
+            JsonValue value = ParseValue(text, pos, 0);
+            SkipSpace(text, pos);
+            if (pos != text.size()) Fail("unexpected trailing characters", pos);
+            return value;
+        }
+
+        Type type = Type::Null;
+        bool boolean = false;
+        double number = 0.0;
+        std::string string;
+        std::vector<JsonValue> array;
+        std::vector<std::pair<std::string, JsonValue>> object;
+
+    private:
+        static constexpr int MAX_DEPTH = 64;
+
+        [[noreturn]] static void Fail(const char* message, size_t pos) {
+            throw std::runtime_error(std::string("Invalid JSON: ") + message + " at offset " + std::to_string(pos) + ".");
+        }
+
+        static void SkipSpace(const std::string& text, size_t& pos) {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) pos++;
+        }
+
+        static bool Consume(const std::string& text, size_t& pos, const char* literal) {
+            size_t length = std::strlen(literal);
+            if (text.compare(pos, length, literal) != 0) return false;
+            pos += length;
+            return true;
+        }
+
+        static JsonValue ParseValue(const std::string& text, size_t& pos, int depth) {
+            if (depth > MAX_DEPTH) Fail("nesting too deep", pos);
+            SkipSpace(text, pos);
+            if (pos >= text.size()) Fail("unexpected end of input", pos);
+
+            char c = text[pos];
+            if (c == '{') {
+                JsonValue value = Object();
+                pos++;
+                SkipSpace(text, pos);
+                if (pos < text.size() && text[pos] == '}') {
+                    pos++;
+                    return value;
+                }
+                while (true) {
+                    SkipSpace(text, pos);
+                    if (pos >= text.size() || text[pos] != '"') Fail("expected a member name", pos);
+                    std::string key = ParseString(text, pos);
+                    SkipSpace(text, pos);
+                    if (pos >= text.size() || text[pos] != ':') Fail("expected ':'", pos);
+                    pos++;
+                    value.object.emplace_back(std::move(key), ParseValue(text, pos, depth + 1));
+                    SkipSpace(text, pos);
+                    if (pos < text.size() && text[pos] == ',') {
+                        pos++;
+                    } else if (pos < text.size() && text[pos] == '}') {
+                        pos++;
+                        return value;
+                    } else {
+                        Fail("expected ',' or '}'", pos);
+                    }
+                }
+            }
+            if (c == '[') {
+                JsonValue value;
+                value.type = Type::Array;
+                pos++;
+                SkipSpace(text, pos);
+                if (pos < text.size() && text[pos] == ']') {
+                    pos++;
+                    return value;
+                }
+                while (true) {
+                    value.array.push_back(ParseValue(text, pos, depth + 1));
+                    SkipSpace(text, pos);
+                    if (pos < text.size() && text[pos] == ',') {
+                        pos++;
+                    } else if (pos < text.size() && text[pos] == ']') {
+                        pos++;
+                        return value;
+                    } else {
+                        Fail("expected ',' or ']'", pos);
+                    }
+                }
+            }
+            if (c == '"') return String(ParseString(text, pos));
+            if (Consume(text, pos, "true")) return Bool(true);
+            if (Consume(text, pos, "false")) return Bool(false);
+            if (Consume(text, pos, "null")) return JsonValue();
+
+            size_t start = pos;
+            if (pos < text.size() && text[pos] == '-') pos++;
+            while (pos < text.size() && (std::isdigit(static_cast<unsigned char>(text[pos])) || text[pos] == '.' || text[pos] == 'e'
+                                         || text[pos] == 'E' || text[pos] == '+' || text[pos] == '-')) pos++;
+            if (pos == start) Fail("unexpected character", pos);
+            std::string literal = text.substr(start, pos - start);
+            char* end = nullptr;
+            double number = std::strtod(literal.c_str(), &end);
+            if (end != literal.c_str() + literal.size()) Fail("malformed number", start);
+            return Number(number);
+        }
+
+        static void AppendUtf8(std::string& out, uint32_t code) {
+            if (code < 0x80) {
+                out += static_cast<char>(code);
+            } else if (code < 0x800) {
+                out += static_cast<char>(0xC0 | (code >> 6));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            } else if (code < 0x10000) {
+                out += static_cast<char>(0xE0 | (code >> 12));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            } else {
+                out += static_cast<char>(0xF0 | (code >> 18));
+                out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+
+        static uint32_t ParseHex4(const std::string& text, size_t pos) {
+            if (pos + 4 > text.size()) Fail("truncated \\u escape", pos);
+            uint32_t code = 0;
+            for (size_t i = pos; i < pos + 4; i++) {
+                char h = text[i];
+                code <<= 4;
+                if (h >= '0' && h <= '9') code |= h - '0';
+                else if (h >= 'a' && h <= 'f') code |= h - 'a' + 10;
+                else if (h >= 'A' && h <= 'F') code |= h - 'A' + 10;
+                else Fail("bad \\u escape", i);
+            }
+            return code;
+        }
+
+        static std::string ParseString(const std::string& text, size_t& pos) {
+            std::string out;
+            pos++;
+            while (pos < text.size() && text[pos] != '"') {
+                char c = text[pos++];
+                if (static_cast<unsigned char>(c) < 0x20) Fail("control character in string", pos - 1);
+                if (c != '\\') {
+                    out += c;
+                    continue;
+                }
+                if (pos >= text.size()) break;
+                char e = text[pos++];
+                switch (e) {
+                    case '"': out += '"'; break;
+                    case '\\': out += '\\'; break;
+                    case '/': out += '/'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'n': out += '\n'; break;
+                    case 'r': out += '\r'; break;
+                    case 't': out += '\t'; break;
+                    case 'u': {
+                        uint32_t code = ParseHex4(text, pos);
+                        pos += 4;
+                        if (code >= 0xD800 && code < 0xDC00 && text.compare(pos, 2, "\\u") == 0) {
+                            uint32_t low = ParseHex4(text, pos + 2);
+                            if (low >= 0xDC00 && low < 0xE000) {
+                                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                                pos += 6;
+                            }
+                        }
+                        AppendUtf8(out, code);
+                        break;
+                    }
+                    default: Fail("bad escape", pos - 1);
+                }
+            }
+            if (pos >= text.size()) Fail("unterminated string", pos);
+            pos++;
+            return out;
+        }
+    };
+
+    // The value as a JSON string literal, quotes included.
+    inline std::string json_quote(const std::string& value) {
+        std::string out = "\"";
+        for (char c : value) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        out += escaped;
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+        return out + "\"";
+    }
+}
@@ -7,6 +7,21 @@
 #include <numeric>
 #include <limits>
 #include <array>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include <type_traits>
 
 extern "C" {
     #include <libavcodec/avcodec.h>
@@ -22,6 +37,7 @@ extern "C" {
     #include <libavutil/avutil.h>
     #include <libavutil/error.h>
     #include <libavutil/fifo.h>
+    #include <libavutil/pixdesc.h>
     #include <libavformat/avio.h>
     #include <libswresample/swresample.h>
 }
@@ -29,92 +45,406 @@ extern "C" {
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#ifdef HAVE_EGL
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+#endif
 
 #ifdef _WIN32
     #include <windows.h>
+    #include <psapi.h>
+    #include <io.h>
+    #include <fcntl.h>
 #else
     #include <cstdio>
+    #include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#elif defined(__aarch64__)
+    #include <arm_neon.h>
 #endif
 
 #include "hash.h"
+#include "json.h"
 #include "offset.h"
+#include "mapcache.h"
+#include "context.h"
 #include "shader.h"
-#include "video.h"
+#include "remap.h"
+#include "planar.h"
+#include "tiles.h"
+#include "pbo.h"
+#include "batch.h"
+#include "yuv.h"
+#include "rotation.h"
+#include "quality.h"
+#include "pipeline.h"
+#include "telemetry.h"
+#include "workers.h"
 #include "audio.h"
+#include "stream.h"
+#include "encoder.h"
+#include "video.h"
+#include "jobs.h"
+#include "segments.h"
+#include "player.h"
+#include "shaders.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
-const char* vertexShaderSource = R"(
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoord;
-
-out vec2 TexCoord;
+int main(int argc, char* argv[]){
+    std::string seed = "my_secret_seed_123"; // Or the token as i'm calling it lol
+    std::string inpath = "input_video.mp4";
+    std::string outpath = "output_video.mp4";
 
-void main()
-{
-    gl_Position = vec4(aPos, 1.0);
-    TexCoord = aTexCoord;
-}
-)";
+    UnsafeYT::Backend backend = UnsafeYT::Backend::OpenGL;
+    UnsafeYT::ContextBackend context_backend = UnsafeYT::ContextBackend::Auto;
+    bool planar = false;
+    bool tiled = false;
+    size_t memory_budget = 0;
+    int gl_ring_depth = 3;
+    int gl_batch = 1;
+    bool gpu_yuv = false;
+    bool pipelined = true;
+    int queue_depth = 8;
+    bool print_queue_stats = false;
+    bool telemetry = false;
+    int telemetry_interval = 1;
+    bool batch = false;
+    std::string batch_path;
+    int jobs = 1;
+    int segments = 1;
+    double checkpoint_seconds = 0.0;
+    bool resume = false;
+    bool unshuffle = false;
+    UnsafeYT::RotationMode rotate_mode = UnsafeYT::RotationMode::Off;
+    int rotate_every = 0;
+    int rotate_ahead = 3;
+    int metrics_interval = 0;
+    bool play = false;
+    UnsafeYT::PlaybackSink play_sink = UnsafeYT::PlaybackSink::Window;
+    std::string input_format;
+    std::string output_format;
+    int fragment_ms = 0;
+    size_t io_buffer_size = UnsafeYT::PipeIO::DEFAULT_BUFFER;
+    int workers = 1;
+    std::string map_cache_dir = UnsafeYT::OffsetMapCache::DefaultDirectory().string();
+    UnsafeYT::MapFormat map_format = UnsafeYT::MapFormat::Float;
+    std::string profile_path;
+    UnsafeYT::JsonValue profile_flags = UnsafeYT::JsonValue::Object();
+    UnsafeYT::JsonValue profile_options = UnsafeYT::JsonValue::Object();
 
-const char* fragmentShaderSource = R"(
-#version 330
+    std::vector<std::string> positional;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.rfind("--", 0) != 0) {
+                positional.push_back(arg);
+                continue;
+            }
 
-out vec4 FragColor;
-in vec2 TexCoord;
+            size_t equals = arg.find('=');
+            std::string key = arg.substr(2, equals == std::string::npos ? std::string::npos : equals - 2);
+            std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
 
-uniform sampler2D ourTexture;
-uniform sampler2D offsetMap;
+            if (key == "backend" && (value == "gl" || value == "opengl")) {
+                backend = UnsafeYT::Backend::OpenGL;
+            } else if (key == "backend" && value == "cpu") {
+                backend = UnsafeYT::Backend::CPU;
+            } else if (key == "gl-context" && value == "auto") {
+                context_backend = UnsafeYT::ContextBackend::Auto;
+            } else if (key == "gl-context" && value == "egl") {
+                context_backend = UnsafeYT::ContextBackend::EGL;
+            } else if (key == "gl-context" && value == "glfw") {
+                context_backend = UnsafeYT::ContextBackend::GLFW;
+            } else if (key == "planar") {
+                planar = true;
+            } else if (key == "tiled") {
+                tiled = true;
+            } else if (key == "memory-budget" && !value.empty()) {
+                memory_budget = static_cast<size_t>(std::max(std::stoi(value), 1)) << 20;
+            } else if (key == "gl-ring" && !value.empty()) {
+                gl_ring_depth = std::max(std::stoi(value), 1);
+            } else if (key == "gl-batch" && !value.empty()) {
+                gl_batch = std::max(std::stoi(value), 1);
+            } else if (key == "gl-yuv") {
+                gpu_yuv = true;
+            } else if (key == "serial") {
+                pipelined = false;
+            } else if (key == "queue-depth" && !value.empty()) {
+                queue_depth = std::max(std::stoi(value), 1);
+            } else if (key == "queue-stats") {
+                print_queue_stats = true;
+            } else if (key == "telemetry") {
+                telemetry = true;
+            } else if (key == "telemetry-interval" && !value.empty()) {
+                telemetry_interval = std::max(std::stoi(value), 1);
+            } else if (key == "batch") {
+                batch = true;
+                batch_path = value;
+            } else if (key == "jobs" && !value.empty()) {
+                jobs = std::max(std::stoi(value), 1);
+            } else if (key == "segments" && value == "auto") {
+                segments = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+            } else if (key == "segments" && !value.empty()) {
+                segments = std::max(std::stoi(value), 1);
+            } else if (key == "checkpoint" && value.empty()) {
+                checkpoint_seconds = 60.0;
+            } else if (key == "checkpoint" && !value.empty()) {
+                checkpoint_seconds = std::max(std::stod(value), 1.0);
+            } else if (key == "resume") {
+                resume = true;
+            } else if (key == "unshuffle") {
+                unshuffle = true;
+            } else if (key == "rotate" && value == "keyframe") {
+                rotate_mode = UnsafeYT::RotationMode::Keyframes;
+            } else if (key == "rotate" && !value.empty()) {
+                rotate_every = std::max(std::stoi(value), 1);
+                rotate_mode = UnsafeYT::RotationMode::Frames;
+            } else if (key == "rotate-ahead" && !value.empty()) {
+                rotate_ahead = std::max(std::stoi(value), 1);
+            } else if (key == "metrics" && value.empty()) {
+                metrics_interval = 10;
+            } else if (key == "metrics" && !value.empty()) {
+                metrics_interval = std::max(std::stoi(value), 1);
+            } else if (key == "play" && (value.empty() || value == "window")) {
+                play = true;
+                play_sink = UnsafeYT::PlaybackSink::Window;
+            } else if (key == "play" && value == "raw") {
+                play = true;
+                play_sink = UnsafeYT::PlaybackSink::Raw;
+            } else if (key == "input-format" && !value.empty()) {
+                input_format = value;
+            } else if (key == "output-format" && !value.empty()) {
+                output_format = value;
+            } else if (key == "fragment-ms" && !value.empty()) {
+                fragment_ms = std::max(std::stoi(value), 0);
+            } else if (key == "io-buffer" && !value.empty()) {
+                io_buffer_size = static_cast<size_t>(std::max(std::stoi(value), 4)) * 1024;
+            } else if (key == "workers" && value == "auto") {
+                workers = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+            } else if (key == "workers" && !value.empty()) {
+                workers = std::max(std::stoi(value), 1);
+            } else if (key == "map-cache" && !value.empty()) {
+                map_cache_dir = value;
+            } else if (key == "no-map-cache") {
+                map_cache_dir.clear();
+            } else if (key == "map-format" && value == "float") {
+                map_format = UnsafeYT::MapFormat::Float;
+            } else if (key == "map-format" && value == "index") {
+                map_format = UnsafeYT::MapFormat::Index;
+            } else if (key == "profile-file" && !value.empty()) {
+                profile_path = value;
+            } else if (key == "profile" && !value.empty()) {
+                profile_flags.Set("profile", UnsafeYT::JsonValue::String(value));
+            } else if (key == "encoder" && !value.empty()) {
+                profile_flags.Set("codec", UnsafeYT::JsonValue::String(value));
+            } else if ((key == "gop" || key == "bframes" || key == "bitrate" || key == "encoder-threads" || key == "decoder-threads") && !value.empty()) {
+                static const std::pair<const char*, const char*> names[] = {
+                    {"gop", "gop_size"}, {"bframes", "max_b_frames"}, {"bitrate", "bit_rate"},
+                    {"encoder-threads", "encoder_threads"}, {"decoder-threads", "decoder_threads"}
+                };
+                for (const auto& name : names) {
+                    if (key == name.first) profile_flags.Set(name.second, UnsafeYT::JsonValue::String(value));
+                }
+            } else if ((key == "encoder-thread-type" || key == "decoder-thread-type") && !value.empty()) {
+                profile_flags.Set(key == "encoder-thread-type" ? "encoder_thread_type" : "decoder_thread_type", UnsafeYT::JsonValue::String(value));
+            } else if (key == "encoder-option" && value.find('=') != std::string::npos && value.find('=') > 0) {
+                profile_options.Set(value.substr(0, value.find('=')), UnsafeYT::JsonValue::String(value.substr(value.find('=') + 1)));
+            } else {
+                std::cerr << "Error: Unknown option '" << arg << "'." << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Invalid option value. " << e.what() << std::endl;
+        return 1;
+    }
 
-void main() {
-    vec4 shuffle_sample = texture(offsetMap, TexCoord);
-    vec2 decoded_offset = shuffle_sample.xy;
-    
-    vec2 base_new_uv = TexCoord + decoded_offset;
+    if (positional.size() > 0)
+        inpath = positional[0];
 
-    vec4 c = texture(ourTexture, base_new_uv);
+    if (positional.size() > 1)
+        outpath = positional[1];
 
-    FragColor = vec4(1-c.rgb, c.a);
-}
-)";
+    if (positional.size() > 2)
+        seed = positional[2];
 
+    bool stdout_video = !batch && UnsafeYT::PipeIO::IsPipe(outpath);
+    if (stdout_video && telemetry) {
+        std::cerr << "Error: --telemetry writes to stdout, which already carries the output video." << std::endl;
+        return 1;
+    }
 
-int main(int argc, char* argv[]){
-    std::string seed = "my_secret_seed_123"; // Or the token as i'm calling it lol
-    std::string inpath = "input_video.mp4";
-    std::string outpath = "output_video.mp4";
+    // Telemetry, job records and streamed video own stdout; everything meant for people goes
+    // to stderr instead.
+    if (telemetry || batch || stdout_video) {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
 
-    if (argc > 1)
-        inpath = std::string(argv[1]);
+    UnsafeYT::EncoderProfile encoder_profile;
+    try {
+        std::vector<UnsafeYT::JsonValue> layers;
+        if (!profile_path.empty()) {
+            layers.push_back(UnsafeYT::EncoderProfile::LoadFile(profile_path));
+        }
+        if (!profile_options.object.empty()) {
+            profile_flags.Set("options", profile_options);
+        }
+        layers.push_back(profile_flags);
+        encoder_profile = UnsafeYT::EncoderProfile::Resolve(layers);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
 
-    if (argc > 2)
-        outpath = std::string(argv[2]);
+    if (batch && jobs > 1 && backend == UnsafeYT::Backend::OpenGL && !planar && !tiled && context_backend == UnsafeYT::ContextBackend::GLFW) {
+        std::cerr << "Error: --jobs above 1 needs EGL contexts; GLFW can only run one GL job at a time." << std::endl;
+        return 1;
+    }
+#ifndef HAVE_EGL
+    if (batch && jobs > 1 && backend == UnsafeYT::Backend::OpenGL && !planar && !tiled) {
+        std::cerr << "Warning: This build has no EGL, which GL jobs after the first need; running one job at a time." << std::endl;
+        jobs = 1;
+    }
+#endif
+    if (!batch && segments > 1 && backend == UnsafeYT::Backend::OpenGL && !planar && !tiled && context_backend == UnsafeYT::ContextBackend::GLFW) {
+        std::cerr << "Error: --segments needs EGL contexts; GLFW contexts cannot be made on worker threads." << std::endl;
+        return 1;
+    }
+#ifndef HAVE_EGL
+    if (!batch && segments > 1 && backend == UnsafeYT::Backend::OpenGL && !planar && !tiled) {
+        std::cerr << "Warning: This build has no EGL, which GL segments on worker threads need; processing the input in one piece." << std::endl;
+        segments = 1;
+    }
+#endif
+    if (resume && checkpoint_seconds <= 0.0) {
+        std::cerr << "Error: --resume continues a checkpointed run; pass --checkpoint with the settings of that run." << std::endl;
+        return 1;
+    }
+    if (checkpoint_seconds > 0.0 && (batch || segments > 1 || play)) {
+        std::cerr << "Error: --checkpoint processes one input in parts; it cannot be combined with --batch, --segments or --play." << std::endl;
+        return 1;
+    }
+    if (checkpoint_seconds > 0.0 && (metrics_interval > 0 || rotate_mode == UnsafeYT::RotationMode::Keyframes)) {
+        std::cerr << "Error: --checkpoint restarts the encoder for every part; --metrics and --rotate=keyframe are not supported." << std::endl;
+        return 1;
+    }
 
-    if (argc > 3)
-        seed = std::string(argv[3]);
+    if (gpu_yuv && (backend != UnsafeYT::Backend::OpenGL || planar || tiled || gl_batch > 1)) {
+        std::cerr << "Error: --gl-yuv is a mode of the unbatched GL path; it cannot be combined with --backend=cpu, --planar, --tiled or --gl-batch." << std::endl;
+        return 1;
+    }
+    if (rotate_mode == UnsafeYT::RotationMode::Keyframes && !batch && segments > 1) {
+        std::cerr << "Error: --rotate=keyframe counts keyframes from the start of the input; it cannot be combined with --segments." << std::endl;
+        return 1;
+    }
+    if (play && rotate_mode != UnsafeYT::RotationMode::Off) {
+        std::cerr << "Error: --play uses one fixed map; --rotate is not supported." << std::endl;
+        return 1;
+    }
+    if (metrics_interval > 0 && !batch && segments > 1) {
+        std::cerr << "Error: --metrics measures one encoder; it cannot be combined with --segments." << std::endl;
+        return 1;
+    }
+    if (play && metrics_interval > 0) {
+        std::cerr << "Error: --play does not encode; --metrics is not supported." << std::endl;
+        return 1;
+    }
+    if (play && gpu_yuv) {
+        std::cerr << "Error: --play shows RGB frames; --gl-yuv is not supported." << std::endl;
+        return 1;
+    }
 
-    UnsafeYT::Video Processor(
-        vertexShaderSource,
-        fragmentShaderSource,
-        inpath,
-        outpath + "noaudio.mp4",
-        seed
-    );
+    if (play && (batch || segments > 1)) {
+        std::cerr << "Error: --play shows one input in real time; it cannot be combined with --batch or --segments." << std::endl;
+        return 1;
+    }
+    if (play && (planar || tiled)) {
+        std::cerr << "Error: --play transforms RGB frames; --planar and --tiled are not supported." << std::endl;
+        return 1;
+    }
+    if (play && play_sink == UnsafeYT::PlaybackSink::Window && backend != UnsafeYT::Backend::OpenGL) {
+        std::cerr << "Error: --play=window draws through OpenGL; use --play=raw with the CPU backend." << std::endl;
+        return 1;
+    }
 
-    Processor.Start();
+    auto make_processor = [&](const std::string& input, const std::string& output, const std::string& key) {
+        auto processor = std::make_unique<UnsafeYT::Video>(
+            vertexShaderSource,
+            fragmentShaderSource,
+            input,
+            output,
+            key
+        );
+        processor->backend = backend;
+        processor->context_backend = context_backend;
+        processor->planar = planar;
+        processor->tiled = tiled;
+        processor->memory_budget = memory_budget;
+        processor->gl_ring_depth = gl_ring_depth;
+        processor->gl_batch = gl_batch;
+        processor->gpu_yuv = gpu_yuv;
+        processor->pipelined = pipelined;
+        processor->queue_depth = queue_depth;
+        processor->print_queue_stats = print_queue_stats;
+        processor->telemetry.enabled = telemetry;
+        processor->telemetry.interval = telemetry_interval;
+        processor->workers = workers;
+        processor->map_cache_dir = map_cache_dir;
+        processor->map_format = map_format;
+        processor->unshuffle = unshuffle;
+        processor->rotate_mode = rotate_mode;
+        processor->rotate_every = rotate_every;
+        processor->rotate_ahead = rotate_ahead;
+        processor->quality.interval = metrics_interval;
+        processor->input_format = input_format;
+        processor->output_format = output_format;
+        processor->fragment_ms = fragment_ms;
+        processor->io_buffer_size = io_buffer_size;
+        processor->encoder_profile = encoder_profile;
+        processor->indexFragmentShaderSource = indexFragmentShaderSource;
+        processor->batchVertexShaderSource = batchVertexShaderSource;
+        processor->batchGeometryShaderSource = batchGeometryShaderSource;
+        processor->batchFragmentShaderSource = batchFragmentShaderSource;
+        processor->batchIndexFragmentShaderSource = batchIndexFragmentShaderSource;
+        processor->yuvFragmentShaderSource = yuvFragmentShaderSource;
+        processor->yuvIndexFragmentShaderSource = yuvIndexFragmentShaderSource;
+        return processor;
+    };
 
-    UnsafeYT::mixAudioAndAddSine(
-        outpath + "noaudio.mp4",
-        inpath,
-        outpath
-    );
+    if (batch) {
+        UnsafeYT::JobRunner runner([&]() { return make_processor("", "", seed); }, seed, jobs);
+        if (batch_path.empty()) {
+            return runner.Run(std::cin);
+        }
+        std::ifstream manifest(batch_path, std::ios::binary);
+        if (!manifest) {
+            std::cerr << "Error: Could not read job manifest '" << batch_path << "'." << std::endl;
+            return 1;
+        }
+        return runner.Run(manifest);
+    }
 
+    if (segments > 1 || checkpoint_seconds > 0.0) {
+        UnsafeYT::SegmentRunner runner([&]() { return make_processor(inpath, outpath, seed); }, segments);
+        runner.checkpoint_seconds = checkpoint_seconds;
+        runner.resume = resume;
+        return runner.Run() == 0 ? 0 : 1;
+    }
 
-    if (std::filesystem::exists(outpath + "noaudio.mp4")) {
-        std::filesystem::remove(outpath + "noaudio.mp4");
+    std::unique_ptr<UnsafeYT::Video> Processor = make_processor(inpath, outpath, seed);
+    if (play) {
+        UnsafeYT::Player player(*Processor, play_sink);
+        return player.Run() == 0 ? 0 : 1;
+    }
+    if (Processor->Start() != 0) {
+        Processor->telemetry.Done(false, Processor->frameCount);
+        return 1;
     }
 
     return 0;
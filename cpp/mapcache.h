@@ -0,0 +1,176 @@
+namespace UnsafeYT{
+    // On-disk cache of generated offset maps, one file per (seed, width, height, direction,
+    // algorithm version). A file is a fixed header, the seed bytes and the RG float payload,
+    // in native byte order; the byte order mark, the full key and a checksum of the payload are
+    // all verified on load, so stale, foreign or damaged files are regenerated rather than used.
+    // Writers fill a private temporary file and rename it into place, which is atomic, so any
+    // number of processes may populate the cache at once and readers never see a partial file.
+    class OffsetMapCache {
+    public:
+        static constexpr char MAGIC[8] = {'U', 'Y', 'T', 'O', 'M', 'A', 'P', '\0'};
+        static constexpr uint32_t FORMAT_VERSION = 1;
+        static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+        struct Header {
+            char magic[8];
+            uint32_t format_version;
+            uint32_t byte_order;
+            uint32_t algorithm_version;
+            uint32_t width;
+            uint32_t height;
+            uint32_t direction;
+            uint32_t seed_length;
+            uint32_t reserved;
+            uint64_t payload_bytes;
+            uint64_t checksum;
+        };
+
+        explicit OffsetMapCache(std::filesystem::path directory) : directory(std::move(directory)) {}
+
+        // $UNSAFEYT_CACHE_DIR, else the platform's per-user cache directory.
+        static std::filesystem::path DefaultDirectory() {
+            if (const char* dir = std::getenv("UNSAFEYT_CACHE_DIR")) return dir;
+        #ifdef _WIN32
+            if (const char* dir = std::getenv("LOCALAPPDATA")) return std::filesystem::path(dir) / "UnsafeYT" / "cache";
+        #else
+            if (const char* dir = std::getenv("XDG_CACHE_HOME")) return std::filesystem::path(dir) / "unsafeyt";
+            if (const char* dir = std::getenv("HOME")) return std::filesystem::path(dir) / ".cache" / "unsafeyt";
+        #endif
+            return std::filesystem::temp_directory_path() / "unsafeyt-cache";
+        }
+
+        // 64-bit FNV-1a over whole words, with the tail bytes folded in one at a time.
+        static uint64_t Checksum(const uint8_t* data, size_t size) {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8) {
+                uint64_t word;
+                std::memcpy(&word, data + i, 8);
+                hash = (hash ^ word) * 0x100000001b3ull;
+            }
+            for (; i < size; i++) {
+                hash = (hash ^ data[i]) * 0x100000001b3ull;
+            }
+            return hash;
+        }
+
+        std::filesystem::path PathFor(const std::string& seed, int width, int height, MapDirection direction) const {
+            uint64_t seed_hash = Checksum(reinterpret_cast<const uint8_t*>(seed.data()), seed.size());
+            char name[96];
+            std::snprintf(name, sizeof(name), "%016llx_%dx%d_%s_v%u.map", static_cast<unsigned long long>(seed_hash), width, height,
+                          direction == MapDirection::Shuffle ? "shuffle" : "unshuffle", OFFSET_MAP_ALGORITHM_VERSION);
+            return this->directory / name;
+        }
+
+        // Entries are small (50 KB at 80x80), so the payload is read straight into the caller's
+        // vector: one copy, where a mapping would still need one into the vector.
+        bool Load(const std::string& seed, int width, int height, MapDirection direction, std::vector<float>& map) const {
+            FILE* in = std::fopen(this->PathFor(seed, width, height, direction).string().c_str(), "rb");
+            if (!in) return false;
+            bool valid = Read(in, seed, width, height, direction, map);
+            std::fclose(in);
+            return valid;
+        }
+
+        bool Store(const std::string& seed, int width, int height, MapDirection direction, const std::vector<float>& map) const {
+            std::error_code error;
+            std::filesystem::create_directories(this->directory, error);
+            if (error) return false;
+
+            Header header = {};
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.format_version = FORMAT_VERSION;
+            header.byte_order = BYTE_ORDER_MARK;
+            header.algorithm_version = OFFSET_MAP_ALGORITHM_VERSION;
+            header.width = width;
+            header.height = height;
+            header.direction = static_cast<uint32_t>(direction);
+            header.seed_length = static_cast<uint32_t>(seed.size());
+            header.payload_bytes = map.size() * sizeof(float);
+            header.checksum = Checksum(reinterpret_cast<const uint8_t*>(map.data()), header.payload_bytes);
+
+            std::vector<uint8_t> bytes(PayloadOffset(header.seed_length) + header.payload_bytes, 0);
+            std::memcpy(bytes.data(), &header, sizeof(Header));
+            std::memcpy(bytes.data() + sizeof(Header), seed.data(), seed.size());
+            std::memcpy(bytes.data() + PayloadOffset(header.seed_length), map.data(), header.payload_bytes);
+
+            std::filesystem::path path = this->PathFor(seed, width, height, direction);
+            std::filesystem::path temp = path;
+        #ifdef _WIN32
+            unsigned long pid = GetCurrentProcessId();
+        #else
+            unsigned long pid = static_cast<unsigned long>(getpid());
+        #endif
+            temp += ".tmp" + std::to_string(pid) + "_" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+            FILE* out = std::fopen(temp.string().c_str(), "wb");
+            if (!out) return false;
+            bool written = std::fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+            written = std::fclose(out) == 0 && written;
+            if (written) {
+                std::filesystem::rename(temp, path, error);
+                written = !error;
+            }
+            if (!written) {
+                std::filesystem::remove(temp, error);
+            }
+            return written;
+        }
+
+    private:
+        static bool Read(FILE* in, const std::string& seed, int width, int height, MapDirection direction, std::vector<float>& map) {
+            Header header;
+            if (std::fread(&header, sizeof(Header), 1, in) != 1) return false;
+            size_t expected = static_cast<size_t>(width) * height * 2 * sizeof(float);
+            if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+                || header.format_version != FORMAT_VERSION
+                || header.byte_order != BYTE_ORDER_MARK
+                || header.algorithm_version != OFFSET_MAP_ALGORITHM_VERSION
+                || header.width != static_cast<uint32_t>(width)
+                || header.height != static_cast<uint32_t>(height)
+                || header.direction != static_cast<uint32_t>(direction)
+                || header.seed_length != seed.size()
+                || header.payload_bytes != expected) {
+                return false;
+            }
+
+            std::string stored(seed.size(), '\0');
+            if (std::fread(&stored[0], 1, stored.size(), in) != stored.size() || stored != seed) return false;
+            if (std::fseek(in, static_cast<long>(PayloadOffset(header.seed_length)), SEEK_SET) != 0) return false;
+
+            // The payload has to end the file.
+            map.resize(expected / sizeof(float));
+            if (std::fread(map.data(), 1, expected, in) != expected || std::fgetc(in) != EOF) {
+                map.clear();
+                return false;
+            }
+            if (Checksum(reinterpret_cast<const uint8_t*>(map.data()), expected) != header.checksum) {
+                std::cerr << "Warning: Offset map cache entry failed its integrity check; regenerating." << std::endl;
+                map.clear();
+                return false;
+            }
+            return true;
+        }
+
+        static size_t PayloadOffset(uint32_t seed_length) {
+            return (sizeof(Header) + seed_length + 7) & ~static_cast<size_t>(7);
+        }
+
+        std::filesystem::path directory;
+    };
+
+    // Returns the requested offset map from the cache if it holds a valid copy, otherwise
+    // generates it and tries to add it. A null cache always generates.
+    std::vector<float> load_offset_map(const OffsetMapCache* cache, int map_width, int map_height, const std::string& seed, MapDirection direction, bool* cached = nullptr) {
+        std::vector<float> map;
+        bool hit = cache && cache->Load(seed, map_width, map_height, direction, map);
+        if (!hit) {
+            map = generate_offset_map(map_width, map_height, seed, direction);
+            if (cache && !cache->Store(seed, map_width, map_height, direction, map)) {
+                std::cerr << "Warning: Could not write offset map cache entry." << std::endl;
+            }
+        }
+        if (cached) *cached = hit;
+        return map;
+    }
+}
@@ -1,77 +1,191 @@
 namespace UnsafeYT{
-    std::pair<std::vector<float>, std::vector<float>> generate_offset_maps(int map_width, int map_height, const std::string& seed) {
-        if (map_width <= 0 || map_height <= 0) {
-            throw std::runtime_error("Map width and height must be positive integers.");
+    enum class MapDirection {Shuffle, Unshuffle};
+
+    // Bumped whenever the generator would produce different maps for the same inputs, which
+    // invalidates every cached map.
+    constexpr uint32_t OFFSET_MAP_ALGORITHM_VERSION = 1;
+
+    namespace detail {
+        // Below this many tiles a single thread wins; the 80x80 default stays serial.
+        constexpr size_t PARALLEL_MAP_THRESHOLD = 1 << 16;
+
+        inline int map_threads(size_t total, int threads) {
+            if (total < PARALLEL_MAP_THRESHOLD) return 1;
+            if (threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency());
+            return std::max(threads, 1);
         }
-        if (seed.empty()) {
-            throw std::runtime_error("Seed string is required for deterministic generation.");
+
+        // Runs fn(begin, end, part) over `parts` contiguous slices of [0, total).
+        template <typename F>
+        void parallel_slices(size_t total, int parts, F fn) {
+            if (parts <= 1) {
+                fn(size_t(0), total, 0);
+                return;
+            }
+            std::vector<std::thread> threads;
+            for (int part = 0; part < parts; part++) {
+                size_t begin = total * part / parts;
+                size_t end = total * (part + 1) / parts;
+                threads.emplace_back([=, &fn]() { fn(begin, end, part); });
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
         }
-    
-        size_t total_pixels = static_cast<size_t>(map_width) * map_height;
-    
-        double start_hash = UnsafeYT::deterministic_hash(seed, 31, std::numeric_limits<unsigned int>::max());
-        double step_hash = UnsafeYT::deterministic_hash(seed + "_step", 37, std::numeric_limits<unsigned int>::max() - 1);
-    
-        double start_angle = start_hash * M_PI * 2.0;
-        double angle_increment = step_hash * M_PI / std::max(static_cast<double>(map_width), static_cast<double>(map_height));
-    
-        std::vector<std::pair<double, size_t>> indexed_values(total_pixels);
-        for (size_t i = 0; i < total_pixels; ++i) {
-            double value = std::sin(start_angle + i * angle_increment);
-            indexed_values[i] = {value, i};
+
+        // Order-preserving map of a double onto an unsigned key, so comparing keys compares
+        // values. -0.0 never occurs: the angles are non-negative.
+        inline uint64_t sortable_key(double value) {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return (bits >> 63) ? ~bits : bits | (uint64_t(1) << 63);
         }
-    
-        std::sort(indexed_values.begin(), indexed_values.end());
-    
-        std::vector<size_t> pLinearized(total_pixels);
-        for (size_t k = 0; k < total_pixels; ++k) {
-            size_t original_index = indexed_values[k].second;
-            size_t shuffled_index = k;
-            pLinearized[original_index] = shuffled_index;
+
+        // The tile permutation: order[k] is the original tile that lands on shuffled tile k.
+        // This is the order std::sort gives the (value, index) pairs: an LSD radix sort on the
+        // packed value keys is stable, and the indices start out ascending, so equal values
+        // keep their index order. Keys travel with their indices so every pass streams through
+        // memory; two key/index buffers are all that is allocated.
+        std::vector<uint32_t> tile_order(int map_width, int map_height, const std::string& seed, int threads) {
+            size_t total_pixels = static_cast<size_t>(map_width) * map_height;
+            if (total_pixels > std::numeric_limits<uint32_t>::max()) {
+                throw std::runtime_error("Offset map is too large.");
+            }
+
+            double start_hash = UnsafeYT::deterministic_hash(seed, 31, std::numeric_limits<unsigned int>::max());
+            double step_hash = UnsafeYT::deterministic_hash(seed + "_step", 37, std::numeric_limits<unsigned int>::max() - 1);
+
+            double start_angle = start_hash * M_PI * 2.0;
+            double angle_increment = step_hash * M_PI / std::max(static_cast<double>(map_width), static_cast<double>(map_height));
+
+            int parts = map_threads(total_pixels, threads);
+            std::vector<uint64_t> keys(total_pixels);
+            std::vector<uint64_t> scratch_keys(total_pixels);
+            std::vector<uint32_t> order(total_pixels);
+            std::vector<uint32_t> scratch(total_pixels);
+            parallel_slices(total_pixels, parts, [&](size_t begin, size_t end, int) {
+                for (size_t i = begin; i < end; ++i) {
+                    keys[i] = sortable_key(std::sin(start_angle + i * angle_increment));
+                    order[i] = static_cast<uint32_t>(i);
+                }
+            });
+
+            constexpr int DIGIT_BITS = 11;
+            constexpr size_t BUCKETS = size_t(1) << DIGIT_BITS;
+            std::vector<size_t> counts(static_cast<size_t>(parts) * BUCKETS);
+            for (int shift = 0; shift < 64; shift += DIGIT_BITS) {
+                std::fill(counts.begin(), counts.end(), 0);
+                parallel_slices(total_pixels, parts, [&](size_t begin, size_t end, int part) {
+                    size_t* count = counts.data() + static_cast<size_t>(part) * BUCKETS;
+                    for (size_t i = begin; i < end; ++i) {
+                        count[(keys[i] >> shift) & (BUCKETS - 1)]++;
+                    }
+                });
+
+                // Bucket-major, slice-minor prefix sums keep the scatter stable. A digit that is
+                // the same for every key leaves the order as it is.
+                bool single_bucket = false;
+                size_t offset = 0;
+                for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+                    size_t bucket_total = 0;
+                    for (int part = 0; part < parts; part++) {
+                        size_t& count = counts[static_cast<size_t>(part) * BUCKETS + bucket];
+                        size_t n = count;
+                        count = offset;
+                        offset += n;
+                        bucket_total += n;
+                    }
+                    single_bucket = single_bucket || bucket_total == total_pixels;
+                }
+                if (single_bucket) continue;
+
+                parallel_slices(total_pixels, parts, [&](size_t begin, size_t end, int part) {
+                    size_t* next = counts.data() + static_cast<size_t>(part) * BUCKETS;
+                    for (size_t i = begin; i < end; ++i) {
+                        size_t slot = next[(keys[i] >> shift) & (BUCKETS - 1)]++;
+                        scratch_keys[slot] = keys[i];
+                        scratch[slot] = order[i];
+                    }
+                });
+                keys.swap(scratch_keys);
+                order.swap(scratch);
+            }
+            return order;
         }
-    
-        std::vector<size_t> pInvLinearized(total_pixels);
-        for (size_t original_idx = 0; original_idx < total_pixels; ++original_idx) {
-            size_t shuffled_idx = pLinearized[original_idx];
-            pInvLinearized[shuffled_idx] = original_idx;
+
+        // map[p] = position(source[p]) - position(p), normalized to the grid.
+        void write_offsets(const std::vector<uint32_t>& source, int map_width, int map_height, float* map, int threads) {
+            parallel_slices(static_cast<size_t>(map_height), map_threads(source.size(), threads), [&](size_t begin, size_t end, int) {
+                for (int y = static_cast<int>(begin); y < static_cast<int>(end); ++y) {
+                    for (int x = 0; x < map_width; ++x) {
+                        size_t index = static_cast<size_t>(y) * map_width + x;
+                        int sx = source[index] % map_width;
+                        int sy = source[index] / map_width;
+                        map[index * 2] = static_cast<float>(static_cast<double>(sx - x) / static_cast<double>(map_width));
+                        map[index * 2 + 1] = static_cast<float>(static_cast<double>(sy - y) / static_cast<double>(map_height));
+                    }
+                }
+            });
         }
-    
-        std::vector<float> unshuffle_map_data(total_pixels * 2);
-        for (int oy = 0; oy < map_height; ++oy) {
-            for (int ox = 0; ox < map_width; ++ox) {
-                size_t original_linear_index = oy * map_width + ox;
-                size_t shuffled_linear_index = pLinearized[original_linear_index];
-    
-                int sx_shuffled = shuffled_linear_index % map_width;
-                int sy_shuffled = shuffled_linear_index / map_width;
-    
-                double offset_x = static_cast<double>(sx_shuffled - ox) / static_cast<double>(map_width);
-                double offset_y = static_cast<double>(sy_shuffled - oy) / static_cast<double>(map_height);
-    
-                size_t index = (oy * map_width + ox) * 2;
-                unshuffle_map_data[index] = static_cast<float>(offset_x);
-                unshuffle_map_data[index + 1] = static_cast<float>(offset_y);
+
+        inline void check_map_inputs(int map_width, int map_height, const std::string& seed) {
+            if (map_width <= 0 || map_height <= 0) {
+                throw std::runtime_error("Map width and height must be positive integers.");
+            }
+            if (seed.empty()) {
+                throw std::runtime_error("Seed string is required for deterministic generation.");
             }
         }
-    
-        std::vector<float> shuffle_map_data(total_pixels * 2);
-        for (int ty_shuffled = 0; ty_shuffled < map_height; ++ty_shuffled) {
-            for (int tx_shuffled = 0; tx_shuffled < map_width; ++tx_shuffled) {
-                size_t shuffled_linear_index = ty_shuffled * map_width + tx_shuffled;
-                size_t original_linear_index = pInvLinearized[shuffled_linear_index];
-    
-                int ox_original = original_linear_index % map_width;
-                int oy_original = original_linear_index / map_width;
-    
-                double offset_x = static_cast<double>(ox_original - tx_shuffled) / static_cast<double>(map_width);
-                double offset_y = static_cast<double>(oy_original - ty_shuffled) / static_cast<double>(map_height);
-    
-                size_t index = (ty_shuffled * map_width + tx_shuffled) * 2;
-                shuffle_map_data[index] = static_cast<float>(offset_x);
-                shuffle_map_data[index + 1] = static_cast<float>(offset_y);
+    }
+
+    // Offset map for one direction. The shuffle map points every shuffled tile at the original
+    // tile it shows; the unshuffle map points every original tile at where it was shuffled to.
+    // `threads` <= 0 uses every hardware thread once the grid is large enough.
+    std::vector<float> generate_offset_map(int map_width, int map_height, const std::string& seed, MapDirection direction, int threads = 0) {
+        detail::check_map_inputs(map_width, map_height, seed);
+        std::vector<uint32_t> order = detail::tile_order(map_width, map_height, seed, threads);
+
+        if (direction == MapDirection::Unshuffle) {
+            std::vector<uint32_t> inverse(order.size());
+            detail::parallel_slices(order.size(), detail::map_threads(order.size(), threads), [&](size_t begin, size_t end, int) {
+                for (size_t k = begin; k < end; ++k) {
+                    inverse[order[k]] = static_cast<uint32_t>(k);
+                }
+            });
+            order.swap(inverse);
+        }
+
+        std::vector<float> map(order.size() * 2);
+        detail::write_offsets(order, map_width, map_height, map.data(), threads);
+        return map;
+    }
+
+    // Integer form of an offset map: the linear index of the source tile of every cell. The
+    // float deltas are whole tiles divided by the grid size, so scaling back and rounding
+    // recovers them exactly.
+    std::vector<uint32_t> offsets_to_tile_map(const std::vector<float>& offset_map, int map_width, int map_height) {
+        if (offset_map.size() != static_cast<size_t>(map_width) * map_height * 2) {
+            throw std::runtime_error("Offset map size does not match its dimensions.");
+        }
+        std::vector<uint32_t> tile_map(static_cast<size_t>(map_width) * map_height);
+        for (int y = 0; y < map_height; ++y) {
+            for (int x = 0; x < map_width; ++x) {
+                size_t index = static_cast<size_t>(y) * map_width + x;
+                long sx = x + std::lround(offset_map[index * 2] * map_width);
+                long sy = y + std::lround(offset_map[index * 2 + 1] * map_height);
+                if (sx < 0 || sx >= map_width || sy < 0 || sy >= map_height) {
+                    throw std::runtime_error("Offset map points outside the grid.");
+                }
+                tile_map[index] = static_cast<uint32_t>(sy * map_width + sx);
             }
         }
-    
-        return {shuffle_map_data, unshuffle_map_data};
-    }    
-}
\ No newline at end of file
+        return tile_map;
+    }
+
+    std::pair<std::vector<float>, std::vector<float>> generate_offset_maps(int map_width, int map_height, const std::string& seed) {
+        return {
+            generate_offset_map(map_width, map_height, seed, MapDirection::Shuffle),
+            generate_offset_map(map_width, map_height, seed, MapDirection::Unshuffle)
+        };
+    }
+}
@@ -0,0 +1,115 @@
+namespace UnsafeYT{
+    // Ring of pixel buffer objects for the GL path. Slot i carries both the upload of
+    // frame i and its readback, so with depth 3 the CPU fills frame N+1 and encodes
+    // frame N-2 while the GPU is still drawing frame N. Rows are tightly packed
+    // (width * 3 bytes), both in the upload buffers and in the mapped readback.
+    class PixelTransferRing {
+    public:
+        int Init(int width, int height, int depth) {
+            this->width = width;
+            this->height = height;
+            this->depth = std::max(depth, 1);
+            this->frame_bytes = static_cast<GLsizeiptr>(width) * height * 3;
+
+            this->uploads.assign(this->depth, 0);
+            this->readbacks.assign(this->depth, 0);
+            this->fences.assign(this->depth, nullptr);
+
+            glGenBuffers(this->depth, this->uploads.data());
+            glGenBuffers(this->depth, this->readbacks.data());
+            for (int i = 0; i < this->depth; i++) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->uploads[i]);
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, this->frame_bytes, NULL, GL_STREAM_DRAW);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, this->readbacks[i]);
+                glBufferData(GL_PIXEL_PACK_BUFFER, this->frame_bytes, NULL, GL_STREAM_READ);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            if (glGetError() != GL_NO_ERROR) {
+                std::cerr << "Error: Failed to allocate pixel buffer objects." << std::endl;
+                return -1;
+            }
+            return 0;
+        }
+
+        void Release() {
+            for (GLsync& fence : this->fences) {
+                if (fence) glDeleteSync(fence);
+                fence = nullptr;
+            }
+            if (!this->uploads.empty()) glDeleteBuffers(static_cast<GLsizei>(this->uploads.size()), this->uploads.data());
+            if (!this->readbacks.empty()) glDeleteBuffers(static_cast<GLsizei>(this->readbacks.size()), this->readbacks.data());
+            this->uploads.clear();
+            this->readbacks.clear();
+            this->fences.clear();
+            this->pending = 0;
+        }
+
+        int Stride() const { return this->width * 3; }
+
+        // Maps the upload buffer of the next slot. The previous contents are invalidated,
+        // so the driver never has to wait for an earlier upload from the same buffer.
+        uint8_t* BeginUpload() {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->uploads[this->head]);
+            return static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, this->frame_bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        }
+
+        void EndUpload(GLuint texture) {
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, this->width, this->height, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        // Starts an asynchronous readback of the bound framebuffer into the current slot.
+        void QueueReadback() {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, this->readbacks[this->head]);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, this->width, this->height, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            this->fences[this->head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            this->head = (this->head + 1) % this->depth;
+            this->pending++;
+        }
+
+        // True once every slot is in flight, i.e. the oldest readback must be consumed
+        // before the next frame can be uploaded.
+        bool Full() const { return this->pending == this->depth; }
+        bool Empty() const { return this->pending == 0; }
+
+        // Waits for the oldest readback and maps it for reading; valid until UnmapOldest().
+        const uint8_t* MapOldest() {
+            int tail = (this->head + this->depth - this->pending) % this->depth;
+            GLsync& fence = this->fences[tail];
+            if (fence) {
+                GLenum status;
+                do {
+                    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+                } while (status == GL_TIMEOUT_EXPIRED);
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, this->readbacks[tail]);
+            return static_cast<const uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, this->frame_bytes, GL_MAP_READ_BIT));
+        }
+
+        void UnmapOldest() {
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            this->pending--;
+        }
+
+        int width = 0;
+        int height = 0;
+        int depth = 0;
+        int head = 0;
+        int pending = 0;
+        GLsizeiptr frame_bytes = 0;
+        std::vector<GLuint> uploads;
+        std::vector<GLuint> readbacks;
+        std::vector<GLsync> fences;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+namespace UnsafeYT{
+    // Bounded single-producer/single-consumer ring. TryPush/TryPop never block; Push/Pop
+    // spin briefly, then back off to short sleeps, and give up once `stop` is raised.
+    // Every blocked call is counted, which is what tells a starved stage from a slow one.
+    template <typename T>
+    class SpscQueue {
+    public:
+        explicit SpscQueue(size_t capacity) : slots(std::max<size_t>(capacity, 1) + 1) {}
+
+        bool TryPush(const T& value) {
+            size_t tail = this->tail.load(std::memory_order_relaxed);
+            size_t next = (tail + 1) % this->slots.size();
+            if (next == this->head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            this->slots[tail] = value;
+            this->tail.store(next, std::memory_order_release);
+            return true;
+        }
+
+        bool TryPop(T& value) {
+            size_t head = this->head.load(std::memory_order_relaxed);
+            if (head == this->tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            value = this->slots[head];
+            this->head.store((head + 1) % this->slots.size(), std::memory_order_release);
+            return true;
+        }
+
+        bool Push(const T& value, const std::atomic<bool>& stop) {
+            if (this->TryPush(value)) return true;
+            this->full_waits.fetch_add(1, std::memory_order_relaxed);
+            for (int spins = 0; !this->TryPush(value); spins++) {
+                if (stop.load(std::memory_order_relaxed)) return false;
+                Backoff(spins);
+            }
+            return true;
+        }
+
+        bool Pop(T& value, const std::atomic<bool>& stop) {
+            if (this->TryPop(value)) return true;
+            this->empty_waits.fetch_add(1, std::memory_order_relaxed);
+            for (int spins = 0; !this->TryPop(value); spins++) {
+                if (stop.load(std::memory_order_relaxed)) return false;
+                Backoff(spins);
+            }
+            return true;
+        }
+
+        size_t Size() const {
+            size_t head = this->head.load(std::memory_order_acquire);
+            size_t tail = this->tail.load(std::memory_order_acquire);
+            return (tail + this->slots.size() - head) % this->slots.size();
+        }
+
+        size_t Capacity() const { return this->slots.size() - 1; }
+
+        std::atomic<uint64_t> full_waits{0};
+        std::atomic<uint64_t> empty_waits{0};
+
+    private:
+        static void Backoff(int spins) {
+            if (spins < 64) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+        std::vector<T> slots;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+    };
+
+    // Running occupancy of one pipeline queue. Only the thread that reports progress samples
+    // it, so the counters themselves need no synchronisation.
+    struct QueueStats {
+        const char* name = "";
+        size_t capacity = 0;
+        size_t depth = 0;
+        uint64_t samples = 0;
+        uint64_t depth_sum = 0;
+        uint64_t producer_waits = 0;
+        uint64_t consumer_waits = 0;
+
+        template <typename Queue>
+        void Sample(const Queue& queue) {
+            this->capacity = queue.Capacity();
+            this->depth = queue.Size();
+            this->samples++;
+            this->depth_sum += this->depth;
+            this->producer_waits = queue.full_waits.load(std::memory_order_relaxed);
+            this->consumer_waits = queue.empty_waits.load(std::memory_order_relaxed);
+        }
+
+        double AverageDepth() const {
+            return this->samples ? static_cast<double>(this->depth_sum) / this->samples : 0.0;
+        }
+    };
+
+    std::ostream& operator<<(std::ostream& os, const QueueStats& stats) {
+        return os << stats.name << " " << stats.depth << "/" << stats.capacity
+                  << " (avg " << stats.AverageDepth()
+                  << ", producer waits " << stats.producer_waits
+                  << ", consumer waits " << stats.consumer_waits << ")";
+    }
+}
\ No newline at end of file
@@ -0,0 +1,177 @@
+namespace UnsafeYT{
+    // Sample container, packing and subsampling of a YUV frame the CPU paths remap natively:
+    // 8-bit planar (yuv420p, yuv422p, yuv444p, their yuvj twins), deeper planar formats in
+    // little-endian 16-bit containers (yuv420p10le and the like), and semi-planar nv12/p010,
+    // whose second plane interleaves U and V.
+    struct YuvLayout {
+        int bytes = 1;            // per sample
+        int depth = 8;            // significant bits per sample
+        int shift = 0;            // bits below the sample in its container, 6 for p010
+        bool semi_planar = false;
+        int log2_chroma_w = 0;
+        int log2_chroma_h = 0;
+
+        int Planes() const { return this->semi_planar ? 2 : 3; }
+
+        bool operator==(const YuvLayout& other) const {
+            return this->bytes == other.bytes && this->depth == other.depth && this->shift == other.shift && this->semi_planar == other.semi_planar
+                && this->log2_chroma_w == other.log2_chroma_w && this->log2_chroma_h == other.log2_chroma_h;
+        }
+    };
+
+    // The inversion of one plane: luma for the frame's range, chroma reflected around the
+    // middle code, both scaled to the depth and moved up with the sample, so p010 keeps its
+    // low padding bits clear. 8-bit layouts get the constants documented on BasicInversion.
+    template <typename Sample>
+    BasicInversion<Sample> yuv_inversion(const YuvLayout& layout, int plane, bool full_range) {
+        int maximum = ((1 << layout.depth) - 1) << layout.shift;
+        BasicInversion<Sample> inversion;
+        inversion.maximum = static_cast<Sample>(maximum);
+        inversion.minuend = static_cast<Sample>(plane == 0 && !full_range ? 251 << (layout.depth - 8 + layout.shift) : maximum);
+        inversion.bias = static_cast<Sample>(plane == 0 ? 0 : 1 << layout.shift);
+        return inversion;
+    }
+
+    // Applies the tile permutation straight to planar and semi-planar YUV frames, so a frame
+    // can go from the decoder to the encoder without any RGB round trip and at its own bit
+    // depth. Every plane gets its own remap plan at its own (subsampled) resolution, and the
+    // inversion uses the YUV closed form of `1 - rgb` for the frame's colour range.
+    class PlanarRemapper {
+    public:
+        PlanarRemapper() : kernel(detect_remap_kernel()) {}
+
+        static bool Describe(AVPixelFormat pix_fmt, YuvLayout& layout) {
+            const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
+            if (!desc || desc->nb_components != 3) return false;
+            if (!(desc->flags & AV_PIX_FMT_FLAG_PLANAR) || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_BE | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM))) return false;
+
+            const AVComponentDescriptor* comp = desc->comp;
+            int depth = comp[0].depth;
+            int bytes = depth > 8 ? 2 : 1;
+            if (depth < 8 || depth > 16 || depth + comp[0].shift > 8 * bytes) return false;
+            for (int c = 0; c < 3; c++) {
+                if (comp[c].depth != depth || comp[c].shift != comp[0].shift) return false;
+            }
+
+            bool planar = comp[0].plane == 0 && comp[1].plane == 1 && comp[2].plane == 2
+                && comp[0].step == bytes && comp[1].step == bytes && comp[2].step == bytes;
+            // U and V get the same inversion, so nv21-style V-first order works as well.
+            bool semi_planar = comp[0].plane == 0 && comp[0].step == bytes && comp[1].plane == 1 && comp[2].plane == 1
+                && comp[1].step == 2 * bytes && comp[2].step == 2 * bytes && comp[1].offset + comp[2].offset == bytes;
+            if (!planar && !semi_planar) return false;
+
+            layout.bytes = bytes;
+            layout.depth = depth;
+            layout.shift = comp[0].shift;
+            layout.semi_planar = semi_planar;
+            layout.log2_chroma_w = desc->log2_chroma_w;
+            layout.log2_chroma_h = desc->log2_chroma_h;
+            return true;
+        }
+
+        static bool Supports(AVPixelFormat pix_fmt) {
+            YuvLayout layout;
+            return Describe(pix_fmt, layout);
+        }
+
+        // yuvj* formats only differ from their yuv* twins in the range they imply.
+        static bool SameLayout(AVPixelFormat a, AVPixelFormat b) {
+            YuvLayout la, lb;
+            return Describe(a, la) && Describe(b, lb) && la == lb;
+        }
+
+        static bool IsFullRange(AVPixelFormat pix_fmt, AVColorRange range) {
+            return range == AVCOL_RANGE_JPEG
+                || pix_fmt == AV_PIX_FMT_YUVJ420P
+                || pix_fmt == AV_PIX_FMT_YUVJ422P
+                || pix_fmt == AV_PIX_FMT_YUVJ444P;
+        }
+
+        // The limited-range planar format of the given depth and subsampling, or
+        // AV_PIX_FMT_NONE when libavutil has none.
+        static AVPixelFormat PlanarFormat(int depth, int log2_chroma_w, int log2_chroma_h) {
+            for (const AVPixFmtDescriptor* desc = av_pix_fmt_desc_next(nullptr); desc; desc = av_pix_fmt_desc_next(desc)) {
+                AVPixelFormat pix_fmt = av_pix_fmt_desc_get_id(desc);
+                YuvLayout layout;
+                if (Describe(pix_fmt, layout) && !layout.semi_planar && layout.shift == 0 && layout.depth == depth
+                    && layout.log2_chroma_w == log2_chroma_w && layout.log2_chroma_h == log2_chroma_h && !IsFullRange(pix_fmt, AVCOL_RANGE_UNSPECIFIED)) {
+                    return pix_fmt;
+                }
+            }
+            return AV_PIX_FMT_NONE;
+        }
+
+        void Prepare(const std::vector<float>& offset_map, const std::vector<uint32_t>& tile_map, int map_width, int map_height, const AVFrame* layout, bool full_range) {
+            this->Prepare(offset_map, tile_map, map_width, map_height, static_cast<AVPixelFormat>(layout->format), layout->width, layout->height, layout->linesize, full_range);
+        }
+
+        // Same from the format, size and source strides alone, for plans built ahead of time.
+        void Prepare(const std::vector<float>& offset_map, const std::vector<uint32_t>& tile_map, int map_width, int map_height,
+                     AVPixelFormat pix_fmt, int width, int height, const int* linesizes, bool full_range) {
+            if (!Describe(pix_fmt, this->layout)) {
+                throw std::runtime_error("Planar remap needs a planar or semi-planar YUV frame.");
+            }
+
+            this->pix_fmt = pix_fmt;
+            this->full_range = full_range;
+            for (int c = 0; c < 3; c++) {
+                if (c >= this->layout.Planes()) {
+                    this->plans[c] = RemapPlan();
+                    continue;
+                }
+                int shift_w = c == 0 ? 0 : this->layout.log2_chroma_w;
+                int shift_h = c == 0 ? 0 : this->layout.log2_chroma_h;
+                int plane_width = -((-width) >> shift_w);
+                int plane_height = -((-height) >> shift_h);
+                int channels = this->layout.semi_planar && c == 1 ? 2 : 1;
+                this->plans[c] = build_map_plan(offset_map, tile_map, map_width, map_height, plane_width, plane_height, this->layout.bytes * channels, linesizes[c]);
+            }
+
+            if (this->layout.bytes == 1) {
+                this->apply = this->layout.semi_planar ? &PlanarRemapper::ApplyAs<uint8_t, true> : &PlanarRemapper::ApplyAs<uint8_t, false>;
+            } else {
+                this->apply = this->layout.semi_planar ? &PlanarRemapper::ApplyAs<uint16_t, true> : &PlanarRemapper::ApplyAs<uint16_t, false>;
+            }
+        }
+
+        // The plans bake in the source strides. Frames with other strides have to be copied
+        // into a frame of the prepared layout first.
+        bool Matches(const AVFrame* src) const {
+            if (!SameLayout(static_cast<AVPixelFormat>(src->format), this->pix_fmt)) return false;
+            for (int c = 0; c < this->layout.Planes(); c++) {
+                if (src->linesize[c] != this->plans[c].src_linesize) return false;
+            }
+            return true;
+        }
+
+        void Apply(const AVFrame* src, AVFrame* dst) const {
+            if (!this->Matches(src) || !SameLayout(static_cast<AVPixelFormat>(dst->format), this->pix_fmt)) {
+                throw std::runtime_error("Frame layout does not match the prepared planar remap.");
+            }
+            (this->*apply)(src, dst);
+        }
+
+        RemapKernel kernel;
+        AVPixelFormat pix_fmt = AV_PIX_FMT_NONE;
+        YuvLayout layout;
+        bool full_range = false;
+        std::array<RemapPlan, 3> plans;
+
+    private:
+        // One instantiation per sample container and plane packing, picked in Prepare.
+        // Subsampling only changes the plan geometry, which the plans already carry.
+        template <typename Sample, bool SemiPlanar>
+        void ApplyAs(const AVFrame* src, AVFrame* dst) const {
+            detail::remap_plane<Sample, 1>(this->plans[0], this->kernel, yuv_inversion<Sample>(this->layout, 0, this->full_range), src->data[0], dst->data[0], dst->linesize[0]);
+            if constexpr (SemiPlanar) {
+                detail::remap_plane<Sample, 2>(this->plans[1], this->kernel, yuv_inversion<Sample>(this->layout, 1, this->full_range), src->data[1], dst->data[1], dst->linesize[1]);
+            } else {
+                for (int c = 1; c < 3; c++) {
+                    detail::remap_plane<Sample, 1>(this->plans[c], this->kernel, yuv_inversion<Sample>(this->layout, c, this->full_range), src->data[c], dst->data[c], dst->linesize[c]);
+                }
+            }
+        }
+
+        void (PlanarRemapper::*apply)(const AVFrame*, AVFrame*) const = nullptr;
+    };
+}
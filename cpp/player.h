@@ -0,0 +1,371 @@
+namespace UnsafeYT{
+    enum class PlaybackSink {Window, Raw};
+
+    // Real-time playback: transforms frames as they are decoded and shows each one at its
+    // stream timestamp, either in a visible GLFW window or as raw rgb24 frames written to
+    // the output path ("-" for stdout), e.g. for
+    //
+    //     UnsafeYT --play=raw --unshuffle in.mp4 - token | ffplay -f rawvideo -pixel_format rgb24 -video_size 1920x1080 -framerate 60 -
+    //
+    // A decoder thread prefetches up to queue_depth frames, which also bounds how long a
+    // frame can wait between decoding and display. The clock starts once the queue is full
+    // and then never moves: a frame due more than one frame interval ago is dropped while a
+    // newer one is waiting, so a slow transform or display costs frames, not sync. Only when
+    // the decoder itself falls behind and nothing newer exists is the late frame shown and
+    // the clock restarted from it (a stall). Video only; the audio track is not played.
+    //
+    // Latency is measured per shown frame from the moment the decoder returned it until it
+    // was written to the sink or handed to the window system.
+    class Player {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        Player(Video& video, PlaybackSink sink) : video(video), sink(sink) {}
+
+        ~Player() {
+            if (this->sws) sws_freeContext(this->sws);
+            av_frame_free(&this->rgb_frame);
+            av_frame_free(&this->processed_rgb_frame);
+            if (this->out && this->out != stdout) std::fclose(this->out);
+        }
+
+        long shown = 0;
+        long dropped = 0;
+        long stalls = 0;
+
+        int Run() {
+            Video& video = this->video;
+            video.Close();
+            if (video.OpenInput() != 0) {
+                return -1;
+            }
+            bool map_cached = false;
+            if (video.LoadOffsetMap(map_cached) != 0 || this->Prepare() != 0) {
+                return -1;
+            }
+
+            std::cout << "Playing " << video.frame_width << "x" << video.frame_height << " at " << video.fps << " fps, "
+                      << (video.unshuffle ? "unshuffled" : "shuffled") << ", to "
+                      << (this->sink == PlaybackSink::Window ? "a window" : PipeIO::IsPipe(video.outpath) ? "stdout as raw rgb24" : video.outpath + " as raw rgb24")
+                      << " (" << (video.backend == Backend::CPU ? std::string("CPU ") + remap_kernel_name(video.cpu_remapper.kernel)
+                                                                : std::string("OpenGL ") + context_backend_name(video.gl_context.backend))
+                      << ", prefetching " << video.queue_depth << " frames)" << std::endl;
+
+            video.telemetry.Start(video.framesOveral, video.fps, video.frame_width, video.frame_height);
+            auto started = Clock::now();
+            bool ok = this->Play();
+            double elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+
+            double mean = 0.0, p50 = 0.0, p99 = 0.0, max = 0.0;
+            this->LatencySummary(mean, p50, p99, max);
+            std::cout << "Playback: " << this->shown << " frames shown, " << this->dropped << " dropped, " << this->stalls << " stalls";
+            if (elapsed > 0.0) {
+                std::cout << " (" << this->shown / elapsed << " fps)";
+            }
+            std::cout << std::endl;
+            std::cout << "Decode-to-display latency: mean " << mean << " ms, p50 " << p50 << " ms, p99 " << p99 << " ms, max " << max << " ms" << std::endl;
+
+            video.frameCount = this->shown;
+            video.telemetry.Playback(this->shown, this->dropped, this->stalls, mean, p50, p99, max);
+            video.telemetry.Done(ok, this->shown);
+            return ok ? 0 : -1;
+        }
+
+    private:
+        struct Decoded {
+            AVFrame* frame = nullptr;
+            Clock::time_point at;
+        };
+
+        int Prepare() {
+            Video& video = this->video;
+            int width = video.frame_width;
+            int height = video.frame_height;
+
+            this->sws = sws_getCachedContext(this->sws,
+                width, height, video.in_codec_ctx->pix_fmt,
+                width, height, AV_PIX_FMT_RGB24,
+                SWS_POINT, NULL, NULL, NULL
+            );
+            if (!this->sws) {
+                std::cerr << "Error: Cannot create SwsContext for color conversion." << std::endl;
+                return -1;
+            }
+
+            if (this->sink == PlaybackSink::Raw) {
+                if (PipeIO::IsPipe(video.outpath)) {
+                #ifdef _WIN32
+                    _setmode(_fileno(stdout), _O_BINARY);
+                #endif
+                    this->out = stdout;
+                } else if (!(this->out = std::fopen(video.outpath.c_str(), "wb"))) {
+                    std::cerr << "Error: Could not open raw output '" << video.outpath << "'." << std::endl;
+                    return -1;
+                }
+                this->pixels.resize(static_cast<size_t>(width) * height * 3);
+            }
+
+            if (video.backend == Backend::CPU) {
+                this->rgb_frame = Video::AllocateFrame(AV_PIX_FMT_RGB24, width, height);
+                this->processed_rgb_frame = Video::AllocateFrame(AV_PIX_FMT_RGB24, width, height);
+                if (!this->rgb_frame || !this->processed_rgb_frame) {
+                    std::cerr << "Error: Failed to allocate RGB frames." << std::endl;
+                    return -1;
+                }
+                try {
+                    video.cpu_remapper.Prepare(video.offset_map, video.tile_map, video.map_width, video.map_height, width, height, this->rgb_frame->linesize[0]);
+                }
+                catch (const std::runtime_error& e) {
+                    std::cerr << "Error preparing CPU remap: " << e.what() << std::endl;
+                    return -1;
+                }
+                return 0;
+            }
+
+            // One frame at a time, in RGB; a batch would hold frames back and add latency, and
+            // the window shows the RGB target.
+            video.gl_batch = 1;
+            video.gpu_yuv = false;
+            if (this->sink == PlaybackSink::Window) {
+                int scale = 1;
+                while (width / scale > 1920 || height / scale > 1080) {
+                    scale *= 2;
+                }
+                video.gl_context.window_width = width / scale;
+                video.gl_context.window_height = height / scale;
+                video.gl_context.window_title = "UnsafeYT - " + std::filesystem::path(video.inpath).filename().string();
+            }
+            if (video.InitOpenGL() != 0) {
+                return -1;
+            }
+            if (video.Tiled()) {
+                std::cerr << "Error: The frame is too large for a GL texture; play it with --play=raw --backend=cpu." << std::endl;
+                return -1;
+            }
+            return 0;
+        }
+
+        bool Play() {
+            Video& video = this->video;
+            std::atomic<bool> stop{false};
+            std::atomic<bool> decoder_done{false};
+            const std::atomic<bool> drain{false};
+
+            SpscQueue<Decoded> decoded(video.queue_depth);
+            SpscQueue<AVFrame*> decoded_free(video.queue_depth + 1);
+            std::vector<AVFrame*> shells;
+            for (int i = 0; i < video.queue_depth + 1; i++) {
+                AVFrame* shell = av_frame_alloc();
+                if (!shell) {
+                    std::cerr << "Error: Failed to allocate decoded frame." << std::endl;
+                    for (AVFrame*& frame : shells) av_frame_free(&frame);
+                    return false;
+                }
+                shells.push_back(shell);
+                decoded_free.TryPush(shell);
+            }
+            video.decoded_stats = QueueStats{"decoded"};
+            this->latencies.clear();
+
+            std::thread decoder([&]() {
+                AVCodecContext* codec = video.in_codec_ctx;
+                auto decode_started = video.telemetry.Now();
+                auto receive = [&]() {
+                    while (avcodec_receive_frame(codec, video.in_frame) >= 0) {
+                        video.telemetry.AddSince(video.telemetry.decode, decode_started);
+                        AVFrame* shell = nullptr;
+                        if (!decoded_free.Pop(shell, stop)) return false;
+                        av_frame_move_ref(shell, video.in_frame);
+                        if (!decoded.Push(Decoded{shell, Clock::now()}, stop)) return false;
+                        decode_started = video.telemetry.Now();
+                    }
+                    return true;
+                };
+
+                bool running = true;
+                while (running && !stop.load() && av_read_frame(video.in_fmt_ctx, video.in_packet) >= 0) {
+                    decode_started = video.telemetry.Now();
+                    if (video.in_packet->stream_index == video.video_stream_index && avcodec_send_packet(codec, video.in_packet) >= 0) {
+                        running = receive();
+                    }
+                    av_packet_unref(video.in_packet);
+                }
+                // Frames the decoder still holds back for reordering.
+                if (running && !stop.load() && avcodec_send_packet(codec, NULL) >= 0) {
+                    receive();
+                }
+                decoded.Push(Decoded{}, stop);
+                decoder_done = true;
+            });
+
+            while (!decoder_done.load() && decoded.Size() < decoded.Capacity()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            AVRational time_base = video.in_fmt_ctx->streams[video.video_stream_index]->time_base;
+            double frame_seconds = video.fps > 0.0 ? 1.0 / video.fps : 1.0 / 30.0;
+            auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(frame_seconds));
+            Clock::time_point origin = Clock::now();
+            int64_t origin_pts = AV_NOPTS_VALUE;
+            double media = -frame_seconds;
+
+            bool running = true;
+            Decoded item;
+            while (running && decoded.Pop(item, drain) && item.frame) {
+                AVFrame* frame = item.frame;
+                // Frames before the first timestamp are spaced one interval apart; that
+                // timestamp then anchors the clock.
+                int64_t ts = frame->best_effort_timestamp;
+                if (origin_pts == AV_NOPTS_VALUE && ts != AV_NOPTS_VALUE) {
+                    origin_pts = ts;
+                    origin += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(media + frame_seconds));
+                    media = 0.0;
+                } else {
+                    media = ts != AV_NOPTS_VALUE ? (ts - origin_pts) * av_q2d(time_base) : media + frame_seconds;
+                }
+                Clock::time_point due = origin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(media));
+
+                Clock::time_point now = Clock::now();
+                bool late = now > due + interval;
+                if (late && decoded.Size() > 0) {
+                    this->dropped++;
+                } else {
+                    if (late) {
+                        origin += now - due;
+                        due = now;
+                        this->stalls++;
+                    }
+                    WaitUntil(due);
+
+                    auto transform_started = video.telemetry.Now();
+                    try {
+                        running = this->Present(frame);
+                    }
+                    catch (const std::runtime_error& e) {
+                        std::cerr << "Error transforming frame: " << e.what() << std::endl;
+                        running = false;
+                    }
+                    video.telemetry.AddSince(video.telemetry.transform, transform_started);
+                    this->latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - item.at).count());
+                    this->shown++;
+                }
+
+                av_frame_unref(frame);
+                decoded_free.Push(frame, drain);
+                video.decoded_stats.Sample(decoded);
+                const QueueStats* queues[] = {&video.decoded_stats};
+                video.telemetry.Frame(this->shown + this->dropped, queues, 1);
+                running = video.gl_context.Poll() && running;
+            }
+
+            stop = true;
+            decoder.join();
+            for (AVFrame*& shell : shells) {
+                av_frame_free(&shell);
+            }
+            if (video.print_queue_stats) {
+                std::cerr << "Queues: " << video.decoded_stats << std::endl;
+            }
+            return running;
+        }
+
+        // Sleeps most of the way and yields for the last millisecond, since sleep_until alone
+        // can overshoot by a whole scheduler tick.
+        static void WaitUntil(Clock::time_point due) {
+            for (Clock::time_point now = Clock::now(); now < due; now = Clock::now()) {
+                if (due - now > std::chrono::milliseconds(2)) {
+                    std::this_thread::sleep_for(due - now - std::chrono::milliseconds(1));
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        bool Present(AVFrame* frame) {
+            Video& video = this->video;
+            int width = video.frame_width;
+            int height = video.frame_height;
+
+            if (video.backend == Backend::CPU) {
+                sws_scale(this->sws, frame->data, frame->linesize, 0, height, this->rgb_frame->data, this->rgb_frame->linesize);
+                video.cpu_remapper.Apply(this->rgb_frame, this->processed_rgb_frame);
+                return this->WriteRaw(this->processed_rgb_frame->data[0], this->processed_rgb_frame->linesize[0]);
+            }
+
+            uint8_t* upload = video.transfer_ring.BeginUpload();
+            if (!upload) {
+                std::cerr << "Error: Failed to map pixel upload buffer." << std::endl;
+                return false;
+            }
+            uint8_t* upload_data[4] = {upload, nullptr, nullptr, nullptr};
+            int upload_linesize[4] = {video.transfer_ring.Stride(), 0, 0, 0};
+            sws_scale(this->sws, frame->data, frame->linesize, 0, height, upload_data, upload_linesize);
+            video.transfer_ring.EndUpload(video.inputTexture);
+            video.DrawFrame();
+
+            if (this->sink == PlaybackSink::Raw) {
+                glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, this->pixels.data());
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                return this->WriteRaw(this->pixels.data(), width * 3);
+            }
+
+            // Letterboxed into the window. The render target holds the top row at y = 0, the
+            // way it is read back for encoding, so the blit flips it.
+            int window_width = 0, window_height = 0;
+            video.gl_context.FramebufferSize(window_width, window_height);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, window_width, window_height);
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            if (window_width > 0 && window_height > 0) {
+                double scale = std::min(static_cast<double>(window_width) / width, static_cast<double>(window_height) / height);
+                int shown_width = static_cast<int>(std::lround(width * scale));
+                int shown_height = static_cast<int>(std::lround(height * scale));
+                int x = (window_width - shown_width) / 2;
+                int y = (window_height - shown_height) / 2;
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, video.fbo);
+                glBlitFramebuffer(0, 0, width, height, x, y + shown_height, x + shown_width, y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            }
+            video.gl_context.SwapBuffers();
+            return true;
+        }
+
+        bool WriteRaw(const uint8_t* data, int linesize) {
+            size_t row = static_cast<size_t>(this->video.frame_width) * 3;
+            bool ok = true;
+            if (static_cast<size_t>(linesize) == row) {
+                ok = std::fwrite(data, 1, row * this->video.frame_height, this->out) == row * this->video.frame_height;
+            } else {
+                for (int y = 0; ok && y < this->video.frame_height; y++) {
+                    ok = std::fwrite(data + static_cast<size_t>(y) * linesize, 1, row, this->out) == row;
+                }
+            }
+            if (!ok || std::fflush(this->out) != 0) {
+                std::cerr << "Error: Failed to write a raw frame; the reader may have gone away." << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        void LatencySummary(double& mean, double& p50, double& p99, double& max) {
+            if (this->latencies.empty()) return;
+            std::vector<double>& sorted = this->latencies;
+            std::sort(sorted.begin(), sorted.end());
+            mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+            p50 = sorted[sorted.size() / 2];
+            p99 = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+            max = sorted.back();
+        }
+
+        Video& video;
+        PlaybackSink sink;
+        SwsContext* sws = nullptr;
+        AVFrame* rgb_frame = nullptr;
+        AVFrame* processed_rgb_frame = nullptr;
+        std::vector<uint8_t> pixels;
+        std::vector<double> latencies;
+        FILE* out = nullptr;
+    };
+}
@@ -0,0 +1,556 @@
+namespace UnsafeYT{
+    // PSNR and SSIM of one encoded frame against the frame the encoder was given: per plane of
+    // an 8-bit YUV format, and over the whole frame with planes weighted by their sample counts.
+    // Identical planes have no finite PSNR; like x264, they report 100 dB.
+    struct FrameQuality {
+        long frame = 0;
+        int planes = 0;
+        double psnr[3] = {0.0, 0.0, 0.0};
+        double ssim[3] = {0.0, 0.0, 0.0};
+        double psnr_all = 0.0;
+        double ssim_all = 0.0;
+    };
+
+    // Aggregate of a run. PSNR per plane and "all" come from the summed squared error of every
+    // measured frame, as x264's global PSNR does; psnr_mean and the minimums are over frames.
+    struct QualitySummary {
+        long frames = 0;
+        long skipped = 0;
+        int planes = 0;
+        double psnr[3] = {0.0, 0.0, 0.0};
+        double ssim[3] = {0.0, 0.0, 0.0};
+        double psnr_all = 0.0;
+        double ssim_all = 0.0;
+        double psnr_mean = 0.0;
+        double psnr_min = 0.0;
+        double ssim_min = 0.0;
+        double overhead_ms = 0.0;
+    };
+
+    // Squared error and summed SSIM of one plane pair.
+    struct PlaneStats {
+        uint64_t sse = 0;
+        uint64_t samples = 0;
+        double ssim_sum = 0.0;
+        uint64_t windows = 0;
+    };
+
+    inline double psnr_from_sse(uint64_t sse, uint64_t samples) {
+        if (sse == 0 || samples == 0) return 100.0;
+        return std::min(100.0, 10.0 * std::log10(255.0 * 255.0 * static_cast<double>(samples) / static_cast<double>(sse)));
+    }
+
+    namespace detail {
+        // SSIM is taken over 8x8 windows stepped by 4 and assembled from sums over 4x4 blocks,
+        // as x264 does: s1 = sum a, s2 = sum b, ss = sum a*a + b*b, s12 = sum a*b. Every kernel
+        // produces the same integer sums, so they all give the same result.
+        struct BlockSums {
+            int32_t s1;
+            int32_t s2;
+            int32_t ss;
+            int32_t s12;
+        };
+
+        inline float ssim_window(int s1, int s2, int ss, int s12) {
+            const int c1 = static_cast<int>(.01 * .01 * 255 * 255 * 64 + .5);
+            const int c2 = static_cast<int>(.03 * .03 * 255 * 255 * 64 * 63 + .5);
+            int vars = ss * 64 - s1 * s1 - s2 * s2;
+            int covar = s12 * 64 - s1 * s2;
+            return static_cast<float>(2 * s1 * s2 + c1) * static_cast<float>(2 * covar + c2)
+                 / (static_cast<float>(s1 * s1 + s2 * s2 + c1) * static_cast<float>(vars + c2));
+        }
+
+        inline void sse_row_scalar(const uint8_t* a, const uint8_t* b, int x, int width, uint64_t& sum) {
+            uint64_t row = 0;
+            for (; x < width; ++x) {
+                int d = a[x] - b[x];
+                row += static_cast<uint64_t>(d * d);
+            }
+            sum += row;
+        }
+
+        inline void block_sums_scalar(const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize, int i, int blocks, BlockSums* out) {
+            for (; i < blocks; ++i) {
+                int s1 = 0, s2 = 0, ss = 0, s12 = 0;
+                for (int y = 0; y < 4; ++y) {
+                    const uint8_t* pa = a + static_cast<size_t>(y) * a_linesize + i * 4;
+                    const uint8_t* pb = b + static_cast<size_t>(y) * b_linesize + i * 4;
+                    for (int x = 0; x < 4; ++x) {
+                        int va = pa[x], vb = pb[x];
+                        s1 += va;
+                        s2 += vb;
+                        ss += va * va + vb * vb;
+                        s12 += va * vb;
+                    }
+                }
+                out[i] = {s1, s2, ss, s12};
+            }
+        }
+
+    #if defined(__x86_64__) || defined(__i386__)
+        // Per-row lane sums stay below 2^32 for rows narrower than half a million samples.
+        __attribute__((target("avx2")))
+        inline int sse_row_avx2(const uint8_t* a, const uint8_t* b, int width, uint64_t& sum) {
+            const __m256i zero = _mm256_setzero_si256();
+            __m256i acc = zero;
+            int x = 0;
+            for (; x + 32 <= width; x += 32) {
+                __m256i pa = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + x));
+                __m256i pb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + x));
+                __m256i d = _mm256_or_si256(_mm256_subs_epu8(pa, pb), _mm256_subs_epu8(pb, pa));
+                __m256i lo = _mm256_unpacklo_epi8(d, zero);
+                __m256i hi = _mm256_unpackhi_epi8(d, zero);
+                acc = _mm256_add_epi32(acc, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+            }
+            alignas(32) uint32_t lanes[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            for (uint32_t lane : lanes) sum += lane;
+            return x;
+        }
+
+        // Four blocks per step: the 16 samples of a block row widen to 16 bits, and the
+        // horizontal adds leave blocks 0 and 2 in one register and 1 and 3 in the other.
+        __attribute__((target("avx2")))
+        inline int block_sums_avx2(const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize, int blocks, BlockSums* out) {
+            const __m256i ones = _mm256_set1_epi16(1);
+            int i = 0;
+            for (; i + 4 <= blocks; i += 4) {
+                __m256i sa = _mm256_setzero_si256(), sb = sa, ss = sa, sab = sa;
+                for (int y = 0; y < 4; ++y) {
+                    __m256i pa = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + static_cast<size_t>(y) * a_linesize + i * 4)));
+                    __m256i pb = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + static_cast<size_t>(y) * b_linesize + i * 4)));
+                    sa = _mm256_add_epi16(sa, pa);
+                    sb = _mm256_add_epi16(sb, pb);
+                    ss = _mm256_add_epi32(ss, _mm256_add_epi32(_mm256_madd_epi16(pa, pa), _mm256_madd_epi16(pb, pb)));
+                    sab = _mm256_add_epi32(sab, _mm256_madd_epi16(pa, pb));
+                }
+                __m256i first = _mm256_hadd_epi32(_mm256_madd_epi16(sa, ones), ss);
+                __m256i second = _mm256_hadd_epi32(_mm256_madd_epi16(sb, ones), sab);
+                __m256i low = _mm256_unpacklo_epi32(first, second);
+                __m256i high = _mm256_unpackhi_epi32(first, second);
+                __m256i even = _mm256_unpacklo_epi64(low, high);
+                __m256i odd = _mm256_unpackhi_epi64(low, high);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute2x128_si256(even, odd, 0x20));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 2), _mm256_permute2x128_si256(even, odd, 0x31));
+            }
+            return i;
+        }
+
+        __attribute__((target("sse4.1")))
+        inline int sse_row_sse41(const uint8_t* a, const uint8_t* b, int width, uint64_t& sum) {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i acc = zero;
+            int x = 0;
+            for (; x + 16 <= width; x += 16) {
+                __m128i pa = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+                __m128i pb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+                __m128i d = _mm_or_si128(_mm_subs_epu8(pa, pb), _mm_subs_epu8(pb, pa));
+                __m128i lo = _mm_unpacklo_epi8(d, zero);
+                __m128i hi = _mm_unpackhi_epi8(d, zero);
+                acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+            }
+            alignas(16) uint32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+            for (uint32_t lane : lanes) sum += lane;
+            return x;
+        }
+
+        __attribute__((target("sse4.1")))
+        inline int block_sums_sse41(const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize, int blocks, BlockSums* out) {
+            const __m128i ones = _mm_set1_epi16(1);
+            int i = 0;
+            for (; i + 2 <= blocks; i += 2) {
+                __m128i sa = _mm_setzero_si128(), sb = sa, ss = sa, sab = sa;
+                for (int y = 0; y < 4; ++y) {
+                    __m128i pa = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + static_cast<size_t>(y) * a_linesize + i * 4)));
+                    __m128i pb = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + static_cast<size_t>(y) * b_linesize + i * 4)));
+                    sa = _mm_add_epi16(sa, pa);
+                    sb = _mm_add_epi16(sb, pb);
+                    ss = _mm_add_epi32(ss, _mm_add_epi32(_mm_madd_epi16(pa, pa), _mm_madd_epi16(pb, pb)));
+                    sab = _mm_add_epi32(sab, _mm_madd_epi16(pa, pb));
+                }
+                __m128i first = _mm_hadd_epi32(_mm_madd_epi16(sa, ones), ss);
+                __m128i second = _mm_hadd_epi32(_mm_madd_epi16(sb, ones), sab);
+                __m128i low = _mm_unpacklo_epi32(first, second);
+                __m128i high = _mm_unpackhi_epi32(first, second);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi64(low, high));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 1), _mm_unpackhi_epi64(low, high));
+            }
+            return i;
+        }
+    #endif
+
+    #if defined(__aarch64__)
+        inline int sse_row_neon(const uint8_t* a, const uint8_t* b, int width, uint64_t& sum) {
+            uint32x4_t acc = vdupq_n_u32(0);
+            int x = 0;
+            for (; x + 16 <= width; x += 16) {
+                uint8x16_t d = vabdq_u8(vld1q_u8(a + x), vld1q_u8(b + x));
+                acc = vpadalq_u16(acc, vmull_u8(vget_low_u8(d), vget_low_u8(d)));
+                acc = vpadalq_u16(acc, vmull_u8(vget_high_u8(d), vget_high_u8(d)));
+            }
+            sum += vaddlvq_u32(acc);
+            return x;
+        }
+
+        inline int block_sums_neon(const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize, int blocks, BlockSums* out) {
+            int i = 0;
+            for (; i + 2 <= blocks; i += 2) {
+                uint16x8_t sa = vdupq_n_u16(0), sb = sa;
+                uint32x4_t ss = vdupq_n_u32(0), sab = ss;
+                for (int y = 0; y < 4; ++y) {
+                    uint8x8_t pa = vld1_u8(a + static_cast<size_t>(y) * a_linesize + i * 4);
+                    uint8x8_t pb = vld1_u8(b + static_cast<size_t>(y) * b_linesize + i * 4);
+                    sa = vaddw_u8(sa, pa);
+                    sb = vaddw_u8(sb, pb);
+                    ss = vpadalq_u16(ss, vmull_u8(pa, pa));
+                    ss = vpadalq_u16(ss, vmull_u8(pb, pb));
+                    sab = vpadalq_u16(sab, vmull_u8(pa, pb));
+                }
+                uint32x4_t s1 = vpaddlq_u16(sa), s2 = vpaddlq_u16(sb);
+                uint32x2x2_t sums = vzip_u32(vpadd_u32(vget_low_u32(s1), vget_high_u32(s1)), vpadd_u32(vget_low_u32(s2), vget_high_u32(s2)));
+                uint32x2x2_t squares = vzip_u32(vpadd_u32(vget_low_u32(ss), vget_high_u32(ss)), vpadd_u32(vget_low_u32(sab), vget_high_u32(sab)));
+                vst1q_u32(reinterpret_cast<uint32_t*>(out + i), vcombine_u32(sums.val[0], squares.val[0]));
+                vst1q_u32(reinterpret_cast<uint32_t*>(out + i + 1), vcombine_u32(sums.val[1], squares.val[1]));
+            }
+            return i;
+        }
+    #endif
+
+        inline void sse_row(RemapKernel kernel, const uint8_t* a, const uint8_t* b, int width, uint64_t& sum) {
+            int done = 0;
+            switch (kernel) {
+            #if defined(__x86_64__) || defined(__i386__)
+                case RemapKernel::AVX2: done = sse_row_avx2(a, b, width, sum); break;
+                case RemapKernel::SSE41: done = sse_row_sse41(a, b, width, sum); break;
+            #endif
+            #if defined(__aarch64__)
+                case RemapKernel::NEON: done = sse_row_neon(a, b, width, sum); break;
+            #endif
+                default: break;
+            }
+            sse_row_scalar(a, b, done, width, sum);
+        }
+
+        inline void block_sums(RemapKernel kernel, const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize, int blocks, BlockSums* out) {
+            int done = 0;
+            switch (kernel) {
+            #if defined(__x86_64__) || defined(__i386__)
+                case RemapKernel::AVX2: done = block_sums_avx2(a, a_linesize, b, b_linesize, blocks, out); break;
+                case RemapKernel::SSE41: done = block_sums_sse41(a, a_linesize, b, b_linesize, blocks, out); break;
+            #endif
+            #if defined(__aarch64__)
+                case RemapKernel::NEON: done = block_sums_neon(a, a_linesize, b, b_linesize, blocks, out); break;
+            #endif
+                default: break;
+            }
+            block_sums_scalar(a, a_linesize, b, b_linesize, done, blocks, out);
+        }
+    }
+
+    // Squared error and SSIM of two 8-bit planes of width x height samples, in one pass over
+    // bands of four rows. Planes smaller than 8x8 have no SSIM window.
+    PlaneStats compare_plane(RemapKernel kernel, const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize, int width, int height) {
+        PlaneStats stats;
+        stats.samples = static_cast<uint64_t>(width) * height;
+        int blocks_x = width / 4;
+        int blocks_y = height / 4;
+        std::vector<detail::BlockSums> above(blocks_x), below(blocks_x);
+
+        for (int by = 0; by < blocks_y; ++by) {
+            const uint8_t* band_a = a + static_cast<size_t>(by) * 4 * a_linesize;
+            const uint8_t* band_b = b + static_cast<size_t>(by) * 4 * b_linesize;
+            for (int y = 0; y < 4; ++y) {
+                detail::sse_row(kernel, band_a + static_cast<size_t>(y) * a_linesize, band_b + static_cast<size_t>(y) * b_linesize, width, stats.sse);
+            }
+            detail::block_sums(kernel, band_a, a_linesize, band_b, b_linesize, blocks_x, below.data());
+            if (by > 0) {
+                for (int bx = 0; bx + 1 < blocks_x; ++bx) {
+                    const detail::BlockSums& p = above[bx];
+                    const detail::BlockSums& q = above[bx + 1];
+                    const detail::BlockSums& r = below[bx];
+                    const detail::BlockSums& s = below[bx + 1];
+                    stats.ssim_sum += detail::ssim_window(p.s1 + q.s1 + r.s1 + s.s1, p.s2 + q.s2 + r.s2 + s.s2,
+                                                          p.ss + q.ss + r.ss + s.ss, p.s12 + q.s12 + r.s12 + s.s12);
+                }
+                stats.windows += blocks_x > 1 ? blocks_x - 1 : 0;
+            }
+            std::swap(above, below);
+        }
+        for (int y = blocks_y * 4; y < height; ++y) {
+            detail::sse_row(kernel, a + static_cast<size_t>(y) * a_linesize, b + static_cast<size_t>(y) * b_linesize, width, stats.sse);
+        }
+        return stats;
+    }
+
+    // Inline quality metrics of an encode. Every `interval`-th frame (by pts, so segments of one
+    // input sample the same frames) is copied before it goes to the encoder and compared with
+    // its reconstruction once that comes back: from the encoder itself where it supports
+    // AV_CODEC_FLAG_RECON_FRAME (libx264 does), otherwise from a decoder fed the encoder's
+    // packets. That decoder sees every packet of inter codecs and only the sampled ones of
+    // intra-only codecs. At most MAX_PENDING copies wait for their reconstruction; frames
+    // sampled beyond that are skipped and counted, which bounds both memory and time.
+    //
+    // All calls come from the thread that runs the encoder. The time spent here is measured
+    // and reported as the overhead of the metrics.
+    class QualityMeter {
+    public:
+        static constexpr size_t MAX_PENDING = 32;
+        using Listener = std::function<void(const FrameQuality&)>;
+
+        int interval = 0;
+        Listener on_frame;
+
+        QualityMeter() : kernel(detect_remap_kernel()) {}
+        QualityMeter(const QualityMeter&) = delete;
+        QualityMeter& operator=(const QualityMeter&) = delete;
+        ~QualityMeter() { this->Close(); }
+
+        static bool Supports(AVPixelFormat pix_fmt) {
+            const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
+            if (!desc || (desc->flags & AV_PIX_FMT_FLAG_RGB) || desc->comp[0].depth != 8) return false;
+            int planes = std::min<int>(desc->nb_components, 3);
+            for (int c = 0; c < planes; c++) {
+                if (desc->comp[c].plane != c || desc->comp[c].step != 1) return false;
+            }
+            return true;
+        }
+
+        // Before avcodec_open2: asks for reconstructed frames where the encoder can return them.
+        void Configure(AVCodecContext* encoder) {
+            this->use_recon = false;
+            if (this->interval <= 0) return;
+        #ifdef AV_CODEC_FLAG_RECON_FRAME
+            if (encoder->codec->capabilities & AV_CODEC_CAP_ENCODER_RECON_FRAME) {
+                encoder->flags |= AV_CODEC_FLAG_RECON_FRAME;
+                this->use_recon = true;
+            }
+        #endif
+        }
+
+        // After avcodec_open2, with the stream parameters taken from the opened encoder.
+        // Returns false, having said why, when the metrics cannot run for this encode.
+        bool Open(AVCodecContext* encoder, const AVCodecParameters* parameters) {
+            this->Close();
+            if (this->interval <= 0) return false;
+            if (!Supports(encoder->pix_fmt)) {
+                std::cerr << "Warning: Quality metrics need 8-bit planar YUV; not measuring " << av_get_pix_fmt_name(encoder->pix_fmt) << " output." << std::endl;
+                return false;
+            }
+            this->planes = std::min<int>(av_pix_fmt_desc_get(encoder->pix_fmt)->nb_components, 3);
+            if (!this->use_recon) {
+                const AVCodec* codec = avcodec_find_decoder(encoder->codec->id);
+                this->decoder = codec ? avcodec_alloc_context3(codec) : nullptr;
+                if (!this->decoder || avcodec_parameters_to_context(this->decoder, parameters) < 0) {
+                    std::cerr << "Warning: No decoder for " << encoder->codec->name << " output; quality metrics are off." << std::endl;
+                    this->Close();
+                    return false;
+                }
+                // Slice threads only: frame threads would hold back reconstructions for no gain.
+                this->decoder->pkt_timebase = encoder->time_base;
+                this->decoder->thread_count = 0;
+                this->decoder->thread_type = FF_THREAD_SLICE;
+                if (avcodec_open2(this->decoder, codec, NULL) < 0) {
+                    std::cerr << "Warning: Could not open a " << codec->name << " decoder; quality metrics are off." << std::endl;
+                    this->Close();
+                    return false;
+                }
+                const AVCodecDescriptor* descriptor = avcodec_descriptor_get(encoder->codec->id);
+                this->intra_only = descriptor && (descriptor->props & AV_CODEC_PROP_INTRA_ONLY);
+            }
+            this->reconstructed = av_frame_alloc();
+            this->summary = QualitySummary();
+            this->summary.planes = this->planes;
+            this->summary.psnr_min = 100.0;
+            this->summary.ssim_min = 1.0;
+            for (PlaneStats& total : this->totals) total = PlaneStats();
+            this->psnr_sum = 0.0;
+            this->elapsed_ns = 0;
+            this->active = this->reconstructed != nullptr;
+            return this->active;
+        }
+
+        bool Active() const { return this->active; }
+        bool FromEncoder() const { return this->use_recon; }
+
+        bool Sampled(int64_t pts) const {
+            return this->active && pts != AV_NOPTS_VALUE && pts % this->interval == 0;
+        }
+
+        // Keeps a copy of `frame` if its pts is sampled. Call before it is sent to the encoder.
+        void Capture(const AVFrame* frame) {
+            if (!this->Sampled(frame->pts)) return;
+            auto started = std::chrono::steady_clock::now();
+            if (this->pending.size() >= MAX_PENDING) {
+                this->summary.skipped++;
+            } else {
+                AVFrame* copy = this->TakeFrame(frame);
+                if (copy && av_frame_copy(copy, frame) >= 0) {
+                    copy->pts = frame->pts;
+                    this->pending.push_back(copy);
+                } else {
+                    if (copy) this->free_frames.push_back(copy);
+                    this->summary.skipped++;
+                }
+            }
+            this->AddTime(started);
+        }
+
+        // After every packet the encoder returns, before its timestamps are rescaled.
+        void Packet(AVCodecContext* encoder, const AVPacket* packet) {
+            if (!this->active) return;
+            auto started = std::chrono::steady_clock::now();
+            if (this->use_recon) {
+                // The reconstruction belongs to the packet just received, in coded order.
+                if (avcodec_receive_frame(encoder, this->reconstructed) >= 0) {
+                    this->Compare(packet->pts, this->reconstructed);
+                    av_frame_unref(this->reconstructed);
+                }
+            } else if (!this->intra_only || this->Sampled(packet->pts)) {
+                if (avcodec_send_packet(this->decoder, packet) >= 0) {
+                    this->Drain();
+                }
+            }
+            this->AddTime(started);
+        }
+
+        // After the encoder is flushed: drains the decoder and gives up on what never came back.
+        void Flush() {
+            if (!this->active) return;
+            auto started = std::chrono::steady_clock::now();
+            if (this->decoder && avcodec_send_packet(this->decoder, NULL) >= 0) {
+                this->Drain();
+            }
+            this->summary.skipped += static_cast<long>(this->pending.size());
+            for (AVFrame* frame : this->pending) this->free_frames.push_back(frame);
+            this->pending.clear();
+            this->AddTime(started);
+        }
+
+        QualitySummary Summary() const {
+            QualitySummary result = this->summary;
+            uint64_t sse = 0, samples = 0, windows = 0;
+            double ssim = 0.0;
+            for (int c = 0; c < this->planes; c++) {
+                const PlaneStats& total = this->totals[c];
+                result.psnr[c] = psnr_from_sse(total.sse, total.samples);
+                result.ssim[c] = total.windows ? total.ssim_sum / total.windows : 1.0;
+                sse += total.sse;
+                samples += total.samples;
+                ssim += total.ssim_sum;
+                windows += total.windows;
+            }
+            result.psnr_all = psnr_from_sse(sse, samples);
+            result.ssim_all = windows ? ssim / windows : 1.0;
+            result.psnr_mean = result.frames ? this->psnr_sum / result.frames : 0.0;
+            result.overhead_ms = this->elapsed_ns / 1e6;
+            return result;
+        }
+
+        uint64_t ElapsedNs() const { return this->elapsed_ns; }
+
+        void Close() {
+            for (AVFrame* frame : this->pending) av_frame_free(&frame);
+            for (AVFrame* frame : this->free_frames) av_frame_free(&frame);
+            this->pending.clear();
+            this->free_frames.clear();
+            if (this->reconstructed) av_frame_free(&this->reconstructed);
+            if (this->decoder) avcodec_free_context(&this->decoder);
+            this->intra_only = false;
+            this->active = false;
+        }
+
+        RemapKernel kernel;
+
+    private:
+        void Drain() {
+            while (avcodec_receive_frame(this->decoder, this->reconstructed) >= 0) {
+                int64_t pts = this->reconstructed->pts != AV_NOPTS_VALUE ? this->reconstructed->pts : this->reconstructed->best_effort_timestamp;
+                this->Compare(pts, this->reconstructed);
+                av_frame_unref(this->reconstructed);
+            }
+        }
+
+        void Compare(int64_t pts, const AVFrame* reconstructed) {
+            if (!this->Sampled(pts)) return;
+            auto found = std::find_if(this->pending.begin(), this->pending.end(), [&](const AVFrame* frame) { return frame->pts == pts; });
+            if (found == this->pending.end()) return;
+            AVFrame* source = *found;
+            this->pending.erase(found);
+            this->free_frames.push_back(source);
+            if (reconstructed->format != source->format || reconstructed->width != source->width || reconstructed->height != source->height) {
+                this->summary.skipped++;
+                return;
+            }
+
+            const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(source->format));
+            FrameQuality quality;
+            quality.frame = static_cast<long>(pts);
+            quality.planes = this->planes;
+            uint64_t sse = 0, samples = 0, windows = 0;
+            double ssim = 0.0;
+            for (int c = 0; c < this->planes; c++) {
+                int width = c == 0 ? source->width : AV_CEIL_RSHIFT(source->width, desc->log2_chroma_w);
+                int height = c == 0 ? source->height : AV_CEIL_RSHIFT(source->height, desc->log2_chroma_h);
+                PlaneStats stats = compare_plane(this->kernel, source->data[c], source->linesize[c], reconstructed->data[c], reconstructed->linesize[c], width, height);
+                quality.psnr[c] = psnr_from_sse(stats.sse, stats.samples);
+                quality.ssim[c] = stats.windows ? stats.ssim_sum / stats.windows : 1.0;
+
+                PlaneStats& total = this->totals[c];
+                total.sse += stats.sse;
+                total.samples += stats.samples;
+                total.ssim_sum += stats.ssim_sum;
+                total.windows += stats.windows;
+                sse += stats.sse;
+                samples += stats.samples;
+                ssim += stats.ssim_sum;
+                windows += stats.windows;
+            }
+            quality.psnr_all = psnr_from_sse(sse, samples);
+            quality.ssim_all = windows ? ssim / windows : 1.0;
+
+            this->summary.frames++;
+            this->summary.psnr_min = std::min(this->summary.psnr_min, quality.psnr_all);
+            this->summary.ssim_min = std::min(this->summary.ssim_min, quality.ssim_all);
+            this->psnr_sum += quality.psnr_all;
+            if (this->on_frame) this->on_frame(quality);
+        }
+
+        AVFrame* TakeFrame(const AVFrame* like) {
+            while (!this->free_frames.empty()) {
+                AVFrame* frame = this->free_frames.back();
+                this->free_frames.pop_back();
+                if (frame->format == like->format && frame->width == like->width && frame->height == like->height) {
+                    return frame;
+                }
+                av_frame_free(&frame);
+            }
+            AVFrame* frame = av_frame_alloc();
+            if (!frame) return nullptr;
+            frame->format = like->format;
+            frame->width = like->width;
+            frame->height = like->height;
+            if (av_frame_get_buffer(frame, 0) < 0) {
+                av_frame_free(&frame);
+            }
+            return frame;
+        }
+
+        void AddTime(std::chrono::steady_clock::time_point started) {
+            this->elapsed_ns += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+        }
+
+        bool active = false;
+        bool use_recon = false;
+        bool intra_only = false;
+        int planes = 0;
+        AVCodecContext* decoder = nullptr;
+        AVFrame* reconstructed = nullptr;
+        std::vector<AVFrame*> pending;
+        std::vector<AVFrame*> free_frames;
+        PlaneStats totals[3];
+        QualitySummary summary;
+        double psnr_sum = 0.0;
+        uint64_t elapsed_ns = 0;
+    };
+}
@@ -0,0 +1,544 @@
+namespace UnsafeYT{
+    enum class Backend { OpenGL, CPU };
+    enum class RemapKernel { Scalar, SSE41, AVX2, NEON };
+
+    // Float: RG32F normalized deltas, sampled like the original shader.
+    // Index: the source tile of every cell as an integer, looked up with texelFetch.
+    enum class MapFormat { Float, Index };
+
+    // Closed form of the shader's `1 - c` on one channel: min(saturate(minuend - v) + bias, maximum).
+    // RGB and full-range luma use {255, 0}; limited-range luma maps 16..235 onto itself with
+    // {251, 0}; chroma reflects around 128 with {255, 1}. Deeper samples scale the terms with
+    // the depth and set maximum to the largest code (see yuv_inversion).
+    template <typename Sample>
+    struct BasicInversion {
+        Sample minuend = std::numeric_limits<Sample>::max();
+        Sample bias = 0;
+        Sample maximum = std::numeric_limits<Sample>::max();
+
+        Sample apply(Sample v) const {
+            int inverted = v > minuend ? 0 : minuend - v;
+            return static_cast<Sample>(std::min(inverted + bias, static_cast<int>(maximum)));
+        }
+    };
+    using Inversion = BasicInversion<uint8_t>;
+
+    // Per-pixel source lookup for one frame layout, precomputed from an offset map.
+    // index holds the byte offset of the (top-left) source texel of every output pixel.
+    // weight_x/weight_y are only filled when some samples fall between texels (tile edges
+    // that are not pixel aligned); they reproduce GL_LINEAR with 8-bit subtexel weights.
+    struct RemapPlan {
+        int width = 0;
+        int height = 0;
+        int bpp = 0;
+        int src_linesize = 0;
+        std::vector<int32_t> index;
+        std::vector<uint8_t> weight_x;
+        std::vector<uint8_t> weight_y;
+
+        bool exact() const { return weight_x.empty(); }
+    };
+
+    // Mirrors fragmentShaderSource: nearest lookup into the offset map at TexCoord, then a
+    // linear sample of the frame at TexCoord + offset, all in float like the GPU does.
+    RemapPlan build_remap_plan(const std::vector<float>& offset_map, int map_width, int map_height, int width, int height, int bpp, int src_linesize) {
+        if (offset_map.size() != static_cast<size_t>(map_width) * map_height * 2) {
+            throw std::runtime_error("Offset map size does not match its dimensions.");
+        }
+
+        RemapPlan plan;
+        plan.width = width;
+        plan.height = height;
+        plan.bpp = bpp;
+        plan.src_linesize = src_linesize;
+        plan.index.resize(static_cast<size_t>(width) * height);
+
+        std::vector<uint8_t> weight_x(plan.index.size());
+        std::vector<uint8_t> weight_y(plan.index.size());
+        bool exact = true;
+
+        auto snap = [](float texel, int size, int& base, uint8_t& weight) {
+            float floor_texel = std::floor(texel);
+            int w = static_cast<int>(std::lround((texel - floor_texel) * 256.0f));
+            base = static_cast<int>(floor_texel);
+            if (w == 256) {
+                base++;
+                w = 0;
+            }
+            if (base < 0) {
+                base = 0;
+                w = 0;
+            }
+            if (base >= size - 1) {
+                base = size - 1;
+                w = 0;
+            }
+            weight = static_cast<uint8_t>(w);
+        };
+
+        // The cell column and texture coordinate of every column, and the cell row of every
+        // row, are the same for the whole frame; only the offsets differ per cell.
+        std::vector<float> us(width);
+        std::vector<int> columns(width);
+        for (int x = 0; x < width; ++x) {
+            us[x] = (static_cast<float>(x) + 0.5f) / static_cast<float>(width);
+            columns[x] = std::min(std::max(static_cast<int>(std::floor(us[x] * map_width)), 0), map_width - 1);
+        }
+
+        for (int y = 0; y < height; ++y) {
+            float v = (static_cast<float>(y) + 0.5f) / static_cast<float>(height);
+            int my = std::min(std::max(static_cast<int>(std::floor(v * map_height)), 0), map_height - 1);
+            const float* row_cells = offset_map.data() + static_cast<size_t>(my) * map_width * 2;
+
+            int x = 0;
+            while (x < width) {
+                int mx = columns[x];
+                const float* cell = row_cells + static_cast<size_t>(mx) * 2;
+
+                // Rows of one cell share the vertical sample.
+                int sy;
+                uint8_t wy;
+                snap((v + cell[1]) * height - 0.5f, height, sy, wy);
+                int32_t row = sy * src_linesize;
+
+                for (; x < width && columns[x] == mx; ++x) {
+                    int sx;
+                    size_t i = static_cast<size_t>(y) * width + x;
+                    snap((us[x] + cell[0]) * width - 0.5f, width, sx, weight_x[i]);
+                    weight_y[i] = wy;
+                    exact = exact && weight_x[i] == 0 && wy == 0;
+                    plan.index[i] = row + sx * bpp;
+                }
+            }
+        }
+
+        if (!exact) {
+            plan.weight_x = std::move(weight_x);
+            plan.weight_y = std::move(weight_y);
+        }
+        return plan;
+    }
+
+    namespace detail {
+        // First pixel whose centre lies in tile `cell`, along an axis of `size` pixels split into
+        // `cells` tiles, so it agrees with tile_of(). Shifts between tile starts are
+        // antisymmetric, so when the tiles are whole pixels of equal size the unshuffle map
+        // undoes the shuffle map pixel for pixel; otherwise only tile edges are clamped.
+        inline int tile_start(int cell, int size, int cells) {
+            return static_cast<int>((2 * static_cast<int64_t>(cell) * size + cells - 1) / (2 * static_cast<int64_t>(cells)));
+        }
+
+        // Tile under the centre of pixel `p`, the cell a nearest lookup at TexCoord picks.
+        inline int tile_of(int p, int size, int cells) {
+            return static_cast<int>(((2 * static_cast<int64_t>(p) + 1) * cells) / (2 * static_cast<int64_t>(size)));
+        }
+    }
+
+    // Mirrors indexFragmentShaderSource: integer addressing only, so every output pixel copies
+    // exactly one source pixel and no float rounding can pick a neighbouring tile.
+    RemapPlan build_index_remap_plan(const std::vector<uint32_t>& tile_map, int map_width, int map_height, int width, int height, int bpp, int src_linesize) {
+        if (tile_map.size() != static_cast<size_t>(map_width) * map_height) {
+            throw std::runtime_error("Tile map size does not match its dimensions.");
+        }
+
+        RemapPlan plan;
+        plan.width = width;
+        plan.height = height;
+        plan.bpp = bpp;
+        plan.src_linesize = src_linesize;
+        plan.index.resize(static_cast<size_t>(width) * height);
+
+        // Cell and shift tables per column and per row, so the loop does no divisions.
+        std::vector<int> columns(width), xs(map_width), ys(map_height);
+        for (int x = 0; x < width; ++x) {
+            columns[x] = detail::tile_of(x, width, map_width);
+        }
+        for (int cx = 0; cx < map_width; ++cx) {
+            xs[cx] = detail::tile_start(cx, width, map_width);
+        }
+        for (int cy = 0; cy < map_height; ++cy) {
+            ys[cy] = detail::tile_start(cy, height, map_height);
+        }
+
+        for (int y = 0; y < height; ++y) {
+            int cy = detail::tile_of(y, height, map_height);
+            const uint32_t* row_sources = tile_map.data() + static_cast<size_t>(cy) * map_width;
+            int32_t* out = plan.index.data() + static_cast<size_t>(y) * width;
+            int x = 0;
+            while (x < width) {
+                int cx = columns[x];
+                uint32_t source = row_sources[cx];
+                int scx = static_cast<int>(source % map_width);
+                int scy = static_cast<int>(source / map_width);
+
+                // One source row and one horizontal shift for the pixels of this cell.
+                int sy = std::min(std::max(y + ys[scy] - ys[cy], 0), height - 1);
+                int32_t row = sy * src_linesize;
+                int shift = xs[scx] - xs[cx];
+                for (; x < width && columns[x] == cx; ++x) {
+                    int sx = std::min(std::max(x + shift, 0), width - 1);
+                    out[x] = row + sx * bpp;
+                }
+            }
+        }
+        return plan;
+    }
+
+    // Plan for whichever representation the run uses: the tile map when one is given.
+    RemapPlan build_map_plan(const std::vector<float>& offset_map, const std::vector<uint32_t>& tile_map, int map_width, int map_height, int width, int height, int bpp, int src_linesize) {
+        if (!tile_map.empty()) {
+            return build_index_remap_plan(tile_map, map_width, map_height, width, height, bpp, src_linesize);
+        }
+        return build_remap_plan(offset_map, map_width, map_height, width, height, bpp, src_linesize);
+    }
+
+    namespace detail {
+        // Kernels are specialized on the sample container (uint8_t, or uint16_t for depths
+        // above 8) and the channels stored per pixel of a plane: 1 for planar YUV, 2 for the
+        // interleaved chroma of nv12/p010, 3 for RGB24. Plans address bytes, so a plan for
+        // them is built with bpp = sizeof(Sample) * Channels.
+        template <typename Sample, int Channels>
+        inline void remap_row_scalar(const uint8_t* src, const int32_t* index, uint8_t* dst, int begin, int end, BasicInversion<Sample> inversion) {
+            Sample* out = reinterpret_cast<Sample*>(dst);
+            for (int x = begin; x < end; ++x) {
+                const Sample* s = reinterpret_cast<const Sample*>(src + index[x]);
+                for (int c = 0; c < Channels; ++c) {
+                    out[x * Channels + c] = inversion.apply(s[c]);
+                }
+            }
+        }
+
+        // 16-bit samples overflow the int products of the 8-bit path, so they accumulate in 64 bits.
+        // Samples stored high in their container (p010) are rounded back onto their own grid,
+        // whose step is the lowest set bit of inversion.maximum.
+        template <typename Sample, int Channels>
+        inline void remap_row_bilinear_scalar(const uint8_t* src, int src_linesize, const int32_t* index, const uint8_t* weight_x, const uint8_t* weight_y, uint8_t* dst, int begin, int end, BasicInversion<Sample> inversion) {
+            using Accum = typename std::conditional<sizeof(Sample) == 1, int, int64_t>::type;
+            const int padding = sizeof(Sample) == 1 ? 0 : __builtin_ctz(inversion.maximum);
+            Sample* out = reinterpret_cast<Sample*>(dst);
+            for (int x = begin; x < end; ++x) {
+                const Sample* s = reinterpret_cast<const Sample*>(src + index[x]);
+                int wx = weight_x[x];
+                int wy = weight_y[x];
+                for (int c = 0; c < Channels; ++c) {
+                    Accum top = Accum(s[c]) * (256 - wx) + (wx ? Accum(s[Channels + c]) * wx : 0);
+                    Accum bottom = top;
+                    if (wy) {
+                        const Sample* b = reinterpret_cast<const Sample*>(reinterpret_cast<const uint8_t*>(s) + src_linesize);
+                        bottom = Accum(b[c]) * (256 - wx) + (wx ? Accum(b[Channels + c]) * wx : 0);
+                    }
+                    Accum value = (top * (256 - wy) + bottom * wy + 32768) >> 16;
+                    if (padding) {
+                        value = ((value + (Accum(1) << (padding - 1))) >> padding) << padding;
+                    }
+                    out[x * Channels + c] = inversion.apply(static_cast<Sample>(value));
+                }
+            }
+        }
+
+    #if defined(__x86_64__) || defined(__i386__)
+        // Gathers pull 4 bytes per pixel and the shuffle keeps the first BPP of them. av_frame_get_buffer
+        // pads every plane, so reading up to 3 bytes past the last pixel is safe.
+        template <int BPP>
+        __attribute__((target("avx2")))
+        inline void store_pixels_avx2(uint8_t* d, __m256i pixels) {
+            if (BPP == 4) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(d), pixels);
+            } else if (BPP == 3) {
+                const __m256i pack = _mm256_setr_epi8(
+                    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+                );
+                pixels = _mm256_shuffle_epi8(pixels, pack);
+                pixels = _mm256_permutevar8x32_epi32(pixels, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm256_castsi256_si128(pixels));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(d + 16), _mm256_extracti128_si256(pixels, 1));
+            } else if (BPP == 2) {
+                const __m256i pack = _mm256_setr_epi8(
+                    0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+                    0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1
+                );
+                pixels = _mm256_shuffle_epi8(pixels, pack);
+                pixels = _mm256_permutevar8x32_epi32(pixels, _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm256_castsi256_si128(pixels));
+            } else {
+                const __m256i pack = _mm256_setr_epi8(
+                    0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                    0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+                );
+                pixels = _mm256_shuffle_epi8(pixels, pack);
+                pixels = _mm256_permutevar8x32_epi32(pixels, _mm256_setr_epi32(0, 4, 1, 2, 3, 5, 6, 7));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(d), _mm256_castsi256_si128(pixels));
+            }
+        }
+
+        // The inversion on every lane of a register, in the lane width of Sample. Only deeper
+        // samples need the clamp to maximum; 8-bit saturation already stops at 255.
+        template <typename Sample>
+        __attribute__((target("avx2")))
+        inline __m256i invert_avx2(__m256i pixels, BasicInversion<Sample> inversion) {
+            if constexpr (sizeof(Sample) == 1) {
+                const __m256i minuend = _mm256_set1_epi8(static_cast<char>(inversion.minuend));
+                const __m256i bias = _mm256_set1_epi8(static_cast<char>(inversion.bias));
+                return _mm256_adds_epu8(_mm256_subs_epu8(minuend, pixels), bias);
+            } else {
+                const __m256i minuend = _mm256_set1_epi16(static_cast<short>(inversion.minuend));
+                const __m256i bias = _mm256_set1_epi16(static_cast<short>(inversion.bias));
+                const __m256i maximum = _mm256_set1_epi16(static_cast<short>(inversion.maximum));
+                return _mm256_min_epu16(_mm256_adds_epu16(_mm256_subs_epu16(minuend, pixels), bias), maximum);
+            }
+        }
+
+        template <typename Sample, int Channels>
+        __attribute__((target("avx2")))
+        inline int remap_row_avx2(const uint8_t* src, const int32_t* index, uint8_t* dst, int width, BasicInversion<Sample> inversion) {
+            constexpr int BPP = static_cast<int>(sizeof(Sample)) * Channels;
+            int x = 0;
+            for (; x + 8 <= width; x += 8) {
+                __m256i offsets = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(index + x));
+                __m256i pixels = _mm256_i32gather_epi32(reinterpret_cast<const int*>(src), offsets, 1);
+                store_pixels_avx2<BPP>(dst + x * BPP, invert_avx2<Sample>(pixels, inversion));
+            }
+            return x;
+        }
+
+        // Bilinear variant for plans with fractional samples. Taps with a zero weight are
+        // redirected to the base texel so nothing outside the clamped frame is read.
+        template <int BPP>
+        __attribute__((target("avx2")))
+        inline int remap_row_bilinear_avx2(const uint8_t* src, int src_linesize, const int32_t* index, const uint8_t* weight_x, const uint8_t* weight_y, uint8_t* dst, int width, Inversion inversion) {
+            const __m256i full = _mm256_set1_epi32(256);
+            const __m256i round = _mm256_set1_epi32(32768);
+            const __m256i low_byte = _mm256_set1_epi32(0xFF);
+            const __m256i step_x = _mm256_set1_epi32(BPP);
+            const __m256i step_y = _mm256_set1_epi32(src_linesize);
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i minuend = _mm256_set1_epi8(static_cast<char>(inversion.minuend));
+            const __m256i bias = _mm256_set1_epi8(static_cast<char>(inversion.bias));
+            const int* base = reinterpret_cast<const int*>(src);
+
+            int x = 0;
+            for (; x + 8 <= width; x += 8) {
+                __m256i wx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(weight_x + x)));
+                __m256i wy = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(weight_y + x)));
+                __m256i i00 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(index + x));
+                __m256i dx = _mm256_andnot_si256(_mm256_cmpeq_epi32(wx, zero), step_x);
+                __m256i dy = _mm256_andnot_si256(_mm256_cmpeq_epi32(wy, zero), step_y);
+                __m256i i01 = _mm256_add_epi32(i00, dx);
+                __m256i i10 = _mm256_add_epi32(i00, dy);
+                __m256i i11 = _mm256_add_epi32(i10, dx);
+
+                __m256i p00 = _mm256_i32gather_epi32(base, i00, 1);
+                __m256i p01 = _mm256_i32gather_epi32(base, i01, 1);
+                __m256i p10 = _mm256_i32gather_epi32(base, i10, 1);
+                __m256i p11 = _mm256_i32gather_epi32(base, i11, 1);
+
+                __m256i iwx = _mm256_sub_epi32(full, wx);
+                __m256i iwy = _mm256_sub_epi32(full, wy);
+                __m256i pixels = zero;
+                for (int c = 0; c < BPP; ++c) {
+                    const __m128i shift = _mm_cvtsi32_si128(c * 8);
+                    __m256i c00 = _mm256_and_si256(_mm256_srl_epi32(p00, shift), low_byte);
+                    __m256i c01 = _mm256_and_si256(_mm256_srl_epi32(p01, shift), low_byte);
+                    __m256i c10 = _mm256_and_si256(_mm256_srl_epi32(p10, shift), low_byte);
+                    __m256i c11 = _mm256_and_si256(_mm256_srl_epi32(p11, shift), low_byte);
+
+                    __m256i top = _mm256_add_epi32(_mm256_mullo_epi32(c00, iwx), _mm256_mullo_epi32(c01, wx));
+                    __m256i bottom = _mm256_add_epi32(_mm256_mullo_epi32(c10, iwx), _mm256_mullo_epi32(c11, wx));
+                    __m256i value = _mm256_add_epi32(_mm256_mullo_epi32(top, iwy), _mm256_mullo_epi32(bottom, wy));
+                    value = _mm256_srli_epi32(_mm256_add_epi32(value, round), 16);
+                    pixels = _mm256_or_si256(pixels, _mm256_sll_epi32(value, shift));
+                }
+
+                pixels = _mm256_adds_epu8(_mm256_subs_epu8(minuend, pixels), bias);
+                store_pixels_avx2<BPP>(dst + x * BPP, pixels);
+            }
+            return x;
+        }
+
+        template <typename Sample, int Channels>
+        __attribute__((target("sse4.1")))
+        inline int remap_row_sse41(const uint8_t* src, const int32_t* index, uint8_t* dst, int width, BasicInversion<Sample> inversion) {
+            constexpr int BPP = static_cast<int>(sizeof(Sample)) * Channels;
+            const __m128i pack = BPP == 3 ? _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1)
+                               : BPP == 2 ? _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1)
+                               : _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+            int x = 0;
+            for (; x + 4 <= width; x += 4) {
+                int32_t p[4];
+                std::memcpy(&p[0], src + index[x], 4);
+                std::memcpy(&p[1], src + index[x + 1], 4);
+                std::memcpy(&p[2], src + index[x + 2], 4);
+                std::memcpy(&p[3], src + index[x + 3], 4);
+
+                __m128i pixels = _mm_setr_epi32(p[0], p[1], p[2], p[3]);
+                if constexpr (sizeof(Sample) == 1) {
+                    const __m128i minuend = _mm_set1_epi8(static_cast<char>(inversion.minuend));
+                    const __m128i bias = _mm_set1_epi8(static_cast<char>(inversion.bias));
+                    pixels = _mm_adds_epu8(_mm_subs_epu8(minuend, pixels), bias);
+                } else {
+                    const __m128i minuend = _mm_set1_epi16(static_cast<short>(inversion.minuend));
+                    const __m128i bias = _mm_set1_epi16(static_cast<short>(inversion.bias));
+                    const __m128i maximum = _mm_set1_epi16(static_cast<short>(inversion.maximum));
+                    pixels = _mm_min_epu16(_mm_adds_epu16(_mm_subs_epu16(minuend, pixels), bias), maximum);
+                }
+
+                uint8_t* d = dst + x * BPP;
+                if (BPP == 4) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d), pixels);
+                    continue;
+                }
+                pixels = _mm_shuffle_epi8(pixels, pack);
+                if (BPP == 3) {
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(d), pixels);
+                    int32_t tail = _mm_extract_epi32(pixels, 2);
+                    std::memcpy(d + 8, &tail, 4);
+                } else if (BPP == 2) {
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(d), pixels);
+                } else {
+                    int32_t packed = _mm_cvtsi128_si32(pixels);
+                    std::memcpy(d, &packed, 4);
+                }
+            }
+            return x;
+        }
+    #endif
+
+    #if defined(__aarch64__)
+        template <typename Sample, int Channels>
+        inline int remap_row_neon(const uint8_t* src, const int32_t* index, uint8_t* dst, int width, BasicInversion<Sample> inversion) {
+            constexpr int BPP = static_cast<int>(sizeof(Sample)) * Channels;
+            static const uint8_t pack3[16] = {0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 255, 255, 255, 255};
+            static const uint8_t pack2[16] = {0, 1, 4, 5, 8, 9, 12, 13, 255, 255, 255, 255, 255, 255, 255, 255};
+            static const uint8_t pack1[16] = {0, 4, 8, 12, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255};
+            const uint8x16_t pack = vld1q_u8(BPP == 3 ? pack3 : BPP == 2 ? pack2 : pack1);
+
+            int x = 0;
+            for (; x + 4 <= width; x += 4) {
+                uint32x4_t gathered = vdupq_n_u32(0);
+                uint32_t p;
+                std::memcpy(&p, src + index[x], 4);
+                gathered = vsetq_lane_u32(p, gathered, 0);
+                std::memcpy(&p, src + index[x + 1], 4);
+                gathered = vsetq_lane_u32(p, gathered, 1);
+                std::memcpy(&p, src + index[x + 2], 4);
+                gathered = vsetq_lane_u32(p, gathered, 2);
+                std::memcpy(&p, src + index[x + 3], 4);
+                gathered = vsetq_lane_u32(p, gathered, 3);
+
+                uint8x16_t pixels;
+                if constexpr (sizeof(Sample) == 1) {
+                    pixels = vqaddq_u8(vqsubq_u8(vdupq_n_u8(inversion.minuend), vreinterpretq_u8_u32(gathered)), vdupq_n_u8(inversion.bias));
+                } else {
+                    uint16x8_t inverted = vqsubq_u16(vdupq_n_u16(inversion.minuend), vreinterpretq_u16_u32(gathered));
+                    inverted = vminq_u16(vqaddq_u16(inverted, vdupq_n_u16(inversion.bias)), vdupq_n_u16(inversion.maximum));
+                    pixels = vreinterpretq_u8_u16(inverted);
+                }
+
+                uint8_t* d = dst + x * BPP;
+                if (BPP == 4) {
+                    vst1q_u8(d, pixels);
+                    continue;
+                }
+                pixels = vqtbl1q_u8(pixels, pack);
+                if (BPP == 3) {
+                    vst1_u8(d, vget_low_u8(pixels));
+                    vst1q_lane_u32(reinterpret_cast<uint32_t*>(d + 8), vreinterpretq_u32_u8(pixels), 2);
+                } else if (BPP == 2) {
+                    vst1_u8(d, vget_low_u8(pixels));
+                } else {
+                    vst1q_lane_u32(reinterpret_cast<uint32_t*>(d), vreinterpretq_u32_u8(pixels), 0);
+                }
+            }
+            return x;
+        }
+    #endif
+
+        template <typename Sample, int Channels>
+        void remap_plane(const RemapPlan& plan, RemapKernel kernel, BasicInversion<Sample> inversion, const uint8_t* src, uint8_t* dst, int dst_linesize) {
+            for (int y = 0; y < plan.height; ++y) {
+                size_t row = static_cast<size_t>(y) * plan.width;
+                const int32_t* row_index = plan.index.data() + row;
+                uint8_t* row_dst = dst + static_cast<size_t>(y) * dst_linesize;
+
+                int done = 0;
+                if (!plan.exact()) {
+                    const uint8_t* row_wx = plan.weight_x.data() + row;
+                    const uint8_t* row_wy = plan.weight_y.data() + row;
+                #if defined(__x86_64__) || defined(__i386__)
+                    if constexpr (sizeof(Sample) == 1) {
+                        if (kernel == RemapKernel::AVX2) {
+                            done = remap_row_bilinear_avx2<Channels>(src, plan.src_linesize, row_index, row_wx, row_wy, row_dst, plan.width, inversion);
+                        }
+                    }
+                #endif
+                    remap_row_bilinear_scalar<Sample, Channels>(src, plan.src_linesize, row_index, row_wx, row_wy, row_dst, done, plan.width, inversion);
+                    continue;
+                }
+
+                switch (kernel) {
+                #if defined(__x86_64__) || defined(__i386__)
+                    case RemapKernel::AVX2: done = remap_row_avx2<Sample, Channels>(src, row_index, row_dst, plan.width, inversion); break;
+                    case RemapKernel::SSE41: done = remap_row_sse41<Sample, Channels>(src, row_index, row_dst, plan.width, inversion); break;
+                #endif
+                #if defined(__aarch64__)
+                    case RemapKernel::NEON: done = remap_row_neon<Sample, Channels>(src, row_index, row_dst, plan.width, inversion); break;
+                #endif
+                    default: break;
+                }
+                remap_row_scalar<Sample, Channels>(src, row_index, row_dst, done, plan.width, inversion);
+            }
+        }
+    }
+
+    RemapKernel detect_remap_kernel() {
+    #if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return RemapKernel::AVX2;
+        if (__builtin_cpu_supports("sse4.1")) return RemapKernel::SSE41;
+    #elif defined(__aarch64__)
+        return RemapKernel::NEON;
+    #endif
+        return RemapKernel::Scalar;
+    }
+
+    const char* remap_kernel_name(RemapKernel kernel) {
+        switch (kernel) {
+            case RemapKernel::AVX2: return "avx2";
+            case RemapKernel::SSE41: return "sse4.1";
+            case RemapKernel::NEON: return "neon";
+            default: return "scalar";
+        }
+    }
+
+    // Remaps one 8-bit plane laid out as described by plan. src must use plan.src_linesize.
+    void remap_plane(const RemapPlan& plan, RemapKernel kernel, Inversion inversion, const uint8_t* src, uint8_t* dst, int dst_linesize) {
+        switch (plan.bpp) {
+            case 1: detail::remap_plane<uint8_t, 1>(plan, kernel, inversion, src, dst, dst_linesize); break;
+            case 3: detail::remap_plane<uint8_t, 3>(plan, kernel, inversion, src, dst, dst_linesize); break;
+            default: throw std::runtime_error("Unsupported bytes per pixel for CPU remap.");
+        }
+    }
+
+    // CPU counterpart of the GL draw + glReadPixels block: applies the offset map and the
+    // `1 - rgb` inversion to a packed RGB24 frame.
+    class CpuRemapper {
+    public:
+        CpuRemapper() : kernel(detect_remap_kernel()) {}
+
+        void Prepare(const std::vector<float>& offset_map, const std::vector<uint32_t>& tile_map, int map_width, int map_height, int width, int height, int src_linesize) {
+            this->plan = build_map_plan(offset_map, tile_map, map_width, map_height, width, height, 3, src_linesize);
+        }
+
+        void Apply(const AVFrame* src, AVFrame* dst) const {
+            if (src->linesize[0] != plan.src_linesize) {
+                throw std::runtime_error("Source frame stride does not match the prepared remap plan.");
+            }
+            remap_plane(plan, kernel, Inversion{}, src->data[0], dst->data[0], dst->linesize[0]);
+        }
+
+        RemapKernel kernel;
+        RemapPlan plan;
+    };
+}
\ No newline at end of file
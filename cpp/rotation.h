@@ -0,0 +1,243 @@
+namespace UnsafeYT{
+    // Every N frames, or at every keyframe of the input.
+    enum class RotationMode { Off, Frames, Keyframes };
+
+    // Seed of the map for rotation period `index`. The first period uses the seed itself, so a
+    // rotated run starts with the map of an unrotated one.
+    inline std::string rotation_seed(const std::string& seed, long index) {
+        return index == 0 ? seed : seed + "#" + std::to_string(index);
+    }
+
+    // One permutation of a rotating run, with whatever the transform path builds from it.
+    // Only the remapper of the path in use is prepared.
+    struct RotatedMap {
+        long index = 0;
+        std::vector<float> offset_map;
+        std::vector<uint32_t> tile_map;
+        CpuRemapper cpu_remapper;
+        PlanarRemapper planar_remapper;
+        TiledRemapper tiled_remapper;
+    };
+
+    // Builds the maps of a rotating run on a background thread, several periods ahead of the
+    // one in use, so a rotation only swaps a pointer. Get() waits only when the thread has fallen
+    // behind; those waits are counted as stalls. Indices only ever grow, and maps behind the
+    // requested one are dropped, which keeps at most Depth() maps alive.
+    //
+    // The depth adapts to the run. It starts at `ahead` and grows with the average build time
+    // measured against the rotation period, so every map is finished a full period before it is
+    // needed. Build times are wall-clock, so they include any share of the CPU the thread lost
+    // to a busy frame loop. The depth stops at MAX_AHEAD (or `ahead`, if larger), which bounds
+    // the memory the built maps hold; a builder slower than one map per period cannot keep up
+    // at any depth, and shows as stalls. The thread runs at normal priority: below that, a
+    // saturated worker pool would starve it until Get() blocked on every rotation.
+    //
+    // The prepare callback runs on the background thread and must only touch the map it is
+    // given and state that stays fixed while the rotation runs.
+    class MapRotation {
+    public:
+        using Prepare = std::function<void(RotatedMap&)>;
+
+        static constexpr int MAX_AHEAD = 16;
+
+        MapRotation() = default;
+        MapRotation(const MapRotation&) = delete;
+        MapRotation& operator=(const MapRotation&) = delete;
+        ~MapRotation() { this->Stop(); }
+
+        void Start(const std::string& seed, MapDirection direction, int map_width, int map_height, bool index_format,
+                   long first_index, int ahead, Prepare prepare) {
+            this->Stop();
+            this->seed = seed;
+            this->direction = direction;
+            this->map_width = map_width;
+            this->map_height = map_height;
+            this->index_format = index_format;
+            this->ahead = std::max(ahead, 1);
+            this->prepare = std::move(prepare);
+            this->wanted = first_index;
+            this->next = first_index;
+            this->ready.clear();
+            this->error.clear();
+            this->stopping = false;
+            this->gets = 0;
+            this->stalls = 0;
+            this->stall_ms = 0.0;
+            this->builds = 0;
+            this->build_ms = 0.0;
+            this->period_ms = 0.0;
+            this->deepest = this->ahead;
+            this->boundaries.clear();
+            this->thread = std::thread([this]() { this->Run(); });
+        }
+
+        void Stop() {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->stopping = true;
+            }
+            this->changed.notify_all();
+            if (this->thread.joinable()) this->thread.join();
+            this->ready.clear();
+        }
+
+        bool Running() const { return this->thread.joinable(); }
+
+        // Map of period `index`; throws if it could not be built.
+        std::shared_ptr<const RotatedMap> Get(long index) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            auto now = std::chrono::steady_clock::now();
+            if (this->gets > 0 && index > this->wanted) {
+                double period = std::chrono::duration<double, std::milli>(now - this->rotated_at).count() / (index - this->wanted);
+                this->period_ms = this->period_ms > 0.0 ? 0.75 * this->period_ms + 0.25 * period : period;
+            }
+            if (this->gets == 0 || index > this->wanted) {
+                this->rotated_at = now;
+            }
+            this->wanted = std::max(this->wanted, index);
+            this->deepest = std::max(this->deepest, this->Depth());
+            while (!this->ready.empty() && this->ready.front()->index < index) {
+                this->ready.pop_front();
+            }
+            this->changed.notify_all();
+
+            bool first = this->gets++ == 0;
+            auto found = [&]() { return !this->error.empty() || (!this->ready.empty() && this->ready.front()->index == index); };
+            if (!found()) {
+                auto started = std::chrono::steady_clock::now();
+                this->changed.wait(lock, found);
+                if (!first) {
+                    this->stalls++;
+                    this->stall_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+                }
+            }
+            if (!this->error.empty()) {
+                throw std::runtime_error(this->error);
+            }
+            return this->ready.front();
+        }
+
+        // Frame numbers at which a new map starts, for the encoder to begin a GOP there. The
+        // encoder runs on its own thread, so these go through the lock as well.
+        void MarkBoundary(long frame) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->boundaries.push_back(frame);
+        }
+
+        bool TakeBoundary(long frame) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            while (!this->boundaries.empty() && this->boundaries.front() < frame) {
+                this->boundaries.pop_front();
+            }
+            if (this->boundaries.empty() || this->boundaries.front() != frame) return false;
+            this->boundaries.pop_front();
+            return true;
+        }
+
+        // Waits in Get() for a map that was not built yet, not counting the first one.
+        long Stalls() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->stalls;
+        }
+
+        double StallMs() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->stall_ms;
+        }
+
+        // Maps built so far and the time the background thread spent on them.
+        long Builds() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->builds;
+        }
+
+        double BuildMs() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->build_ms;
+        }
+
+        // The most maps the run kept built ahead.
+        int Deepest() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->deepest;
+        }
+
+    private:
+        // Maps to keep built from the one in use on. Map i + depth - 1 is queued as period i
+        // begins and needed depth - 1 periods later, so it is ready a period early if it builds
+        // within depth - 2 periods. Called under the lock.
+        int Depth() const {
+            if (this->builds == 0 || this->period_ms <= 0.0) return this->ahead;
+            int needed = static_cast<int>(std::ceil(this->build_ms / this->builds / this->period_ms)) + 2;
+            return std::min(std::max(this->ahead, needed), std::max(this->ahead, MAX_AHEAD));
+        }
+
+        void Run() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while (true) {
+                this->changed.wait(lock, [&]() { return this->stopping || this->next < this->wanted + this->Depth(); });
+                if (this->stopping) return;
+                long index = std::max(this->next, this->wanted);
+                lock.unlock();
+
+                auto started = std::chrono::steady_clock::now();
+                auto map = std::make_shared<RotatedMap>();
+                std::string failure;
+                try {
+                    map->index = index;
+                    // One thread: the frame loop owns the rest of the machine.
+                    map->offset_map = generate_offset_map(this->map_width, this->map_height, rotation_seed(this->seed, index), this->direction, 1);
+                    if (this->index_format) {
+                        map->tile_map = offsets_to_tile_map(map->offset_map, this->map_width, this->map_height);
+                    }
+                    if (this->prepare) this->prepare(*map);
+                }
+                catch (const std::exception& e) {
+                    failure = e.what();
+                }
+
+                lock.lock();
+                this->builds++;
+                this->build_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+                if (!failure.empty()) {
+                    this->error = "Map for rotation " + std::to_string(index) + ": " + failure;
+                    this->changed.notify_all();
+                    return;
+                }
+                // A map the frame loop has already moved past is not kept.
+                if (index >= this->wanted) {
+                    this->ready.push_back(std::move(map));
+                }
+                this->next = index + 1;
+                this->changed.notify_all();
+            }
+        }
+
+        std::string seed;
+        MapDirection direction = MapDirection::Shuffle;
+        int map_width = 0;
+        int map_height = 0;
+        bool index_format = false;
+        int ahead = 1;
+        Prepare prepare;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::thread thread;
+        std::deque<std::shared_ptr<const RotatedMap>> ready;
+        std::deque<long> boundaries;
+        std::string error;
+        long wanted = 0;
+        long next = 0;
+        bool stopping = false;
+        long gets = 0;
+        long stalls = 0;
+        double stall_ms = 0.0;
+        long builds = 0;
+        double build_ms = 0.0;
+        // Smoothed wall time of one rotation period, measured between calls to Get().
+        double period_ms = 0.0;
+        std::chrono::steady_clock::time_point rotated_at;
+        int deepest = 1;
+    };
+}
@@ -0,0 +1,712 @@
+namespace UnsafeYT{
+    // Splits one input at keyframes into segments that are decoded, transformed and encoded
+    // at the same time by independent Videos, each with its own codec contexts, then copies
+    // their packets into one output in order.
+    //
+    // Every segment starts on a keyframe, so it decodes on its own, and numbers its frames
+    // from its first frame's index in the whole input, so the joined packets carry the
+    // timestamps a serial run gives them. The only difference from a serial run is that
+    // each encoder starts a new GOP at its segment start. Encoders with B-frames delay
+    // their DTS by the same number of frames in every segment, so DTS keep increasing
+    // across the joins.
+    //
+    // Segments are spooled to NUT files next to the output (in the temp directory when the
+    // output is a pipe), which keep the encoder's time base and extradata as they are.
+    // Their timestamps are shifted by PTS_MARGIN frames so that no DTS is negative and NUT
+    // has nothing to shift.
+    //
+    // With checkpoint_seconds > 0 the same parts make a long run resumable instead. The input
+    // is cut at the keyframes nearest every checkpoint_seconds of it, and the parts are encoded
+    // one after another, each by a fresh encoder, so every part begins with an encoder
+    // keyframe. Each part is copied into the output as soon as it is encoded, its spool file
+    // is deleted, and the output is flushed (see FlushOutput) before a checkpoint next to it
+    // (see CheckpointPath) records the parts done, the frame count, the output size, the input
+    // position of the next part and a hash of everything that decides the output. So at most
+    // one part is on disk twice, and the output is readable up to the last checkpoint. A run
+    // with `resume` set skips the parts a matching checkpoint holds, copies their frames out of
+    // the interrupted output (see Recover) and starts decoding at the next part's keyframe, so
+    // a crash costs at most the part that was in progress. The checkpoint is kept until the
+    // output is complete.
+    class SegmentRunner {
+    public:
+        using Factory = std::function<std::unique_ptr<Video>()>;
+
+        struct Segment {
+            int64_t start = AV_NOPTS_VALUE;
+            int64_t end = AV_NOPTS_VALUE;
+            long first_frame = 0;
+            std::string path;
+            bool done = false;
+            int result = -1;
+            long frames = 0;
+        };
+
+        static constexpr long PTS_MARGIN = 64;
+        static constexpr int CHECKPOINT_VERSION = 2;
+
+        double checkpoint_seconds = 0.0;
+        bool resume = false;
+
+        SegmentRunner(Factory factory, int count) : factory(std::move(factory)), count(std::max(count, 1)) {}
+
+        ~SegmentRunner() {
+            this->CloseOutput();
+        }
+
+        int Run() {
+            this->config = this->factory();
+            Video& config = *this->config;
+            bool checkpointed = this->checkpoint_seconds > 0.0;
+            if (PipeIO::IsPipe(config.inpath)) {
+                std::cerr << "Error: " << (checkpointed ? "Checkpointed" : "Segment-parallel") << " processing needs a seekable input file, not a pipe." << std::endl;
+                return -1;
+            }
+            if (checkpointed && PipeIO::IsPipe(config.outpath)) {
+                std::cerr << "Error: Checkpoints are kept next to the output; checkpointed processing needs an output file, not a pipe." << std::endl;
+                return -1;
+            }
+
+            if (this->Index(config.inpath) != 0) {
+                return -1;
+            }
+            std::vector<size_t> targets;
+            size_t frames = this->timestamps.size();
+            if (checkpointed) {
+                size_t interval = static_cast<size_t>(std::max(std::lround(this->checkpoint_seconds * this->fps), 1L));
+                for (size_t target = interval; target < frames; target += interval) targets.push_back(target);
+            } else {
+                for (int i = 1; i < this->count; i++) targets.push_back(frames * i / this->count);
+            }
+            this->Split(targets);
+            if (this->segments.size() < 2) {
+                std::cout << "Info: The input " << (checkpointed ? "is shorter than one checkpoint interval or has too few keyframes" : "has too few keyframes to split")
+                          << "; processing it in one piece." << std::endl;
+                int result = config.Start();
+                if (result != 0) config.telemetry.Done(false, config.frameCount);
+                return result;
+            }
+
+            std::filesystem::path base = PipeIO::IsPipe(config.outpath)
+                ? std::filesystem::temp_directory_path() / ("unsafeyt-" + std::to_string(reinterpret_cast<uintptr_t>(this)))
+                : std::filesystem::path(config.outpath);
+            for (size_t i = 0; i < this->segments.size(); i++) {
+                this->segments[i].path = base.string() + (checkpointed ? ".part" : ".segment") + std::to_string(i) + ".nut";
+            }
+            if (checkpointed) {
+                if (this->LoadCheckpoint() != 0) {
+                    return -1;
+                }
+                std::cout << "Processing " << this->segments.size() << " checkpointed parts of about " << this->checkpoint_seconds
+                          << " s (" << this->timestamps.size() << " frames)" << std::endl;
+            } else {
+                std::cout << "Processing " << this->segments.size() << " segments in parallel (" << this->timestamps.size() << " frames)" << std::endl;
+            }
+
+            auto started = std::chrono::steady_clock::now();
+            config.telemetry.Start(static_cast<long>(this->timestamps.size()), this->fps, this->width, this->height);
+            int result = 0;
+            if (checkpointed) {
+                result = this->RunParts();
+                if (result == 0) result = this->Finish();
+            } else {
+                std::vector<std::thread> threads;
+                for (size_t i = 0; i < this->segments.size(); i++) {
+                    threads.emplace_back([this, i]() { this->Work(i); });
+                }
+                result = this->Mux();
+                for (std::thread& thread : threads) {
+                    thread.join();
+                }
+            }
+
+            // A failed checkpointed run keeps its output and checkpoint for --resume.
+            std::error_code ignored;
+            for (const Segment& segment : this->segments) {
+                std::filesystem::remove(segment.path, ignored);
+            }
+            if (checkpointed && result == 0) {
+                std::filesystem::remove(this->CheckpointPath(), ignored);
+                std::filesystem::remove(this->ResumePath(), ignored);
+            }
+
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            if (result == 0) {
+                std::cout << "Finished processing. Total frames written: " << this->muxed << std::endl;
+                if (elapsed > 0.0) {
+                    std::cout << "Processing time: " << elapsed << " s (" << this->muxed / elapsed << " fps)" << std::endl;
+                }
+            }
+            if (config.telemetry.enabled) {
+                config.telemetry.Done(result == 0, this->muxed);
+            } else if (result == 0) {
+                std::cout << 100 << std::endl;
+            }
+            return result;
+        }
+
+    private:
+        // Demuxes the whole video stream once, without decoding, for the timestamps of all
+        // frames and of the keyframes. Any frame without a timestamp rules splitting out.
+        int Index(const std::string& path) {
+            AVFormatContext* fmt = nullptr;
+            if (avformat_open_input(&fmt, path.c_str(), NULL, NULL) != 0 || avformat_find_stream_info(fmt, NULL) < 0) {
+                std::cerr << "Error: Could not open input video file with FFmpeg." << std::endl;
+                if (fmt) avformat_close_input(&fmt);
+                return -1;
+            }
+            int stream = -1;
+            for (unsigned int i = 0; i < fmt->nb_streams; i++) {
+                if (stream < 0 && fmt->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+                    stream = static_cast<int>(i);
+                } else {
+                    fmt->streams[i]->discard = AVDISCARD_ALL;
+                }
+            }
+            if (stream < 0) {
+                std::cerr << "Error: Could not find a video stream in the input file." << std::endl;
+                avformat_close_input(&fmt);
+                return -1;
+            }
+            this->fps = av_q2d(fmt->streams[stream]->avg_frame_rate);
+            this->width = fmt->streams[stream]->codecpar->width;
+            this->height = fmt->streams[stream]->codecpar->height;
+
+            bool complete = true;
+            AVPacket* packet = av_packet_alloc();
+            while (packet && av_read_frame(fmt, packet) >= 0) {
+                if (packet->stream_index == stream) {
+                    if (packet->pts == AV_NOPTS_VALUE) {
+                        complete = false;
+                    } else {
+                        this->timestamps.push_back(packet->pts);
+                        if (packet->flags & AV_PKT_FLAG_KEY) this->keyframes.push_back(packet->pts);
+                    }
+                }
+                av_packet_unref(packet);
+            }
+            av_packet_free(&packet);
+            avformat_close_input(&fmt);
+
+            if (!complete) {
+                std::cerr << "Warning: The input has frames without timestamps; it cannot be split." << std::endl;
+                this->keyframes.clear();
+            }
+            std::sort(this->timestamps.begin(), this->timestamps.end());
+            std::sort(this->keyframes.begin(), this->keyframes.end());
+            return 0;
+        }
+
+        // Cuts at the keyframes nearest to the frames at `targets`, in increasing order.
+        void Split(const std::vector<size_t>& targets) {
+            this->segments.assign(1, Segment{});
+            for (size_t i = 0; i < targets.size() && !this->keyframes.empty(); i++) {
+                int64_t target = this->timestamps[targets[i]];
+                auto next = std::lower_bound(this->keyframes.begin(), this->keyframes.end(), target);
+                if (next == this->keyframes.end() || (next != this->keyframes.begin() && target - *(next - 1) < *next - target)) {
+                    --next;
+                }
+                int64_t cut = *next;
+                Segment& previous = this->segments.back();
+                if (cut <= this->timestamps.front() || (previous.start != AV_NOPTS_VALUE && cut <= previous.start)) {
+                    continue;
+                }
+                previous.end = cut;
+                Segment segment;
+                segment.start = cut;
+                segment.first_frame = static_cast<long>(std::lower_bound(this->timestamps.begin(), this->timestamps.end(), cut) - this->timestamps.begin());
+                this->segments.push_back(segment);
+            }
+        }
+
+        // Each segment's Video lives and dies on its own thread, which owns its GL context;
+        // only EGL contexts can be made off the main thread. Checkpointed parts run one at a
+        // time on the calling thread instead (worker false), so any context does for them, and
+        // report progress from the encoder as they go.
+        void Work(size_t index, bool worker = true) {
+            Segment& segment = this->segments[index];
+            int result = -1;
+            long frames = 0;
+            {
+                std::unique_ptr<Video> video = this->factory();
+                video->outpath = segment.path;
+                video->output_format = "nut";
+                video->fragment_ms = 0;
+                video->segment_start = segment.start;
+                video->segment_end = segment.end;
+                video->first_frame = segment.first_frame;
+                video->pts_offset = PTS_MARGIN;
+                video->with_audio = false;
+                video->global_header = this->NeedsGlobalHeader();
+                video->report_progress = false;
+                video->telemetry.enabled = false;
+                video->encoded = &this->encoded;
+                if (worker && video->context_backend == ContextBackend::Auto) {
+                    video->context_backend = ContextBackend::EGL;
+                }
+                if (!worker) {
+                    video->on_encoded = [this]() {
+                        auto now = std::chrono::steady_clock::now();
+                        if (now - this->last_report < std::chrono::milliseconds(250)) return;
+                        this->last_report = now;
+                        this->ReportProgress();
+                    };
+                }
+                // Parallel segments already use the cores; without explicit counts every codec
+                // gets its share of them instead of all of them. Checkpointed parts run alone.
+                if (this->checkpoint_seconds <= 0.0) {
+                    int share = std::max(static_cast<int>(std::thread::hardware_concurrency()) / static_cast<int>(this->segments.size()), 1);
+                    if (video->encoder_profile.encoder_threads == 0) video->encoder_profile.encoder_threads = share;
+                    if (video->encoder_profile.decoder_threads == 0) video->encoder_profile.decoder_threads = share;
+                }
+
+                result = video->Start();
+                frames = video->frameCount;
+            }
+            std::lock_guard<std::mutex> lock(this->mutex);
+            segment.result = result;
+            segment.frames = frames;
+            segment.done = true;
+            this->finished.notify_all();
+        }
+
+        // Encodes the parts a checkpoint does not already hold, one at a time, copies each into
+        // the output and checkpoints it.
+        int RunParts() {
+            AVPacket* packet = av_packet_alloc();
+            if (!packet) {
+                std::cerr << "Error: Failed to allocate packet." << std::endl;
+                return -1;
+            }
+            size_t resumed = 0;
+            while (resumed < this->segments.size() && this->segments[resumed].done) resumed++;
+            int result = resumed > 0 ? this->Recover(resumed - 1, packet) : 0;
+            for (size_t i = resumed; i < this->segments.size() && result == 0; i++) {
+                this->Work(i, false);
+                if (this->segments[i].result != 0) {
+                    std::cerr << "Error: Part " << i << " failed; run again with --resume to continue from the last checkpoint." << std::endl;
+                    result = -1;
+                    break;
+                }
+                result = this->MuxSegment(i, packet);
+                if (result == 0 && !this->FlushOutput()) {
+                    std::cerr << "Error: Could not write part " << i << " to the output." << std::endl;
+                    result = -1;
+                }
+                if (result == 0 && !this->WriteCheckpoint(i)) {
+                    std::cerr << "Warning: Could not write the checkpoint after part " << i << "." << std::endl;
+                }
+            }
+            av_packet_free(&packet);
+            return result;
+        }
+
+        // Copies the frames of parts 0..last from the interrupted run's output into a new one,
+        // as muxers cannot append to a file they did not write. The old output is moved aside
+        // first and deleted once a checkpoint describes the new one, so a crash in between
+        // leaves something to resume from. Only resumed runs write those frames a second time.
+        int Recover(size_t last, AVPacket* packet) {
+            std::filesystem::path previous = this->ResumePath();
+            std::error_code error;
+            if (!std::filesystem::exists(previous, error)) {
+                std::filesystem::rename(this->config->outpath, previous, error);
+                if (error) {
+                    std::cerr << "Error: Could not move the interrupted output aside: " << error.message() << std::endl;
+                    return -1;
+                }
+            }
+            long frames = this->encoded.load(std::memory_order_relaxed);
+            int result = this->Copy(previous.string(), "interrupted output", false, frames, packet);
+            if (result == 0 && this->muxed != frames) {
+                std::cerr << "Error: The interrupted output holds " << this->muxed << " of the " << frames
+                          << " frames its checkpoint lists; run without --resume to start over." << std::endl;
+                result = -1;
+            }
+            if (result == 0 && !this->FlushOutput()) {
+                std::cerr << "Error: Could not write the resumed frames to the output." << std::endl;
+                result = -1;
+            }
+            if (result == 0 && this->WriteCheckpoint(last)) {
+                std::filesystem::remove(previous, error);
+            }
+            return result;
+        }
+
+        // Writes out everything muxed so far, closing the fragment in fragmented MP4, so the
+        // output file holds every part a checkpoint written afterwards lists.
+        bool FlushOutput() {
+            if (av_interleaved_write_frame(this->out_fmt_ctx, NULL) < 0) return false;
+            if ((this->out_fmt_ctx->oformat->flags & AVFMT_ALLOW_FLUSH) && av_write_frame(this->out_fmt_ctx, NULL) < 0) return false;
+            avio_flush(this->out_fmt_ctx->pb);
+            return this->out_fmt_ctx->pb->error == 0;
+        }
+
+        std::filesystem::path CheckpointPath() const {
+            return std::filesystem::path(this->config->outpath + ".checkpoint.json");
+        }
+
+        // Where a resumed run moves the interrupted output while it copies from it.
+        std::filesystem::path ResumePath() const {
+            return std::filesystem::path(this->config->outpath + ".resume");
+        }
+
+        // Hash of everything a resumed run must share with the interrupted one for its parts to
+        // join seamlessly: the input file, the transform and map settings, the encoder profile
+        // and the cut points.
+        std::string ConfigKey() const {
+            const Video& config = *this->config;
+            const EncoderProfile& profile = config.encoder_profile;
+            std::error_code error;
+            std::ostringstream key;
+            key << CHECKPOINT_VERSION << '|' << std::filesystem::absolute(config.inpath, error).string()
+                << '|' << std::filesystem::file_size(config.inpath, error)
+                << '|' << std::filesystem::last_write_time(config.inpath, error).time_since_epoch().count()
+                << '|' << config.seed << '|' << config.unshuffle << '|' << config.map_width << 'x' << config.map_height
+                << '|' << static_cast<int>(config.map_format) << '|' << static_cast<int>(config.backend)
+                << config.planar << config.tiled << config.gpu_yuv
+                << '|' << static_cast<int>(config.rotate_mode) << '|' << config.rotate_every
+                << '|' << profile.codec << '|' << profile.gop_size << '|' << profile.max_b_frames << '|' << profile.bit_rate;
+            for (const auto& option : profile.options) {
+                key << '|' << option.first << '=' << option.second;
+            }
+            key << '|' << config.output_format;
+            for (const Segment& segment : this->segments) {
+                key << '|' << segment.first_frame;
+            }
+            std::string text = key.str();
+            char hex[17];
+            std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(OffsetMapCache::Checksum(reinterpret_cast<const uint8_t*>(text.data()), text.size())));
+            return hex;
+        }
+
+        // Parts 0..last are in the output, flushed. Written to a temporary file and renamed over
+        // the old checkpoint, so a crash leaves either the old or the new one.
+        bool WriteCheckpoint(size_t last) {
+            long frames = 0;
+            std::string parts;
+            for (size_t i = 0; i <= last; i++) {
+                const Segment& segment = this->segments[i];
+                char entry[96];
+                std::snprintf(entry, sizeof(entry), "%s{\"first_frame\":%ld,\"frames\":%ld}", i ? "," : "", segment.first_frame, segment.frames);
+                parts += entry;
+                frames += segment.frames;
+            }
+            std::error_code error;
+            uintmax_t bytes = std::filesystem::file_size(this->config->outpath, error);
+            if (error) return false;
+            bool more = last + 1 < this->segments.size();
+            std::string record = "{\"version\":" + std::to_string(CHECKPOINT_VERSION) + ",\"config\":" + json_quote(this->ConfigKey())
+                + ",\"frame_count\":" + std::to_string(frames) + ",\"output_bytes\":" + std::to_string(bytes)
+                + ",\"next_frame\":" + (more ? std::to_string(this->segments[last + 1].first_frame) : std::string("null"))
+                + ",\"next_position\":" + (more ? std::to_string(this->segments[last + 1].start) : std::string("null"))
+                + ",\"parts\":[" + parts + "]}\n";
+
+            std::filesystem::path path = this->CheckpointPath();
+            std::filesystem::path temp = path;
+            temp += ".tmp";
+            FILE* out = std::fopen(temp.string().c_str(), "wb");
+            if (!out) return false;
+            bool written = std::fwrite(record.data(), 1, record.size(), out) == record.size();
+            written = std::fclose(out) == 0 && written;
+            if (written) {
+                std::filesystem::rename(temp, path, error);
+                written = !error;
+            }
+            if (!written) {
+                std::filesystem::remove(temp, error);
+            }
+            return written;
+        }
+
+        // Marks the parts a checkpoint of this configuration holds as done. Parts are taken in
+        // order up to the first that does not match, and later ones are redone. None are taken
+        // when the interrupted output is gone or shorter than the checkpoint says.
+        int LoadCheckpoint() {
+            std::filesystem::path path = this->CheckpointPath();
+            std::error_code error;
+            if (!std::filesystem::exists(path, error)) {
+                if (this->resume) std::cout << "Info: No checkpoint to resume from; starting at the beginning." << std::endl;
+                return 0;
+            }
+            if (!this->resume) {
+                std::cout << "Info: Replacing the checkpoint of an earlier run; pass --resume to continue it instead." << std::endl;
+                std::filesystem::remove(path, error);
+                std::filesystem::remove(this->ResumePath(), error);
+                return 0;
+            }
+
+            std::ifstream in(path, std::ios::binary);
+            std::stringstream text;
+            text << in.rdbuf();
+            JsonValue checkpoint;
+            try {
+                checkpoint = JsonValue::Parse(text.str());
+                const JsonValue* version = checkpoint.Find("version");
+                const JsonValue* key = checkpoint.Find("config");
+                if (!version || version->AsInteger("version") != CHECKPOINT_VERSION || !key || key->AsString("config") != this->ConfigKey()) {
+                    std::cerr << "Error: The checkpoint at " << path.string() << " was made from another input or with other settings;"
+                              << " run without --resume to start over." << std::endl;
+                    return -1;
+                }
+                // A resume that was itself interrupted left the output it copies from aside.
+                const JsonValue* parts = checkpoint.Find("parts");
+                const JsonValue* bytes = checkpoint.Find("output_bytes");
+                bool aside = std::filesystem::exists(this->ResumePath(), error);
+                uintmax_t size = std::filesystem::file_size(this->config->outpath, error);
+                if (!aside && (!bytes || error || size < static_cast<uintmax_t>(bytes->AsInteger("output_bytes")))) {
+                    std::cout << "Info: The output of the interrupted run is missing or shorter than its checkpoint." << std::endl;
+                    parts = nullptr;
+                }
+                long frames = 0;
+                for (size_t i = 0; parts && i < parts->array.size() && i < this->segments.size(); i++) {
+                    const JsonValue& part = parts->array[i];
+                    Segment& segment = this->segments[i];
+                    const JsonValue* first_frame = part.Find("first_frame");
+                    const JsonValue* count = part.Find("frames");
+                    if (!first_frame || !count || first_frame->AsInteger("first_frame") != segment.first_frame) {
+                        break;
+                    }
+                    segment.done = true;
+                    segment.result = 0;
+                    segment.frames = static_cast<long>(count->AsInteger("frames"));
+                    frames += segment.frames;
+                }
+                size_t resumed = 0;
+                while (resumed < this->segments.size() && this->segments[resumed].done) resumed++;
+                this->encoded.store(frames, std::memory_order_relaxed);
+                if (resumed == 0) {
+                    std::cout << "Info: The checkpoint holds no usable part; starting at the beginning." << std::endl;
+                } else {
+                    std::cout << "Resuming after part " << resumed << " of " << this->segments.size() << " at frame " << frames << std::endl;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Could not read the checkpoint at " << path.string() << ": " << e.what() << std::endl;
+                return -1;
+            }
+            return 0;
+        }
+
+        bool NeedsGlobalHeader() const {
+            const Video& config = *this->config;
+            const char* name = !config.output_format.empty() ? config.output_format.c_str() : PipeIO::IsPipe(config.outpath) ? "mp4" : NULL;
+            const AVOutputFormat* format = av_guess_format(name, PipeIO::IsPipe(config.outpath) ? NULL : config.outpath.c_str(), NULL);
+            return format && (format->flags & AVFMT_GLOBALHEADER);
+        }
+
+        // Waits for the segment, reporting overall progress meanwhile.
+        bool Wait(size_t index) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while (!this->segments[index].done) {
+                this->finished.wait_for(lock, std::chrono::milliseconds(250));
+                this->ReportProgress();
+            }
+            return this->segments[index].result == 0;
+        }
+
+        void ReportProgress() {
+            long frames = this->encoded.load(std::memory_order_relaxed);
+            if (frames == this->reported) return;
+            this->reported = frames;
+            Video& config = *this->config;
+            if (config.telemetry.enabled) {
+                config.telemetry.Report(frames, nullptr, 0);
+            } else if (!this->timestamps.empty()) {
+                std::cout << (static_cast<float>(frames) / static_cast<float>(this->timestamps.size())) * 80.0 << std::endl;
+            }
+        }
+
+        int Mux() {
+            AVPacket* packet = av_packet_alloc();
+            if (!packet) {
+                std::cerr << "Error: Failed to allocate packet." << std::endl;
+                return -1;
+            }
+            int result = 0;
+            for (size_t i = 0; i < this->segments.size() && result == 0; i++) {
+                if (!this->Wait(i)) {
+                    std::cerr << "Error: Segment " << i << " failed." << std::endl;
+                    result = -1;
+                    break;
+                }
+                result = this->MuxSegment(i, packet);
+            }
+            av_packet_free(&packet);
+            return result == 0 ? this->Finish() : result;
+        }
+
+        int Finish() {
+            this->audio.Finish(this->muxed * av_q2d(this->codec_time_base));
+            if (av_write_trailer(this->out_fmt_ctx) < 0) {
+                std::cerr << "Error: Could not finish the output file." << std::endl;
+                return -1;
+            }
+            this->CloseOutput();
+            return 0;
+        }
+
+        // Copies the segment into the output and deletes its spool file.
+        int MuxSegment(size_t index, AVPacket* packet) {
+            const Segment& segment = this->segments[index];
+            std::string name = (this->checkpoint_seconds > 0.0 ? "part " : "segment ") + std::to_string(index);
+            int result = this->Copy(segment.path, name, true, -1, packet);
+            std::error_code ignored;
+            std::filesystem::remove(segment.path, ignored);
+            return result;
+        }
+
+        // Copies up to `limit` (all when negative) video packets of the file at `path` into the
+        // output, opening it with the first file's codec parameters. Spool files have their
+        // timestamps moved back by PTS_MARGIN and must all carry the same codec headers; the
+        // headers of an output read back are in the muxer's form, so they are not compared.
+        int Copy(const std::string& path, const std::string& name, bool spool, long limit, AVPacket* packet) {
+            AVFormatContext* in = nullptr;
+            int index = -1;
+            if (avformat_open_input(&in, path.c_str(), NULL, NULL) != 0 || avformat_find_stream_info(in, NULL) < 0
+                || (index = av_find_best_stream(in, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0)) < 0) {
+                std::cerr << "Error: Could not read back " << name << "." << std::endl;
+                if (in) avformat_close_input(&in);
+                return -1;
+            }
+            for (unsigned int i = 0; i < in->nb_streams; i++) {
+                if (static_cast<int>(i) != index) in->streams[i]->discard = AVDISCARD_ALL;
+            }
+            AVStream* stream = in->streams[index];
+
+            int result = 0;
+            if (!this->out_fmt_ctx) {
+                result = this->OpenOutput(stream->codecpar);
+            }
+            if (result == 0 && spool) {
+                const AVCodecParameters* codecpar = stream->codecpar;
+                if (!this->spool_headers) {
+                    this->spool_headers = avcodec_parameters_alloc();
+                    if (!this->spool_headers || avcodec_parameters_copy(this->spool_headers, codecpar) < 0) {
+                        std::cerr << "Error: Failed to allocate codec parameters." << std::endl;
+                        result = -1;
+                    }
+                } else if (!SameExtradata(codecpar, this->spool_headers)) {
+                    std::cerr << "Error: The " << name << " was encoded with different codec headers." << std::endl;
+                    result = -1;
+                }
+            }
+
+            int64_t margin = av_rescale_q(spool ? PTS_MARGIN : 0, this->codec_time_base, stream->time_base);
+            for (long copied = 0; result == 0 && copied != limit && av_read_frame(in, packet) >= 0; ) {
+                if (packet->stream_index != index) {
+                    av_packet_unref(packet);
+                    continue;
+                }
+                copied++;
+                if (packet->pts != AV_NOPTS_VALUE) packet->pts -= margin;
+                if (packet->dts != AV_NOPTS_VALUE) packet->dts -= margin;
+                av_packet_rescale_ts(packet, stream->time_base, this->out_stream->time_base);
+                if (packet->dts != AV_NOPTS_VALUE && this->last_dts != AV_NOPTS_VALUE && packet->dts <= this->last_dts) {
+                    std::cerr << "Error: The " << name << " does not continue the timestamps before it." << std::endl;
+                    result = -1;
+                } else {
+                    if (packet->dts != AV_NOPTS_VALUE) this->last_dts = packet->dts;
+                    packet->stream_index = this->out_stream->index;
+                    packet->pos = -1;
+                    this->muxed++;
+                    if (av_interleaved_write_frame(this->out_fmt_ctx, packet) < 0) {
+                        std::cerr << "Error: Could not write a packet of the " << name << "." << std::endl;
+                        result = -1;
+                    }
+                    this->audio.WriteUntil(this->muxed * av_q2d(this->codec_time_base));
+                }
+                av_packet_unref(packet);
+            }
+            avformat_close_input(&in);
+            return result;
+        }
+
+        int OpenOutput(const AVCodecParameters* codecpar) {
+            Video& config = *this->config;
+            bool pipe_out = PipeIO::IsPipe(config.outpath);
+            const char* output_filename = pipe_out ? "pipe:" : config.outpath.c_str();
+            const char* format_name = !config.output_format.empty() ? config.output_format.c_str() : pipe_out ? "mp4" : NULL;
+            const AVOutputFormat* out_fmt = av_guess_format(format_name, pipe_out ? NULL : output_filename, NULL);
+            if (!out_fmt || avformat_alloc_output_context2(&this->out_fmt_ctx, out_fmt, NULL, output_filename) < 0) {
+                std::cerr << "Error: Could not create output context." << std::endl;
+                return -1;
+            }
+
+            // The segment encoders run at 1/fps, as Video's encoder does.
+            this->codec_time_base = AVRational{1, static_cast<int>(this->fps)};
+            this->out_stream = avformat_new_stream(this->out_fmt_ctx, NULL);
+            if (!this->out_stream || avcodec_parameters_copy(this->out_stream->codecpar, codecpar) < 0) {
+                std::cerr << "Error: Failed to create output stream." << std::endl;
+                return -1;
+            }
+            this->out_stream->codecpar->codec_tag = 0;
+            this->out_stream->time_base = this->codec_time_base;
+
+            if (this->audio.Open(config.inpath, this->out_fmt_ctx) != 0) {
+                return -1;
+            }
+
+            if (pipe_out) {
+                this->out_io = PipeIO::OpenOutput(config.io_buffer_size);
+                if (!this->out_io) {
+                    std::cerr << "Error: Failed to set up writing to stdout." << std::endl;
+                    return -1;
+                }
+                this->out_fmt_ctx->pb = this->out_io;
+                this->out_fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+            } else if (!(out_fmt->flags & AVFMT_NOFILE) && avio_open(&this->out_fmt_ctx->pb, output_filename, AVIO_FLAG_WRITE) < 0) {
+                std::cerr << "Error: Could not open output file '" << output_filename << "'." << std::endl;
+                return -1;
+            }
+            // A checkpointed output has to stay readable up to its last flush, as a pipe's does.
+            AVDictionary* muxer_options = Video::MuxerOptions(out_fmt, config.fragment_ms, pipe_out || this->checkpoint_seconds > 0.0);
+            int header = avformat_write_header(this->out_fmt_ctx, &muxer_options);
+            av_dict_free(&muxer_options);
+            if (header < 0) {
+                std::cerr << "Error: Could not write the " << out_fmt->name << " header." << std::endl;
+                return -1;
+            }
+            return 0;
+        }
+
+        void CloseOutput() {
+            if (this->out_fmt_ctx && !(this->out_fmt_ctx->flags & AVFMT_FLAG_CUSTOM_IO) && !(this->out_fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+                avio_closep(&this->out_fmt_ctx->pb);
+            }
+            if (this->out_fmt_ctx) avformat_free_context(this->out_fmt_ctx);
+            this->out_fmt_ctx = nullptr;
+            this->out_stream = nullptr;
+            PipeIO::Close(&this->out_io);
+            this->audio.Close();
+            avcodec_parameters_free(&this->spool_headers);
+        }
+
+        static bool SameExtradata(const AVCodecParameters* a, const AVCodecParameters* b) {
+            return a->extradata_size == b->extradata_size
+                && (a->extradata_size == 0 || std::memcmp(a->extradata, b->extradata, a->extradata_size) == 0);
+        }
+
+        Factory factory;
+        int count;
+        std::unique_ptr<Video> config;
+        double fps = 0.0;
+        int width = 0;
+        int height = 0;
+        std::vector<int64_t> timestamps;
+        std::vector<int64_t> keyframes;
+        std::vector<Segment> segments;
+
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::atomic<long> encoded{0};
+        long reported = 0;
+        std::chrono::steady_clock::time_point last_report;
+
+        AVFormatContext* out_fmt_ctx = nullptr;
+        AVStream* out_stream = nullptr;
+        AVIOContext* out_io = nullptr;
+        AVRational codec_time_base{1, 1};
+        AVCodecParameters* spool_headers = nullptr;
+        AudioTrack audio;
+        int64_t last_dts = AV_NOPTS_VALUE;
+        long muxed = 0;
+    };
+}
@@ -15,15 +15,18 @@ namespace UnsafeYT{
         return shader;
     }
     
-    GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource) {
+    // geometrySource may be null.
+    GLuint createShaderProgram(const char* vertexSource, const char* geometrySource, const char* fragmentSource) {
         GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+        GLuint geometryShader = geometrySource ? compileShader(GL_GEOMETRY_SHADER, geometrySource) : 0;
         GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
-        if (vertexShader == 0 || fragmentShader == 0) {
+        if (vertexShader == 0 || fragmentShader == 0 || (geometrySource && geometryShader == 0)) {
             return 0;
         }
     
         GLuint shaderProgram = glCreateProgram();
         glAttachShader(shaderProgram, vertexShader);
+        if (geometryShader) glAttachShader(shaderProgram, geometryShader);
         glAttachShader(shaderProgram, fragmentShader);
         glLinkProgram(shaderProgram);
     
@@ -34,11 +37,29 @@ namespace UnsafeYT{
             glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
             std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
             glDeleteShader(vertexShader);
+            if (geometryShader) glDeleteShader(geometryShader);
             glDeleteShader(fragmentShader);
             return 0;
         }
         glDeleteShader(vertexShader);
+        if (geometryShader) glDeleteShader(geometryShader);
         glDeleteShader(fragmentShader);
         return shaderProgram;
     }
+
+    GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource) {
+        return createShaderProgram(vertexSource, nullptr, fragmentSource);
+    }
+
+    // Uniforms of the remap programs never change during a run, so they are set once after
+    // linking rather than looked up every frame. Uniforms a program lacks are skipped by GL.
+    void configureRemapProgram(GLuint program, int frameWidth, int frameHeight, int mapWidth, int mapHeight) {
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "ourTexture"), 0);
+        glUniform1i(glGetUniformLocation(program, "offsetMap"), 1);
+        glUniform1i(glGetUniformLocation(program, "tileMap"), 1);
+        glUniform2i(glGetUniformLocation(program, "frameSize"), frameWidth, frameHeight);
+        glUniform2i(glGetUniformLocation(program, "mapSize"), mapWidth, mapHeight);
+        glUseProgram(0);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,237 @@
+const char* vertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+
+out vec2 TexCoord;
+
+void main()
+{
+    gl_Position = vec4(aPos, 1.0);
+    TexCoord = aTexCoord;
+}
+)";
+
+const char* fragmentShaderSource = R"(
+#version 330
+
+out vec4 FragColor;
+in vec2 TexCoord;
+
+uniform sampler2D ourTexture;
+uniform sampler2D offsetMap;
+
+void main() {
+    vec4 shuffle_sample = texture(offsetMap, TexCoord);
+    vec2 decoded_offset = shuffle_sample.xy;
+    
+    vec2 base_new_uv = TexCoord + decoded_offset;
+
+    vec4 c = texture(ourTexture, base_new_uv);
+
+    FragColor = vec4(1-c.rgb, c.a);
+}
+)";
+
+// Same remap with the integer tile map: pure texelFetch addressing, one source texel per
+// output pixel. Must stay in step with build_index_remap_plan.
+const char* indexFragmentShaderSource = R"(
+#version 330
+
+out vec4 FragColor;
+
+uniform sampler2D ourTexture;
+uniform usampler2D tileMap;
+uniform ivec2 frameSize;
+uniform ivec2 mapSize;
+
+ivec2 tileStart(ivec2 cell) {
+    return (2 * cell * frameSize + mapSize - 1) / (2 * mapSize);
+}
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 cell = ((2 * p + 1) * mapSize) / (2 * frameSize);
+    int source = int(texelFetch(tileMap, cell, 0).r);
+    ivec2 source_cell = ivec2(source % mapSize.x, source / mapSize.x);
+
+    ivec2 q = clamp(p + tileStart(source_cell) - tileStart(cell), ivec2(0), frameSize - 1);
+    vec4 c = texelFetch(ourTexture, q, 0);
+
+    FragColor = vec4(1-c.rgb, c.a);
+}
+)";
+
+// Batched remap: instance i of the full-screen quad is routed to layer i of the layered
+// framebuffer and samples layer i of the frame array.
+const char* batchVertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+
+out vec2 vTexCoord;
+flat out int vLayer;
+
+void main()
+{
+    gl_Position = vec4(aPos, 1.0);
+    vTexCoord = aTexCoord;
+    vLayer = gl_InstanceID;
+}
+)";
+
+const char* batchGeometryShaderSource = R"(
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+in vec2 vTexCoord[];
+flat in int vLayer[];
+
+out vec2 TexCoord;
+flat out int Layer;
+
+void main()
+{
+    for (int i = 0; i < 3; i++) {
+        gl_Position = gl_in[i].gl_Position;
+        gl_Layer = vLayer[0];
+        TexCoord = vTexCoord[i];
+        Layer = vLayer[0];
+        EmitVertex();
+    }
+    EndPrimitive();
+}
+)";
+
+const char* batchFragmentShaderSource = R"(
+#version 330
+
+out vec4 FragColor;
+in vec2 TexCoord;
+flat in int Layer;
+
+uniform sampler2DArray ourTexture;
+uniform sampler2D offsetMap;
+
+void main() {
+    vec2 decoded_offset = texture(offsetMap, TexCoord).xy;
+    vec4 c = texture(ourTexture, vec3(TexCoord + decoded_offset, Layer));
+
+    FragColor = vec4(1-c.rgb, c.a);
+}
+)";
+
+const char* batchIndexFragmentShaderSource = R"(
+#version 330
+
+out vec4 FragColor;
+flat in int Layer;
+
+uniform sampler2DArray ourTexture;
+uniform usampler2D tileMap;
+uniform ivec2 frameSize;
+uniform ivec2 mapSize;
+
+ivec2 tileStart(ivec2 cell) {
+    return (2 * cell * frameSize + mapSize - 1) / (2 * mapSize);
+}
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 cell = ((2 * p + 1) * mapSize) / (2 * frameSize);
+    int source = int(texelFetch(tileMap, cell, 0).r);
+    ivec2 source_cell = ivec2(source % mapSize.x, source / mapSize.x);
+
+    ivec2 q = clamp(p + tileStart(source_cell) - tileStart(cell), ivec2(0), frameSize - 1);
+    vec4 c = texelFetch(ourTexture, ivec3(q, Layer), 0);
+
+    FragColor = vec4(1-c.rgb, c.a);
+}
+)";
+
+// YUV remap (see YuvRenderer): the same full-screen quad drawn twice, once into the Y target
+// and once into the U and V targets, with the input planes as three R8 textures. The colour is
+// converted to RGB, inverted and converted back, so 1-c applies as on the RGB path.
+const char* yuvFragmentShaderSource = R"(
+#version 330
+
+layout (location = 0) out float PlaneOut;
+layout (location = 1) out float PlaneV;
+in vec2 TexCoord;
+
+uniform sampler2D planeY;
+uniform sampler2D planeU;
+uniform sampler2D planeV;
+uniform sampler2D offsetMap;
+uniform bool chromaPass;
+uniform mat3 toRgb;
+uniform mat3 toYuv;
+uniform vec3 inOffset;
+uniform vec3 inScale;
+uniform vec3 outOffset;
+uniform vec3 outScale;
+
+vec3 invert(vec3 yuv) {
+    vec3 rgb = clamp(toRgb * ((yuv * 255.0 - inOffset) / inScale), 0.0, 1.0);
+    return ((toYuv * (1.0 - rgb)) * outScale + outOffset) / 255.0;
+}
+
+void main() {
+    vec2 uv = TexCoord + texture(offsetMap, TexCoord).xy;
+    vec3 c = invert(vec3(texture(planeY, uv).r, texture(planeU, uv).r, texture(planeV, uv).r));
+
+    PlaneOut = chromaPass ? c.y : c.x;
+    PlaneV = c.z;
+}
+)";
+
+// Integer tile map variant. frameSize is the size of the plane being rendered, which is
+// addressed like build_index_remap_plan addresses that plane; lumaShift takes its pixels to
+// luma and chromaShift takes luma to the input's chroma.
+const char* yuvIndexFragmentShaderSource = R"(
+#version 330
+
+layout (location = 0) out float PlaneOut;
+layout (location = 1) out float PlaneV;
+
+uniform sampler2D planeY;
+uniform sampler2D planeU;
+uniform sampler2D planeV;
+uniform usampler2D tileMap;
+uniform ivec2 frameSize;
+uniform ivec2 mapSize;
+uniform ivec2 lumaShift;
+uniform ivec2 chromaShift;
+uniform bool chromaPass;
+uniform mat3 toRgb;
+uniform mat3 toYuv;
+uniform vec3 inOffset;
+uniform vec3 inScale;
+uniform vec3 outOffset;
+uniform vec3 outScale;
+
+ivec2 tileStart(ivec2 cell) {
+    return (2 * cell * frameSize + mapSize - 1) / (2 * mapSize);
+}
+
+vec3 invert(vec3 yuv) {
+    vec3 rgb = clamp(toRgb * ((yuv * 255.0 - inOffset) / inScale), 0.0, 1.0);
+    return ((toYuv * (1.0 - rgb)) * outScale + outOffset) / 255.0;
+}
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 cell = ((2 * p + 1) * mapSize) / (2 * frameSize);
+    int source = int(texelFetch(tileMap, cell, 0).r);
+    ivec2 source_cell = ivec2(source % mapSize.x, source / mapSize.x);
+
+    ivec2 q = clamp(p + tileStart(source_cell) - tileStart(cell), ivec2(0), frameSize - 1);
+    ivec2 luma = min(q << lumaShift, textureSize(planeY, 0) - 1);
+    ivec2 chroma = luma >> chromaShift;
+    vec3 c = invert(vec3(texelFetch(planeY, luma, 0).r, texelFetch(planeU, chroma, 0).r, texelFetch(planeV, chroma, 0).r));
+
+    PlaneOut = chromaPass ? c.y : c.x;
+    PlaneV = c.z;
+}
+)";
@@ -0,0 +1,71 @@
+namespace UnsafeYT{
+    // AVIOContexts over stdin and stdout, so "-" can stand for the input or the output path.
+    // Both are plain byte streams without seeking: the input has to be a format that can be
+    // demuxed front to back (MPEG-TS, Matroska, fragmented MP4 or an MP4 with its moov atom
+    // first), and the output has to be a streaming muxer such as fragmented MP4 or MPEG-TS.
+    // The buffers are large so the callbacks run once per megabyte rather than per packet.
+    class PipeIO {
+    public:
+        static constexpr size_t DEFAULT_BUFFER = 1 << 20;
+
+        static bool IsPipe(const std::string& path) {
+            return path == "-";
+        }
+
+        static AVIOContext* OpenInput(size_t buffer_size) {
+        #ifdef _WIN32
+            _setmode(_fileno(stdin), _O_BINARY);
+        #endif
+            return Allocate(buffer_size, 0);
+        }
+
+        static AVIOContext* OpenOutput(size_t buffer_size) {
+        #ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+        #endif
+            return Allocate(buffer_size, 1);
+        }
+
+        // Flushes what is left in the buffer and frees the context and its buffer.
+        static void Close(AVIOContext** io) {
+            if (!*io) return;
+            if ((*io)->write_flag) {
+                avio_flush(*io);
+                std::fflush(stdout);
+            }
+            av_freep(&(*io)->buffer);
+            avio_context_free(io);
+        }
+
+    private:
+        static AVIOContext* Allocate(size_t buffer_size, int write) {
+            int size = static_cast<int>(std::min<size_t>(std::max<size_t>(buffer_size, 4096), 1 << 30));
+            unsigned char* buffer = static_cast<unsigned char*>(av_malloc(size));
+            if (!buffer) return nullptr;
+            AVIOContext* io = avio_alloc_context(buffer, size, write, nullptr, write ? nullptr : &Read, write ? &Write : nullptr, nullptr);
+            if (!io) {
+                av_free(buffer);
+                return nullptr;
+            }
+            io->seekable = 0;
+            return io;
+        }
+
+        static int Read(void*, uint8_t* buf, int size) {
+            size_t read = std::fread(buf, 1, static_cast<size_t>(size), stdin);
+            if (read == 0) return std::ferror(stdin) ? AVERROR(EIO) : AVERROR_EOF;
+            return static_cast<int>(read);
+        }
+
+        // Flushed on every call so a reader downstream gets each buffer as soon as it is full.
+    #if LIBAVFORMAT_VERSION_MAJOR >= 61
+        static int Write(void*, const uint8_t* buf, int size) {
+    #else
+        static int Write(void*, uint8_t* buf, int size) {
+    #endif
+            if (std::fwrite(buf, 1, static_cast<size_t>(size), stdout) != static_cast<size_t>(size)) return AVERROR(EIO);
+            std::fflush(stdout);
+            return size;
+        }
+    };
+}
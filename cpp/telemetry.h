@@ -0,0 +1,258 @@
+namespace UnsafeYT{
+    // Accumulated wall time of one stage. Written from whichever thread runs the stage,
+    // read by the encoder thread when it reports.
+    struct StageTimer {
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> count{0};
+        uint64_t reported_ns = 0;
+        uint64_t reported_count = 0;
+
+        void Reset() {
+            this->total_ns.store(0, std::memory_order_relaxed);
+            this->count.store(0, std::memory_order_relaxed);
+            this->reported_ns = 0;
+            this->reported_count = 0;
+        }
+
+        void Add(uint64_t ns, uint64_t frames = 1) {
+            this->total_ns.fetch_add(ns, std::memory_order_relaxed);
+            this->count.fetch_add(frames, std::memory_order_relaxed);
+        }
+
+        // Mean milliseconds per frame since the previous call, or -1 when nothing ran.
+        double TakeIntervalMs() {
+            uint64_t total = this->total_ns.load(std::memory_order_relaxed);
+            uint64_t frames = this->count.load(std::memory_order_relaxed);
+            double ms = frames > this->reported_count ? (total - this->reported_ns) / 1e6 / (frames - this->reported_count) : -1.0;
+            this->reported_ns = total;
+            this->reported_count = frames;
+            return ms;
+        }
+    };
+
+    // Machine-readable progress for front ends: one JSON object per line on stdout, written
+    // with a single fwrite and flushed, so a reader never sees a partial or merged record.
+    //
+    //     {"event":"start","total_frames":900,"fps":30,"width":1920,"height":1080}
+    //     {"event":"progress","frame":40,"total_frames":900,"percent":4.44,"fps":61.2,
+    //      "avg_fps":58.9,"elapsed":0.68,"stages_ms":{"decode":1.2,"transform":3.4,
+    //      "encode":5.6},"queues":{"decoded":{"depth":3,"capacity":8}},
+    //      "bitrate_kbps":9120.4,"avg_bitrate_kbps":9011.7,"rss_bytes":183500800}
+    //     {"event":"done","ok":true,"frames":900,"elapsed":15.2,"avg_fps":59.2}
+    //
+    // Quality metrics (--metrics, see QualityMeter) add a record per measured frame, where
+    // "frame" is the frame's 0-based index in the output, and a summary before "done":
+    //
+    //     {"event":"quality","frame":30,"psnr":{"y":47.91,"u":49.02,"v":48.88,"all":48.24},
+    //      "ssim":{"y":0.99512,"u":0.99321,"v":0.99307,"all":0.99449}}
+    //     {"event":"quality_summary","frames":30,"skipped":0,"psnr":{"y":47.85,"u":48.97,
+    //      "v":48.91,"all":48.19,"mean":48.22,"min":46.70},"ssim":{"y":0.99507,"u":0.99318,
+    //      "v":0.99305,"all":0.99445,"min":0.99102},"overhead_ms":212.4}
+    //
+    // Playback (--play) adds one record before "done":
+    //
+    //     {"event":"playback","shown":898,"dropped":2,"stalls":0,"latency_ms":{"mean":41.2,
+    //      "p50":40.8,"p99":52.3,"max":61.0}}
+    //
+    // Stage latencies are means over the interval; -1 means the stage saw no frame in it. The
+    // "quality" stage is the time the metrics took per encoded frame.
+    // A record costs a few microseconds, so reporting every frame is fine. In batch mode every
+    // record also carries "job" with the id of the job it belongs to.
+    class Telemetry {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        bool enabled = false;
+        int interval = 1;
+        StageTimer decode;
+        StageTimer transform;
+        StageTimer encode;
+        StageTimer quality;
+
+        // Cheap enough to call unconditionally; returns a zero time point when disabled.
+        Clock::time_point Now() const {
+            return this->enabled ? Clock::now() : Clock::time_point();
+        }
+
+        void AddSince(StageTimer& stage, Clock::time_point since, uint64_t frames = 1) const {
+            if (!this->enabled) return;
+            stage.Add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count()), frames);
+        }
+
+        // Tags the following records with a job id; empty for none.
+        void SetJob(const std::string& id) {
+            this->job = id.empty() ? "" : "\"job\":" + json_quote(id.substr(0, 64)) + ",";
+        }
+
+        void AddBytes(int64_t bytes) {
+            this->encoded_bytes += bytes;
+        }
+
+        void Start(long total_frames, double fps, int width, int height) {
+            this->total_frames = total_frames;
+            this->fps = fps;
+            this->started = Clock::now();
+            this->last_report = this->started;
+            this->last_frame = 0;
+            this->encoded_bytes = 0;
+            this->last_bytes = 0;
+            this->decode.Reset();
+            this->transform.Reset();
+            this->encode.Reset();
+            this->quality.Reset();
+            if (!this->enabled) return;
+            char line[512];
+            int n = std::snprintf(line, sizeof(line), "{\"event\":\"start\",%s\"total_frames\":%ld,\"fps\":%.3f,\"width\":%d,\"height\":%d}\n",
+                                  this->job.c_str(), total_frames, fps, width, height);
+            Emit(line, n);
+        }
+
+        // Called by the encoder thread once frame `frame` (1-based count) has been encoded.
+        void Frame(long frame, const QueueStats* const* queues, int queue_count) {
+            if (!this->enabled || frame % this->interval != 0) return;
+            this->Report(frame, queues, queue_count);
+        }
+
+        // A progress record regardless of the interval, for callers that poll.
+        void Report(long frame, const QueueStats* const* queues, int queue_count) {
+            if (!this->enabled) return;
+            Clock::time_point now = Clock::now();
+            double elapsed = std::chrono::duration<double>(now - this->started).count();
+            double since_last = std::chrono::duration<double>(now - this->last_report).count();
+            long frames_since = frame - this->last_frame;
+            int64_t bytes_since = this->encoded_bytes - this->last_bytes;
+
+            char line[1024];
+            int n = std::snprintf(line, sizeof(line),
+                "{\"event\":\"progress\",%s\"frame\":%ld,\"total_frames\":%ld,\"percent\":%.2f,\"fps\":%.2f,\"avg_fps\":%.2f,\"elapsed\":%.3f,"
+                "\"stages_ms\":{\"decode\":%.3f,\"transform\":%.3f,\"encode\":%.3f,\"quality\":%.3f},\"queues\":{",
+                this->job.c_str(), frame, this->total_frames, this->total_frames > 0 ? std::min(100.0, 100.0 * frame / this->total_frames) : -1.0,
+                since_last > 0.0 ? frames_since / since_last : 0.0, elapsed > 0.0 ? frame / elapsed : 0.0, elapsed,
+                this->decode.TakeIntervalMs(), this->transform.TakeIntervalMs(), this->encode.TakeIntervalMs(), this->quality.TakeIntervalMs());
+
+            bool first = true;
+            for (int i = 0; i < queue_count && n < static_cast<int>(sizeof(line)); i++) {
+                if (!queues[i] || queues[i]->samples == 0) continue;
+                n += std::snprintf(line + n, sizeof(line) - n, "%s\"%s\":{\"depth\":%zu,\"capacity\":%zu}",
+                                   first ? "" : ",", queues[i]->name, queues[i]->depth, queues[i]->capacity);
+                first = false;
+            }
+
+            double media_since = this->fps > 0.0 ? frames_since / this->fps : 0.0;
+            double media_total = this->fps > 0.0 ? frame / this->fps : 0.0;
+            if (n < static_cast<int>(sizeof(line))) {
+                n += std::snprintf(line + n, sizeof(line) - n, "},\"bitrate_kbps\":%.1f,\"avg_bitrate_kbps\":%.1f,\"rss_bytes\":%lld}\n",
+                                   media_since > 0.0 ? bytes_since * 8 / media_since / 1000.0 : 0.0,
+                                   media_total > 0.0 ? this->encoded_bytes * 8 / media_total / 1000.0 : 0.0,
+                                   static_cast<long long>(this->ResidentBytes(now)));
+            }
+            Emit(line, n);
+
+            this->last_report = now;
+            this->last_frame = frame;
+            this->last_bytes = this->encoded_bytes;
+        }
+
+        void Done(bool ok, long frames) {
+            if (!this->enabled) return;
+            double elapsed = std::chrono::duration<double>(Clock::now() - this->started).count();
+            if (this->started == Clock::time_point()) elapsed = 0.0;
+            char line[512];
+            int n = std::snprintf(line, sizeof(line), "{\"event\":\"done\",%s\"ok\":%s,\"frames\":%ld,\"elapsed\":%.3f,\"avg_fps\":%.2f}\n",
+                                  this->job.c_str(), ok ? "true" : "false", frames, elapsed, elapsed > 0.0 ? frames / elapsed : 0.0);
+            Emit(line, n);
+        }
+
+        // Summary of a real-time playback (see Player), before its done record.
+        void Playback(long shown, long dropped, long stalls, double mean_ms, double p50_ms, double p99_ms, double max_ms) {
+            if (!this->enabled) return;
+            char line[512];
+            int n = std::snprintf(line, sizeof(line),
+                "{\"event\":\"playback\",%s\"shown\":%ld,\"dropped\":%ld,\"stalls\":%ld,\"latency_ms\":{\"mean\":%.3f,\"p50\":%.3f,\"p99\":%.3f,\"max\":%.3f}}\n",
+                this->job.c_str(), shown, dropped, stalls, mean_ms, p50_ms, p99_ms, max_ms);
+            Emit(line, n);
+        }
+
+        void Quality(const FrameQuality& quality) {
+            if (!this->enabled) return;
+            char line[512];
+            int n = std::snprintf(line, sizeof(line), "{\"event\":\"quality\",%s\"frame\":%ld,\"psnr\":{", this->job.c_str(), quality.frame);
+            n += PlaneValues(line + n, sizeof(line) - n, quality.planes, quality.psnr, quality.psnr_all, "%.3f");
+            n += std::snprintf(line + n, sizeof(line) - n, "},\"ssim\":{");
+            n += PlaneValues(line + n, sizeof(line) - n, quality.planes, quality.ssim, quality.ssim_all, "%.5f");
+            n += std::snprintf(line + n, sizeof(line) - n, "}}\n");
+            Emit(line, n);
+        }
+
+        // Aggregate quality of the run, before its done record.
+        void Quality(const QualitySummary& summary) {
+            if (!this->enabled) return;
+            char line[768];
+            int n = std::snprintf(line, sizeof(line), "{\"event\":\"quality_summary\",%s\"frames\":%ld,\"skipped\":%ld,\"psnr\":{",
+                                  this->job.c_str(), summary.frames, summary.skipped);
+            n += PlaneValues(line + n, sizeof(line) - n, summary.planes, summary.psnr, summary.psnr_all, "%.3f");
+            n += std::snprintf(line + n, sizeof(line) - n, ",\"mean\":%.3f,\"min\":%.3f},\"ssim\":{", summary.psnr_mean, summary.psnr_min);
+            n += PlaneValues(line + n, sizeof(line) - n, summary.planes, summary.ssim, summary.ssim_all, "%.5f");
+            n += std::snprintf(line + n, sizeof(line) - n, ",\"min\":%.5f},\"overhead_ms\":%.3f}\n", summary.ssim_min, summary.overhead_ms);
+            Emit(line, n);
+        }
+
+    private:
+        // "y","u","v" (as many as there are planes) and "all". The buffers above always fit them.
+        static int PlaneValues(char* out, size_t size, int planes, const double* values, double all, const char* format) {
+            static const char* names[] = {"y", "u", "v"};
+            std::string text;
+            char value[64];
+            for (int c = 0; c < planes; c++) {
+                std::snprintf(value, sizeof(value), format, values[c]);
+                text += std::string("\"") + names[c] + "\":" + value + ",";
+            }
+            std::snprintf(value, sizeof(value), format, all);
+            text += std::string("\"all\":") + value;
+            return std::snprintf(out, size, "%s", text.c_str());
+        }
+
+        // A record that did not fit is dropped rather than written without its newline.
+        template <size_t N>
+        static void Emit(const char (&line)[N], int length) {
+            if (length <= 0 || static_cast<size_t>(length) >= N) return;
+            std::fwrite(line, 1, static_cast<size_t>(length), stdout);
+            std::fflush(stdout);
+        }
+
+        // Resident set size, re-read at most every 100 ms; -1 where unsupported.
+        int64_t ResidentBytes(Clock::time_point now) {
+            if (now - this->rss_read < std::chrono::milliseconds(100) && this->rss_read != Clock::time_point()) {
+                return this->rss;
+            }
+            this->rss_read = now;
+        #if defined(_WIN32)
+            PROCESS_MEMORY_COUNTERS counters;
+            this->rss = K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? static_cast<int64_t>(counters.WorkingSetSize) : -1;
+        #elif defined(__linux__)
+            this->rss = -1;
+            if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+                long pages = 0, resident = 0;
+                if (std::fscanf(statm, "%ld %ld", &pages, &resident) == 2) {
+                    this->rss = static_cast<int64_t>(resident) * sysconf(_SC_PAGESIZE);
+                }
+                std::fclose(statm);
+            }
+        #else
+            this->rss = -1;
+        #endif
+            return this->rss;
+        }
+
+        std::string job;
+        long total_frames = 0;
+        double fps = 0.0;
+        Clock::time_point started;
+        Clock::time_point last_report;
+        long last_frame = 0;
+        int64_t encoded_bytes = 0;
+        int64_t last_bytes = 0;
+        Clock::time_point rss_read;
+        int64_t rss = -1;
+    };
+}
@@ -0,0 +1,167 @@
+namespace UnsafeYT{
+    namespace detail {
+        // `1 - v` over a contiguous run of samples, 16 bytes at a time where the target has SSE2 or NEON.
+        template <typename Sample>
+        inline void invert_run(const Sample* src, Sample* dst, int count, BasicInversion<Sample> inversion) {
+            int x = 0;
+        #if defined(__SSE2__)
+            if constexpr (sizeof(Sample) == 1) {
+                const __m128i minuend = _mm_set1_epi8(static_cast<char>(inversion.minuend));
+                const __m128i bias = _mm_set1_epi8(static_cast<char>(inversion.bias));
+                for (; x + 16 <= count; x += 16) {
+                    __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_adds_epu8(_mm_subs_epu8(minuend, pixels), bias));
+                }
+            } else {
+                const __m128i minuend = _mm_set1_epi16(static_cast<short>(inversion.minuend));
+                const __m128i bias = _mm_set1_epi16(static_cast<short>(inversion.bias));
+                const __m128i maximum = _mm_set1_epi16(static_cast<short>(inversion.maximum));
+                for (; x + 8 <= count; x += 8) {
+                    __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+                    pixels = _mm_adds_epu16(_mm_subs_epu16(minuend, pixels), bias);
+                    // SSE2 has no unsigned 16-bit min: min(v, maximum) = v - saturate(v - maximum).
+                    pixels = _mm_sub_epi16(pixels, _mm_subs_epu16(pixels, maximum));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), pixels);
+                }
+            }
+        #elif defined(__aarch64__)
+            if constexpr (sizeof(Sample) == 1) {
+                const uint8x16_t minuend = vdupq_n_u8(inversion.minuend);
+                const uint8x16_t bias = vdupq_n_u8(inversion.bias);
+                for (; x + 16 <= count; x += 16) {
+                    vst1q_u8(dst + x, vqaddq_u8(vqsubq_u8(minuend, vld1q_u8(src + x)), bias));
+                }
+            } else {
+                const uint16x8_t minuend = vdupq_n_u16(inversion.minuend);
+                const uint16x8_t bias = vdupq_n_u16(inversion.bias);
+                const uint16x8_t maximum = vdupq_n_u16(inversion.maximum);
+                for (; x + 8 <= count; x += 8) {
+                    vst1q_u16(dst + x, vminq_u16(vqaddq_u16(vqsubq_u16(minuend, vld1q_u16(src + x)), bias), maximum));
+                }
+            }
+        #endif
+            for (; x < count; ++x) {
+                dst[x] = inversion.apply(src[x]);
+            }
+        }
+    }
+
+    // Tiled remap for frames of any size, straight from the decoder's planes into the
+    // encoder's. The output is processed in bands of one row of map cells; within a band
+    // every output cell reads exactly one source cell, shifted by whole pixels, so each
+    // row of a cell is one contiguous run copied with the inversion applied. Only the
+    // source cells the permutation sends to a band are read for it.
+    //
+    // Unlike PlanarRemapper there is no per-pixel plan (4 bytes per pixel and plane) and no
+    // dependence on strides: the state is two tables of cell edges per plane, so it does not
+    // grow with resolution. Addressing is that of build_index_remap_plan on every plane, the
+    // integer form of the map, also when the run uses float offsets.
+    class TiledRemapper {
+    public:
+        void Prepare(const std::vector<float>& offset_map, const std::vector<uint32_t>& tile_map, int map_width, int map_height,
+                     AVPixelFormat pix_fmt, int width, int height, bool full_range) {
+            if (!PlanarRemapper::Describe(pix_fmt, this->layout)) {
+                throw std::runtime_error("Tiled remap needs a planar or semi-planar YUV frame.");
+            }
+            this->sources = tile_map.empty() ? offsets_to_tile_map(offset_map, map_width, map_height) : tile_map;
+            this->map_width = map_width;
+            this->map_height = map_height;
+            this->pix_fmt = pix_fmt;
+            this->full_range = full_range;
+
+            for (int c = 0; c < this->layout.Planes(); c++) {
+                Plane& plane = this->planes[c];
+                int shift_w = c == 0 ? 0 : this->layout.log2_chroma_w;
+                int shift_h = c == 0 ? 0 : this->layout.log2_chroma_h;
+                plane.channels = this->layout.semi_planar && c == 1 ? 2 : 1;
+                plane.width = -((-width) >> shift_w);
+                plane.height = -((-height) >> shift_h);
+                plane.xs.resize(map_width + 1);
+                plane.ys.resize(map_height + 1);
+                for (int cx = 0; cx <= map_width; cx++) {
+                    plane.xs[cx] = detail::tile_start(cx, plane.width, map_width);
+                }
+                for (int cy = 0; cy <= map_height; cy++) {
+                    plane.ys[cy] = detail::tile_start(cy, plane.height, map_height);
+                }
+            }
+        }
+
+        int Bands() const { return this->map_height; }
+
+        // Bands are independent, so `threads` > 1 splits them over that many threads.
+        void Apply(const AVFrame* src, AVFrame* dst, int threads) const {
+            if (!PlanarRemapper::SameLayout(static_cast<AVPixelFormat>(src->format), this->pix_fmt)
+                || !PlanarRemapper::SameLayout(static_cast<AVPixelFormat>(dst->format), this->pix_fmt)
+                || src->width != this->planes[0].width || src->height != this->planes[0].height
+                || dst->width != this->planes[0].width || dst->height != this->planes[0].height) {
+                throw std::runtime_error("Frame layout does not match the prepared tiled remap.");
+            }
+            int parts = std::min(std::max(threads, 1), this->map_height);
+            detail::parallel_slices(static_cast<size_t>(this->map_height), parts, [&](size_t begin, size_t end, int) {
+                this->ApplyBands(src, dst, static_cast<int>(begin), static_cast<int>(end));
+            });
+        }
+
+        void ApplyBands(const AVFrame* src, AVFrame* dst, int begin, int end) const {
+            if (this->layout.bytes == 1) {
+                this->ApplyBandsAs<uint8_t>(src, dst, begin, end);
+            } else {
+                this->ApplyBandsAs<uint16_t>(src, dst, begin, end);
+            }
+        }
+
+        AVPixelFormat pix_fmt = AV_PIX_FMT_NONE;
+        YuvLayout layout;
+        bool full_range = false;
+
+    private:
+        struct Plane {
+            int width = 0;
+            int height = 0;
+            int channels = 1;
+            std::vector<int> xs;
+            std::vector<int> ys;
+        };
+
+        // Runs are counted in pixels of a plane and copied as channels samples each.
+        template <typename Sample>
+        void ApplyBandsAs(const AVFrame* src, AVFrame* dst, int begin, int end) const {
+            for (int c = 0; c < this->layout.Planes(); c++) {
+                const Plane& plane = this->planes[c];
+                const int channels = plane.channels;
+                const BasicInversion<Sample> inversion = yuv_inversion<Sample>(this->layout, c, this->full_range);
+                for (int band = begin; band < end; band++) {
+                    const uint32_t* band_sources = this->sources.data() + static_cast<size_t>(band) * this->map_width;
+                    for (int y = plane.ys[band]; y < plane.ys[band + 1]; y++) {
+                        Sample* row = reinterpret_cast<Sample*>(dst->data[c] + static_cast<size_t>(y) * dst->linesize[c]);
+                        for (int cx = 0; cx < this->map_width; cx++) {
+                            int scx = static_cast<int>(band_sources[cx] % this->map_width);
+                            int scy = static_cast<int>(band_sources[cx] / this->map_width);
+                            int sy = std::min(std::max(y + plane.ys[scy] - plane.ys[band], 0), plane.height - 1);
+                            const Sample* source_row = reinterpret_cast<const Sample*>(src->data[c] + static_cast<size_t>(sy) * src->linesize[c]);
+
+                            // A source cell one pixel narrower than its destination at the
+                            // right edge runs out of frame; those pixels repeat the last column.
+                            int shift = plane.xs[scx] - plane.xs[cx];
+                            int x0 = plane.xs[cx];
+                            int x1 = plane.xs[cx + 1];
+                            int inside = std::max(std::min(x1, plane.width - shift), x0);
+                            detail::invert_run(source_row + (x0 + shift) * channels, row + x0 * channels, (inside - x0) * channels, inversion);
+                            for (int x = inside; x < x1; x++) {
+                                for (int k = 0; k < channels; k++) {
+                                    row[x * channels + k] = inversion.apply(source_row[(plane.width - 1) * channels + k]);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        std::vector<uint32_t> sources;
+        int map_width = 0;
+        int map_height = 0;
+        std::array<Plane, 3> planes;
+    };
+}
@@ -1,14 +1,29 @@
 namespace UnsafeYT {
+    // Conversion contexts and scratch frames of one transform thread. SwsContext is not
+    // thread-safe, so every worker of the frame-parallel path gets its own set; the serial,
+    // pipelined and GL paths only use scratch[0].
+    struct TransformScratch {
+        SwsContext* sws_ctx = nullptr;
+        SwsContext* out_sws_ctx = nullptr;
+        AVFrame* rgb_frame = nullptr;
+        AVFrame* processed_rgb_frame = nullptr;
+        AVFrame* planar_frame = nullptr;
+        // Map of the frame being transformed when maps rotate, set per frame by the caller.
+        std::shared_ptr<const RotatedMap> map;
+    };
+
     class Video {
     public:
-        GLFWwindow* window;
+        GLContext gl_context;
+        ContextBackend context_backend = ContextBackend::Auto;
         GLuint shaderProgram;
-        GLuint inputTexture;
-        GLuint offsetMapTexture;
-        GLuint fbo;
-        GLuint fboTexture;
-        GLuint VBO;
-        GLuint VAO;
+        GLuint yuvProgram = 0;
+        GLuint inputTexture = 0;
+        GLuint offsetMapTexture = 0;
+        GLuint fbo = 0;
+        GLuint fboTexture = 0;
+        GLuint VBO = 0;
+        GLuint VAO = 0;
         
         AVFormatContext* in_fmt_ctx = nullptr;
         AVCodecContext* in_codec_ctx = nullptr;
@@ -17,11 +32,115 @@ namespace UnsafeYT {
         AVStream* out_stream = nullptr;
         AVFrame* in_frame = nullptr;
         AVPacket* in_packet = nullptr;
-        SwsContext* sws_ctx = nullptr;
-        SwsContext* out_sws_ctx = nullptr;
+        AVIOContext* in_io = nullptr;
+        AVIOContext* out_io = nullptr;
+
+        // "-" reads from stdin or writes to stdout. The formats override probing and the
+        // output file extension; a pipe output defaults to MP4. fragment_ms > 0 writes
+        // fragmented MP4 whose fragments start at the first keyframe after that many ms, so
+        // the file can be consumed while it is being written; pipe output to MP4 always does.
+        std::string input_format;
+        std::string output_format;
+        int fragment_ms = 0;
+        size_t io_buffer_size = PipeIO::DEFAULT_BUFFER;
+
+        // Part of the input this Video processes (see SegmentRunner): decoding starts at the
+        // keyframe at segment_start and stops before segment_end, both in the input stream's
+        // time base, AV_NOPTS_VALUE for open ends. Output frames are numbered from first_frame,
+        // and encoded with that number plus pts_offset as their pts. Segment workers write video
+        // only and leave progress reporting to the runner, which follows them through `encoded`
+        // and, when set, on_encoded, called on the encoding thread after every frame.
+        int64_t segment_start = AV_NOPTS_VALUE;
+        int64_t segment_end = AV_NOPTS_VALUE;
+        long first_frame = 0;
+        long pts_offset = 0;
+        bool with_audio = true;
+        bool global_header = false;
+        bool report_progress = true;
+        std::atomic<long>* encoded = nullptr;
+        std::function<void()> on_encoded;
         
         int video_stream_index = -1;
 
+        Backend backend = Backend::OpenGL;
+        CpuRemapper cpu_remapper;
+        bool planar = false;
+        PlanarRemapper planar_remapper;
+        // Tiled mode (see TiledRemapper): the planar pipeline with a plan-free remap over bands
+        // of the frame, chosen with `tiled` or for the current file alone when it exceeds
+        // GL_MAX_TEXTURE_SIZE. memory_budget caps the bytes of the frames it keeps in flight,
+        // 0 for no cap; a small budget lowers the queue depth and then turns pipelining off.
+        bool tiled = false;
+        bool exceeds_gl = false;
+        size_t memory_budget = 0;
+        int budget_depth = -1;
+        TiledRemapper tiled_remapper;
+        PixelTransferRing transfer_ring;
+        BatchRenderer batch_renderer;
+        // GL path in YUV (see YuvRenderer), for decoded formats it supports; the RGB path
+        // takes over for the current file alone otherwise.
+        bool gpu_yuv = false;
+        bool yuv_fallback = false;
+        YuvRenderer yuv_renderer;
+        AudioTrack audio;
+        EncoderProfile encoder_profile;
+        Telemetry telemetry;
+        // Inline PSNR/SSIM of sampled frames against their reconstruction; quality.interval
+        // > 0 turns it on.
+        QualityMeter quality;
+        int gl_ring_depth = 3;
+        int gl_batch = 1;
+        long polls = 0;
+
+        std::vector<TransformScratch> scratch;
+        AVPacket* out_packet = nullptr;
+        std::vector<AVFrame*> output_frames;
+
+        bool pipelined = true;
+        int queue_depth = 8;
+        bool print_queue_stats = false;
+        QueueStats decoded_stats;
+        QueueStats transformed_stats;
+        QueueStats reorder_stats;
+        int workers = 1;
+        bool planar_needs_conversion = false;
+        bool planar_full_range = false;
+        std::vector<float> offset_map;
+        MapFormat map_format = MapFormat::Float;
+        std::vector<uint32_t> tile_map;
+        std::string map_cache_dir;
+        int map_width = 80;
+        int map_height = 80;
+        // Applies the inverse permutation, restoring a video shuffled with the same seed.
+        bool unshuffle = false;
+        // Map rotation (see MapRotation): a new permutation every rotate_every frames or at
+        // every keyframe of the input, keyed by the seed and the period's index. Periods are
+        // counted from the start of the input, so a segment picks up where it lies. Keyframe
+        // rotations also start a GOP in the output, which is what lets the unshuffle find them
+        // again, as long as the encoder adds no keyframes of its own.
+        RotationMode rotate_mode = RotationMode::Off;
+        int rotate_every = 0;
+        int rotate_ahead = 3;
+        MapRotation rotation;
+        std::shared_ptr<const RotatedMap> rotation_map;
+        long rotation_frames = 0;
+        long rotation_keyframes = 0;
+        long rotations = 0;
+        long gl_rotation = -1;
+        double rotation_swap_ms = 0.0;
+
+        // What the warm state was built for. A Video can process several files in turn (see
+        // JobRunner); Start() only rebuilds what the new file's seed or resolution changes.
+        std::string map_seed;
+        std::string plan_key;
+        std::string gl_map_seed;
+        int gl_width = 0;
+        int gl_height = 0;
+        AVPixelFormat gl_pix_fmt = AV_PIX_FMT_NONE;
+        bool map_reused = false;
+        bool gl_reused = false;
+        double setup_ms = 0.0;
+
         int frame_width;
         int frame_height;
         double fps;
@@ -30,6 +149,13 @@ namespace UnsafeYT {
 
         const char* vertexShaderSource;
         const char* fragmentShaderSource;
+        const char* indexFragmentShaderSource = nullptr;
+        const char* batchVertexShaderSource = nullptr;
+        const char* batchGeometryShaderSource = nullptr;
+        const char* batchFragmentShaderSource = nullptr;
+        const char* batchIndexFragmentShaderSource = nullptr;
+        const char* yuvFragmentShaderSource = nullptr;
+        const char* yuvIndexFragmentShaderSource = nullptr;
         std::string inpath;
         std::string outpath;
         std::string seed;
@@ -40,7 +166,7 @@ namespace UnsafeYT {
             const std::string& inpath,
             const std::string& outpath,
             const std::string& seed
-        ) : window(nullptr), shaderProgram(0), in_fmt_ctx(nullptr), out_fmt_ctx(nullptr), in_frame(nullptr), in_packet(nullptr), sws_ctx(nullptr), out_sws_ctx(nullptr), frame_width(0), frame_height(0), fps(0.0), framesOveral(0), frameCount(0) {
+        ) : shaderProgram(0), in_fmt_ctx(nullptr), out_fmt_ctx(nullptr), in_frame(nullptr), in_packet(nullptr), frame_width(0), frame_height(0), fps(0.0), framesOveral(0), frameCount(0) {
             this->vertexShaderSource = vertexShaderSource;
             this->fragmentShaderSource = fragmentShaderSource;
             this->inpath = inpath;
@@ -49,67 +175,161 @@ namespace UnsafeYT {
         }
 
         ~Video() {
+            this->Close();
+            for (TransformScratch& s : scratch) {
+                if (s.sws_ctx) sws_freeContext(s.sws_ctx);
+                if (s.out_sws_ctx) sws_freeContext(s.out_sws_ctx);
+            }
+
+            // The transfer ring and the batch and YUV renderers free GL objects in Release(),
+            // so they go while the context is still current, before it is destroyed.
+            if (gl_context.Active()) {
+                this->ReleaseFrameTargets();
+                glDeleteTextures(1, &offsetMapTexture);
+                glDeleteVertexArrays(1, &VAO);
+                glDeleteBuffers(1, &VBO);
+                glDeleteProgram(shaderProgram);
+                if (yuvProgram) glDeleteProgram(yuvProgram);
+            }
+            gl_context.Destroy();
+        }
+
+        // Frees everything that belongs to the current file. The GL context and objects, the
+        // conversion contexts, the offset map and the remap plans stay for the next one.
+        void Close() {
             if (in_frame) av_frame_free(&in_frame);
             if (in_packet) av_packet_free(&in_packet);
-            if (sws_ctx) sws_freeContext(sws_ctx);
-            if (out_sws_ctx) sws_freeContext(out_sws_ctx);
-            
+            if (out_packet) av_packet_free(&out_packet);
+            for (AVFrame*& frame : output_frames) {
+                av_frame_free(&frame);
+            }
+            output_frames.clear();
+            for (TransformScratch& s : scratch) {
+                av_frame_free(&s.rgb_frame);
+                av_frame_free(&s.processed_rgb_frame);
+                av_frame_free(&s.planar_frame);
+                s.map.reset();
+            }
+            rotation.Stop();
+            rotation_map.reset();
+            rotation_frames = 0;
+            rotation_keyframes = 0;
+            rotations = 0;
+            gl_rotation = -1;
+            rotation_swap_ms = 0.0;
+            quality.Close();
+
             if (in_codec_ctx) avcodec_free_context(&in_codec_ctx);
             if (out_codec_ctx) avcodec_free_context(&out_codec_ctx);
 
-            if (out_fmt_ctx && !(out_fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+            if (out_fmt_ctx && !(out_fmt_ctx->flags & AVFMT_FLAG_CUSTOM_IO) && !(out_fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
                 avio_closep(&out_fmt_ctx->pb);
             }
             if (out_fmt_ctx) avformat_free_context(out_fmt_ctx);
-            
+            out_fmt_ctx = nullptr;
+            out_stream = nullptr;
+            PipeIO::Close(&out_io);
+
             if (in_fmt_ctx) avformat_close_input(&in_fmt_ctx);
+            PipeIO::Close(&in_io);
+            audio.Close();
 
+            // A file that failed halfway can leave frames in flight; start the next one clean.
+            if (gl_context.Active() && (!transfer_ring.Empty() || !yuv_renderer.Empty() || !batch_renderer.Empty() || batch_renderer.Filling())) {
+                this->ReleaseFrameTargets();
+            }
+
+            video_stream_index = -1;
+            exceeds_gl = false;
+            yuv_fallback = false;
+            budget_depth = -1;
+            framesOveral = 0;
+            frameCount = 0;
+            polls = 0;
+        }
+
+        // GL objects sized for the frame: render target, input texture and transfer buffers.
+        void ReleaseFrameTargets() {
+            transfer_ring.Release();
+            yuv_renderer.Release();
+            batch_renderer.Release();
             glDeleteFramebuffers(1, &fbo);
             glDeleteTextures(1, &fboTexture);
             glDeleteTextures(1, &inputTexture);
-            glDeleteTextures(1, &offsetMapTexture);
-            glDeleteVertexArrays(1, &VAO);
-            glDeleteBuffers(1, &VBO);
-            glDeleteProgram(shaderProgram);
-            if (window) {
-                glfwDestroyWindow(window);
-            }
-            glfwTerminate();
+            fbo = 0;
+            fboTexture = 0;
+            inputTexture = 0;
+            gl_width = 0;
+            gl_height = 0;
+            gl_pix_fmt = AV_PIX_FMT_NONE;
         }
 
-        int Start() {
-            if (!glfwInit()) {
-                std::cerr << "Failed to initialize GLFW" << std::endl;
+        // Creates the context, program and quad on first use, then brings the offset map and
+        // the frame-sized objects up to date for the current file.
+        int InitOpenGL() {
+            this->gl_reused = this->gl_context.Active();
+            if (!this->gl_reused && this->CreateGL() != 0) {
                 return -1;
             }
 
-            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            GLint max_size = 0;
+            glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+            if (this->frame_width > max_size || this->frame_height > max_size) {
+                std::cerr << "Warning: " << this->frame_width << "x" << this->frame_height << " exceeds GL_MAX_TEXTURE_SIZE (" << max_size
+                          << "); processing this file in tiles on the CPU." << std::endl;
+                this->exceeds_gl = true;
+                return 0;
+            }
+            if (this->gpu_yuv && !this->Batched() && !YuvRenderer::Supports(in_codec_ctx->pix_fmt)) {
+                std::cerr << "Warning: The GL YUV path does not take " << av_get_pix_fmt_name(in_codec_ctx->pix_fmt)
+                          << " frames; converting this file to RGB on the CPU." << std::endl;
+                this->yuv_fallback = true;
+            }
 
-            this->window = glfwCreateWindow(1, 1, "OpenGL Context", NULL, NULL);
-            if (!window) {
-                std::cerr << "Failed to create GLFW window or OpenGL context" << std::endl;
-                glfwTerminate();
-                return -1;
+            if (this->gl_map_seed != this->map_seed) {
+                this->UploadOffsetMap(this->offset_map, this->tile_map);
+                this->gl_map_seed = this->map_seed;
+            }
+
+            // The YUV targets also depend on the decoded layout.
+            AVPixelFormat upload_fmt = this->GpuYuv() ? in_codec_ctx->pix_fmt : AV_PIX_FMT_RGB24;
+            if (this->gl_width != this->frame_width || this->gl_height != this->frame_height || this->gl_pix_fmt != upload_fmt) {
+                this->ReleaseFrameTargets();
+                if (this->CreateFrameTargets() != 0) {
+                    return -1;
+                }
+                this->gl_width = this->frame_width;
+                this->gl_height = this->frame_height;
+                this->gl_pix_fmt = upload_fmt;
+            }
+            if (this->GpuYuv()) {
+                this->yuv_renderer.Configure(in_codec_ctx->colorspace, PlanarRemapper::IsFullRange(in_codec_ctx->pix_fmt, in_codec_ctx->color_range), false);
             }
-            glfwMakeContextCurrent(this->window);
+            return 0;
+        }
 
-            glewExperimental = GL_TRUE;
-            if (glewInit() != GLEW_OK) {
-                std::cerr << "Failed to initialize GLEW" << std::endl;
-                glfwDestroyWindow(this->window);
-                glfwTerminate();
+        int CreateGL() {
+            if (this->gl_context.Create(this->context_backend) != 0) {
                 return -1;
             }
+            this->gl_map_seed.clear();
+            this->gl_width = 0;
+            this->gl_height = 0;
 
             glViewport(0, 0, 1, 1);
 
-            this->shaderProgram = UnsafeYT::createShaderProgram(this->vertexShaderSource, this->fragmentShaderSource);
-            if (this->shaderProgram == 0) {
-                glfwDestroyWindow(this->window);
-                glfwTerminate();
+            bool index = this->map_format == MapFormat::Index;
+            if (this->Batched()) {
+                this->shaderProgram = UnsafeYT::createShaderProgram(this->batchVertexShaderSource, this->batchGeometryShaderSource,
+                                                                    index ? this->batchIndexFragmentShaderSource : this->batchFragmentShaderSource);
+            } else {
+                this->shaderProgram = UnsafeYT::createShaderProgram(this->vertexShaderSource, index ? this->indexFragmentShaderSource : this->fragmentShaderSource);
+            }
+            if (this->gpu_yuv && !this->Batched()) {
+                this->yuvProgram = UnsafeYT::createShaderProgram(this->vertexShaderSource, index ? this->yuvIndexFragmentShaderSource : this->yuvFragmentShaderSource);
+            }
+            if (this->shaderProgram == 0 || (this->gpu_yuv && !this->Batched() && this->yuvProgram == 0)) {
+                this->gl_context.Destroy();
                 return -1;
             }
 
@@ -134,8 +354,184 @@ namespace UnsafeYT {
             glBindBuffer(GL_ARRAY_BUFFER, 0);
             glBindVertexArray(0);
 
-            if (avformat_open_input(&in_fmt_ctx, this->inpath.c_str(), NULL, NULL) != 0) {
-                std::cerr << "Error: Could not open input video file with FFmpeg." << std::endl;
+            glGenTextures(1, &this->offsetMapTexture);
+            return 0;
+        }
+
+        // Holds the tile map instead in index mode: 16-bit indices while the grid has at
+        // most 65536 cells, 32-bit beyond that.
+        void UploadOffsetMap(const std::vector<float>& offset_map, const std::vector<uint32_t>& tile_map) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glBindTexture(GL_TEXTURE_2D, this->offsetMapTexture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            if (this->map_format == MapFormat::Index && tile_map.size() <= 65536) {
+                std::vector<uint16_t> indices(tile_map.begin(), tile_map.end());
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, this->map_width, this->map_height, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, indices.data());
+            } else if (this->map_format == MapFormat::Index) {
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, this->map_width, this->map_height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, tile_map.data());
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, this->map_width, this->map_height, 0, GL_RG, GL_FLOAT, offset_map.data());
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+
+        int CreateFrameTargets() {
+            UnsafeYT::configureRemapProgram(this->shaderProgram, this->frame_width, this->frame_height, this->map_width, this->map_height);
+            if (this->Batched()) {
+                return this->batch_renderer.Init(this->frame_width, this->frame_height, this->gl_batch);
+            }
+            if (this->GpuYuv()) {
+                UnsafeYT::configureRemapProgram(this->yuvProgram, this->frame_width, this->frame_height, this->map_width, this->map_height);
+                return this->yuv_renderer.Init(this->yuvProgram, in_codec_ctx->pix_fmt, AV_PIX_FMT_YUV420P, this->frame_width, this->frame_height, this->gl_ring_depth);
+            }
+
+            glGenTextures(1, &this->fboTexture);
+            glBindTexture(GL_TEXTURE_2D, this->fboTexture);
+            this->AllocateTexture(GL_RGB8, this->frame_width, this->frame_height);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glGenFramebuffers(1, &this->fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->fboTexture, 0);
+
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                std::cerr << "ERROR::FRAMEBUFFER:: Framebuffer is not complete! Status: " << glCheckFramebufferStatus(GL_FRAMEBUFFER) << std::endl;
+                return -1;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            glGenTextures(1, &this->inputTexture);
+            glBindTexture(GL_TEXTURE_2D, this->inputTexture);
+            this->AllocateTexture(GL_RGB8, this->frame_width, this->frame_height);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+            if (this->transfer_ring.Init(this->frame_width, this->frame_height, this->gl_ring_depth) != 0) {
+                return -1;
+            }
+
+            return 0;
+        }
+
+        // Allocates storage for the bound texture once; frames are then streamed in with
+        // glTexSubImage2D instead of reallocating the texture every frame.
+        void AllocateTexture(GLenum internal_format, int width, int height) {
+            if (GLEW_ARB_texture_storage) {
+                glTexStorage2D(GL_TEXTURE_2D, 1, internal_format, width, height);
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+            }
+        }
+
+        // Fragmented MP4 for the MOV-family muxers: an empty moov up front, then self-contained
+        // fragments that each start at a keyframe. Other muxers get no options.
+        static AVDictionary* MuxerOptions(const AVOutputFormat* out_fmt, int fragment_ms, bool pipe_out) {
+            AVDictionary* options = nullptr;
+            int fragment = fragment_ms > 0 ? fragment_ms : pipe_out ? 1000 : 0;
+            bool mov = out_fmt->priv_class && av_opt_find(const_cast<AVClass**>(&out_fmt->priv_class), "movflags", NULL, 0, AV_OPT_SEARCH_FAKE_OBJ);
+            if (fragment > 0 && mov) {
+                av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+                av_dict_set(&options, "min_frag_duration", std::to_string(int64_t(fragment) * 1000).c_str(), 0);
+            } else if (fragment_ms > 0) {
+                std::cerr << "Warning: The " << out_fmt->name << " muxer has no fragments; ignoring the fragment duration." << std::endl;
+            }
+            return options;
+        }
+
+        // Picks the encoder pixel format for planar mode. YUV sources the remappers take
+        // natively (see YuvLayout) are encoded in their own layout and bit depth, so frames go
+        // straight from decoder to encoder. When the encoder lacks that layout the scratch
+        // sws_ctx converts once: to the planar format of the same depth and subsampling, then
+        // to 4:2:0 of that depth, and to yuv420p as the last resort. The colour description is
+        // the source's either way, as none of these conversions changes the colour space.
+        int SetupPlanar(const AVCodec* out_codec) {
+            AVPixelFormat decoded = in_codec_ctx->pix_fmt;
+            AVPixelFormat encoded = AV_PIX_FMT_YUV420P;
+            auto supported = [out_codec](AVPixelFormat pix_fmt) {
+                if (pix_fmt == AV_PIX_FMT_NONE) return false;
+                if (!out_codec->pix_fmts) return true;
+                for (const AVPixelFormat* p = out_codec->pix_fmts; *p != AV_PIX_FMT_NONE; p++) {
+                    if (*p == pix_fmt) return true;
+                }
+                return false;
+            };
+
+            YuvLayout layout;
+            if (PlanarRemapper::Describe(decoded, layout)) {
+                AVPixelFormat native = decoded;
+                switch (decoded) {
+                    case AV_PIX_FMT_YUVJ420P: native = AV_PIX_FMT_YUV420P; break;
+                    case AV_PIX_FMT_YUVJ422P: native = AV_PIX_FMT_YUV422P; break;
+                    case AV_PIX_FMT_YUVJ444P: native = AV_PIX_FMT_YUV444P; break;
+                    default: break;
+                }
+                for (AVPixelFormat candidate : {native, PlanarRemapper::PlanarFormat(layout.depth, layout.log2_chroma_w, layout.log2_chroma_h),
+                                                PlanarRemapper::PlanarFormat(layout.depth, 1, 1)}) {
+                    if (supported(candidate)) {
+                        encoded = candidate;
+                        break;
+                    }
+                }
+            }
+            if (layout.depth > 8 && av_pix_fmt_desc_get(encoded)->comp[0].depth == 8) {
+                std::cerr << "Warning: " << out_codec->name << " takes no " << layout.depth << "-bit format; encoding "
+                          << av_get_pix_fmt_name(decoded) << " as yuv420p." << std::endl;
+            }
+
+            this->planar_needs_conversion = !PlanarRemapper::SameLayout(decoded, encoded);
+            this->planar_full_range = !this->planar_needs_conversion && PlanarRemapper::IsFullRange(decoded, in_codec_ctx->color_range);
+
+            out_codec_ctx->pix_fmt = encoded;
+            out_codec_ctx->color_range = this->planar_full_range ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+            out_codec_ctx->color_primaries = in_codec_ctx->color_primaries;
+            out_codec_ctx->color_trc = in_codec_ctx->color_trc;
+            out_codec_ctx->colorspace = in_codec_ctx->colorspace;
+            out_codec_ctx->chroma_sample_location = in_codec_ctx->chroma_sample_location;
+            return 0;
+        }
+
+        // Frame-level colour description and HDR metadata of a decoded frame, carried over by
+        // the planar paths. Pooled output frames drop what the previous frame left on them.
+        static void CopyColour(const AVFrame* src, AVFrame* dst) {
+            dst->color_primaries = src->color_primaries;
+            dst->color_trc = src->color_trc;
+            dst->colorspace = src->colorspace;
+            dst->chroma_location = src->chroma_location;
+            for (AVFrameSideDataType type : {AV_FRAME_DATA_MASTERING_DISPLAY_METADATA, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL}) {
+                av_frame_remove_side_data(dst, type);
+                const AVFrameSideData* data = av_frame_get_side_data(src, type);
+                AVFrameSideData* copy = data ? av_frame_new_side_data(dst, type, data->size) : nullptr;
+                if (copy) {
+                    std::memcpy(copy->data, data->data, data->size);
+                }
+            }
+        }
+
+        // Opens the input and its decoder and seeks to the segment start.
+        int OpenInput() {
+            const AVInputFormat* in_fmt = nullptr;
+            if (!this->input_format.empty() && !(in_fmt = av_find_input_format(this->input_format.c_str()))) {
+                std::cerr << "Error: Unknown input format '" << this->input_format << "'." << std::endl;
+                return -1;
+            }
+            bool pipe_in = PipeIO::IsPipe(this->inpath);
+            if (pipe_in) {
+                in_fmt_ctx = avformat_alloc_context();
+                this->in_io = PipeIO::OpenInput(this->io_buffer_size);
+                if (!in_fmt_ctx || !this->in_io) {
+                    std::cerr << "Error: Failed to set up reading from stdin." << std::endl;
+                    return -1;
+                }
+                in_fmt_ctx->pb = this->in_io;
+                in_fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+            }
+            if (avformat_open_input(&in_fmt_ctx, pipe_in ? "pipe:" : this->inpath.c_str(), in_fmt, NULL) != 0) {
+                std::cerr << "Error: Could not open input video " << (pipe_in ? "stream" : "file") << " with FFmpeg." << std::endl;
                 return -1;
             }
 
@@ -167,10 +563,15 @@ namespace UnsafeYT {
                 return -1;
             }
             avcodec_parameters_to_context(in_codec_ctx, in_fmt_ctx->streams[video_stream_index]->codecpar);
+            this->encoder_profile.ConfigureDecoder(in_codec_ctx);
             if (avcodec_open2(in_codec_ctx, in_codec, NULL) < 0) {
                 std::cerr << "Error: Could not open codec." << std::endl;
                 return -1;
             }
+            if (this->segment_start != AV_NOPTS_VALUE && av_seek_frame(in_fmt_ctx, video_stream_index, this->segment_start, AVSEEK_FLAG_BACKWARD) < 0) {
+                std::cerr << "Error: Could not seek to the segment start." << std::endl;
+                return -1;
+            }
 
             this->frame_width = in_codec_ctx->width;
             this->frame_height = in_codec_ctx->height;
@@ -186,74 +587,78 @@ namespace UnsafeYT {
                 std::cerr << "Error: Failed to allocate frame or packet." << std::endl;
                 return -1;
             }
+            return 0;
+        }
 
-            sws_ctx = sws_getContext(
-                this->frame_width, this->frame_height, in_codec_ctx->pix_fmt,
-                this->frame_width, this->frame_height, AV_PIX_FMT_RGB24,
-                SWS_POINT, NULL, NULL, NULL
-            );
-            if (!sws_ctx) {
-                std::cerr << "Error: Cannot create SwsContext for color conversion." << std::endl;
-                return -1;
-            }
+        // Direction and seed the offset map is generated for.
+        std::string MapKey() const {
+            return this->unshuffle ? this->seed + "\nunshuffle" : this->seed;
+        }
 
-            int map_width = 80;
-            int map_height = 80;
-            std::pair<std::vector<float>, std::vector<float>> offset_maps;
+        int LoadOffsetMap(bool& map_cached) {
+            map_cached = false;
+            this->map_reused = !this->offset_map.empty() && this->map_seed == this->MapKey();
+            if (this->map_reused) {
+                return 0;
+            }
             try {
-                offset_maps = UnsafeYT::generate_offset_maps(map_width, map_height, this->seed);
+                // An empty map_cache_dir disables the cache.
+                std::unique_ptr<OffsetMapCache> cache;
+                if (!this->map_cache_dir.empty()) {
+                    cache = std::make_unique<OffsetMapCache>(this->map_cache_dir);
+                }
+                MapDirection direction = this->unshuffle ? MapDirection::Unshuffle : MapDirection::Shuffle;
+                this->offset_map = UnsafeYT::load_offset_map(cache.get(), map_width, map_height, this->seed, direction, &map_cached);
+                if (this->map_format == MapFormat::Index) {
+                    this->tile_map = UnsafeYT::offsets_to_tile_map(this->offset_map, map_width, map_height);
+                }
+                this->map_seed = this->MapKey();
             }
             catch (const std::runtime_error& e) {
                 std::cerr << "Error generating offset maps: " << e.what() << std::endl;
                 return -1;
             }
+            return 0;
+        }
 
-            bool applyShuffleEffect = true;
-            std::vector<float>& current_offset_map_data = applyShuffleEffect ? offset_maps.first : offset_maps.second;
-
-            glGenTextures(1, &this->offsetMapTexture);
-            glBindTexture(GL_TEXTURE_2D, this->offsetMapTexture);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, map_width, map_height, 0, GL_RG, GL_FLOAT, current_offset_map_data.data());
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-            glGenTextures(1, &this->fboTexture);
-            glBindTexture(GL_TEXTURE_2D, this->fboTexture);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, this->frame_width, this->frame_height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glGenFramebuffers(1, &this->fbo);
-            glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->fboTexture, 0);
+        int Start() {
+            this->Close();
+            this->map_reused = false;
+            this->gl_reused = false;
+            this->setup_ms = 0.0;
+            auto setup_started = std::chrono::steady_clock::now();
+            if (this->OpenInput() != 0) {
+                return -1;
+            }
 
-            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-                std::cerr << "ERROR::FRAMEBUFFER:: Framebuffer is not complete! Status: " << glCheckFramebufferStatus(GL_FRAMEBUFFER) << std::endl;
+            bool map_cached = false;
+            if (this->LoadOffsetMap(map_cached) != 0) {
                 return -1;
             }
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-            glGenTextures(1, &this->inputTexture);
-            glBindTexture(GL_TEXTURE_2D, this->inputTexture);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            if (this->backend == Backend::OpenGL && !this->planar && !this->tiled && this->InitOpenGL() != 0) {
+                return -1;
+            }
 
-            const char* output_filename = this->outpath.c_str();
-            const AVOutputFormat* out_fmt = av_guess_format(NULL, output_filename, NULL);
+            bool pipe_out = PipeIO::IsPipe(this->outpath);
+            const char* output_filename = pipe_out ? "pipe:" : this->outpath.c_str();
+            const char* format_name = !this->output_format.empty() ? this->output_format.c_str() : pipe_out ? "mp4" : NULL;
+            const AVOutputFormat* out_fmt = av_guess_format(format_name, pipe_out ? NULL : output_filename, NULL);
             if (!out_fmt) {
-                std::cerr << "Error: Could not guess output format." << std::endl;
+                std::cerr << "Error: " << (format_name ? "Unknown output format '" + std::string(format_name) + "'." : std::string("Could not guess output format.")) << std::endl;
                 return -1;
             }
             if (avformat_alloc_output_context2(&out_fmt_ctx, out_fmt, NULL, output_filename) < 0) {
                 std::cerr << "Error: Could not create output context." << std::endl;
                 return -1;
             }
-            const AVCodec* out_codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+            const AVCodec* out_codec = avcodec_find_encoder_by_name(this->encoder_profile.codec.c_str());
             if (!out_codec) {
-                std::cerr << "Error: Could not find H.264 encoder." << std::endl;
+                std::cerr << "Error: Could not find encoder '" << this->encoder_profile.codec << "'." << std::endl;
+                return -1;
+            }
+            if (avformat_query_codec(out_fmt, out_codec->id, FF_COMPLIANCE_NORMAL) == 0) {
+                std::cerr << "Error: The " << out_fmt->name << " container cannot hold " << out_codec->name << " video." << std::endl;
                 return -1;
             }
 
@@ -272,190 +677,1067 @@ namespace UnsafeYT {
             out_codec_ctx->width = this->frame_width;
             out_codec_ctx->height = this->frame_height;
             out_codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P; 
+            if (this->PlanarPath() && this->SetupPlanar(out_codec) != 0) {
+                return -1;
+            }
+            const AVPixFmtDescriptor* in_desc = av_pix_fmt_desc_get(in_codec_ctx->pix_fmt);
+            if (!this->PlanarPath() && in_desc && in_desc->comp[0].depth > 8) {
+                std::cerr << "Warning: The RGB path encodes " << av_get_pix_fmt_name(in_codec_ctx->pix_fmt)
+                          << " as 8-bit yuv420p; --planar or --tiled keep its bit depth." << std::endl;
+            }
             //out_codec_ctx->pix_fmt = AV_PIX_FMT_YUV444P; 
             out_codec_ctx->time_base = (AVRational){1, (int)this->fps};
-            out_codec_ctx->gop_size = 5;
-            out_codec_ctx->max_b_frames = 2;
-            out_codec_ctx->bit_rate = 64'000'000;
-
-            AVDictionary* codec_options = nullptr;
-            av_dict_set(&codec_options, "preset", "ultrafast", 0);
-            av_dict_set(&codec_options, "crf", "0", 0);
-            av_dict_set(&codec_options, "qp", "0", 0);
-
-            avcodec_open2(out_codec_ctx, out_codec, &codec_options);
-            av_dict_free(&codec_options);
-
-            if (out_fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
+            this->encoder_profile.ConfigureEncoder(out_codec_ctx);
+            if ((out_fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER) || this->global_header) {
                 out_codec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
             }
-            if (avcodec_open2(out_codec_ctx, out_codec, NULL) < 0) {
+
+            this->quality.Configure(out_codec_ctx);
+            AVDictionary* codec_options = this->encoder_profile.EncoderOptions();
+            if (avcodec_open2(out_codec_ctx, out_codec, &codec_options) < 0) {
                 std::cerr << "Error: Could not open output codec." << std::endl;
+                av_dict_free(&codec_options);
                 return -1;
             }
+            this->encoder_profile.Print(std::cout, in_codec_ctx, out_codec_ctx, codec_options);
+            av_dict_free(&codec_options);
             avcodec_parameters_from_context(out_stream->codecpar, out_codec_ctx);
+            if (this->quality.interval > 0) {
+                this->quality.on_frame = [this](const FrameQuality& quality) {
+                    if (this->report_progress) this->telemetry.Quality(quality);
+                };
+                this->quality.Open(out_codec_ctx, out_stream->codecpar);
+            }
 
-            if (!(out_fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+            // A pipe can only be read once, so its audio cannot be demuxed a second time.
+            bool pipe_in = PipeIO::IsPipe(this->inpath);
+            if (this->with_audio && this->audio.Open(pipe_in ? "" : this->inpath, out_fmt_ctx) != 0) {
+                return -1;
+            }
+
+            if (pipe_out) {
+                this->out_io = PipeIO::OpenOutput(this->io_buffer_size);
+                if (!this->out_io) {
+                    std::cerr << "Error: Failed to set up writing to stdout." << std::endl;
+                    return -1;
+                }
+                out_fmt_ctx->pb = this->out_io;
+                out_fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+            } else if (!(out_fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
                 if (avio_open(&out_fmt_ctx->pb, output_filename, AVIO_FLAG_WRITE) < 0) {
                     std::cerr << "Error: Could not open output file '" << output_filename << "'." << std::endl;
                     return -1;
                 }
             }
-            avformat_write_header(out_fmt_ctx, NULL);
+            AVDictionary* muxer_options = MuxerOptions(out_fmt, this->fragment_ms, pipe_out);
+            int header = avformat_write_header(out_fmt_ctx, &muxer_options);
+            av_dict_free(&muxer_options);
+            if (header < 0) {
+                std::cerr << "Error: Could not write the " << out_fmt->name << " header"
+                          << (pipe_out ? "; pipe output needs a streaming format such as mp4 or mpegts." : ".") << std::endl;
+                return -1;
+            }
+
+            if (this->AllocateFrames() != 0) {
+                return -1;
+            }
+
+            std::cout << "Starting video processing..." << std::endl;
+            std::cout << "Applying " << (this->unshuffle ? "Unshuffle" : "Shuffle") << " effect." << std::endl;
+            std::cout << "Offset map dimensions: " << map_width << "x" << map_height << (this->map_reused ? " (reused)" : map_cached ? " (cached)" : "")
+                      << (this->map_format == MapFormat::Index ? ", integer tile indices" : ", float offsets") << std::endl;
+            if (this->rotate_mode == RotationMode::Frames) {
+                std::cout << "Map rotation: every " << this->rotate_every << " frames, " << this->rotate_ahead << " or more maps built ahead" << std::endl;
+            } else if (this->rotate_mode == RotationMode::Keyframes) {
+                std::cout << "Map rotation: at every keyframe, " << this->rotate_ahead << " or more maps built ahead" << std::endl;
+            }
+            if (this->rotate_mode != RotationMode::Off && std::thread::hardware_concurrency() <= 1) {
+                std::cerr << "Warning: With one core, map builds for --rotate take time from the frame loop; short periods slow processing noticeably." << std::endl;
+            }
+            if (this->Tiled()) {
+                std::cout << "Transform backend: tiled " << av_get_pix_fmt_name(out_codec_ctx->pix_fmt) << ", CPU, " << this->tiled_remapper.Bands() << " bands on " << std::max(this->workers, 1) << " threads, "
+                          << (this->planar_needs_conversion ? "one input conversion" : "no colour conversion") << std::endl;
+            } else if (this->planar) {
+                std::cout << "Transform backend: planar " << av_get_pix_fmt_name(out_codec_ctx->pix_fmt) << ", CPU (" << remap_kernel_name(this->planar_remapper.kernel) << "), "
+                          << (this->planar_needs_conversion ? "one input conversion" : "no colour conversion") << std::endl;
+            } else if (this->backend == Backend::CPU) {
+                std::cout << "Transform backend: CPU (" << remap_kernel_name(this->cpu_remapper.kernel) << ")" << std::endl;
+            } else {
+                std::cout << "Transform backend: OpenGL (" << context_backend_name(this->gl_context.backend) << " context"
+                          << (this->gl_reused ? ", reused" : "") << ")";
+                if (this->Batched()) {
+                    std::cout << ", batches of " << this->batch_renderer.BatchSize() << " frames";
+                } else if (this->GpuYuv()) {
+                    std::cout << ", YUV planes, no CPU colour conversion";
+                }
+                std::cout << std::endl;
+            }
+            if (this->UsesWorkerPool()) {
+                std::cout << "Transform workers: " << this->scratch.size() << std::endl;
+            }
+            if (this->quality.Active()) {
+                std::cout << "Quality metrics: every " << this->quality.interval << " frames, against the "
+                          << (this->quality.FromEncoder() ? "encoder's reconstruction" : "decoded output") << " (" << remap_kernel_name(this->quality.kernel) << ")" << std::endl;
+            }
+
+            auto started = std::chrono::steady_clock::now();
+            this->setup_ms = std::chrono::duration<double, std::milli>(started - setup_started).count();
+            if (this->report_progress) {
+                this->telemetry.Start(this->framesOveral, this->fps, this->frame_width, this->frame_height);
+            }
+            this->Process();
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            std::cout << "Finished processing. Total frames written: " << this->frameCount << std::endl;
+            if (elapsed > 0.0) {
+                std::cout << "Processing time: " << elapsed << " s (" << this->frameCount / elapsed << " fps)" << std::endl;
+            }
+            if (this->rotate_mode != RotationMode::Off) {
+                // What the frame loop spent on rotation: waiting for a map, and swapping GL textures.
+                double rotation_ms = this->rotation.StallMs() + this->rotation_swap_ms;
+                std::cout << "Map rotation: " << this->rotations << " rotations, " << this->rotation.Stalls() << " stalls, "
+                          << rotation_ms << " ms in the frame loop";
+                if (elapsed > 0.0) {
+                    std::cout << " (" << rotation_ms / (elapsed * 10.0) << "% of processing time)";
+                }
+                std::cout << std::endl;
+                std::cout << "Map builds: " << this->rotation.Builds() << " maps in " << this->rotation.BuildMs() << " ms on the builder thread, up to "
+                          << this->rotation.Deepest() << " built ahead" << std::endl;
+            }
+            if (this->quality.Active()) {
+                this->PrintQuality(elapsed);
+            }
+            this->audio.Finish(this->frameCount * av_q2d(out_codec_ctx->time_base));
+            av_write_trailer(out_fmt_ctx);
+            if (!this->report_progress) {
+                return 0;
+            }
+            if (this->telemetry.enabled) {
+                this->telemetry.Done(true, this->frameCount);
+            } else {
+                std::cout << 100 << std::endl;
+            }
+
+            return 0;
+        }
+
+        void PrintQuality(double elapsed) {
+            QualitySummary summary = this->quality.Summary();
+            static const char* names[] = {"y", "u", "v"};
+            std::cout << "Quality: " << summary.frames << " frames measured";
+            if (summary.skipped > 0) std::cout << ", " << summary.skipped << " skipped";
+            std::cout << std::endl << "  PSNR";
+            for (int c = 0; c < summary.planes; c++) std::cout << " " << names[c] << " " << summary.psnr[c];
+            std::cout << " all " << summary.psnr_all << " dB (mean " << summary.psnr_mean << ", min " << summary.psnr_min << ")" << std::endl << "  SSIM";
+            for (int c = 0; c < summary.planes; c++) std::cout << " " << names[c] << " " << summary.ssim[c];
+            std::cout << " all " << summary.ssim_all << " (min " << summary.ssim_min << ")" << std::endl;
+            std::cout << "  overhead " << summary.overhead_ms << " ms";
+            if (elapsed > 0.0) {
+                std::cout << " (" << summary.overhead_ms / (elapsed * 10.0) << "% of processing time)";
+            }
+            std::cout << std::endl;
+            if (this->report_progress) {
+                this->telemetry.Quality(summary);
+            }
+        }
+
+        void DrawFrame() {
+            glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+            glViewport(0, 0, this->frame_width, this->frame_height);
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            glUseProgram(this->shaderProgram);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, this->inputTexture);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, this->offsetMapTexture);
+
+            glBindVertexArray(this->VAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+        }
+
+        static AVFrame* AllocateFrame(int format, int width, int height) {
+            AVFrame* frame = av_frame_alloc();
+            if (!frame) {
+                return nullptr;
+            }
+            frame->format = format;
+            frame->width = width;
+            frame->height = height;
+            if (av_frame_get_buffer(frame, 0) < 0) {
+                av_frame_free(&frame);
+                return nullptr;
+            }
+            return frame;
+        }
+
+        // Where a decoded frame lies relative to the segment: -1 before it (frames decoded
+        // from the keyframe the seek landed on), 0 inside, 1 past its end.
+        int SegmentPosition(const AVFrame* frame) const {
+            int64_t ts = frame->best_effort_timestamp;
+            if (ts == AV_NOPTS_VALUE) return 0;
+            if (this->segment_start != AV_NOPTS_VALUE && ts < this->segment_start) return -1;
+            if (this->segment_end != AV_NOPTS_VALUE && ts >= this->segment_end) return 1;
+            return 0;
+        }
+
+        bool Batched() const {
+            return this->backend == Backend::OpenGL && !this->PlanarPath() && this->gl_batch > 1;
+        }
+
+        bool GpuYuv() const {
+            return this->gpu_yuv && !this->yuv_fallback && this->backend == Backend::OpenGL && !this->PlanarPath() && !this->Batched();
+        }
+
+        bool Tiled() const {
+            return this->tiled || this->exceeds_gl;
+        }
+
+        // Frames go from decoder to encoder as YUV planes, without an RGB round trip.
+        bool PlanarPath() const {
+            return this->planar || this->Tiled();
+        }
+
+        // Frame-parallel transforms only pay off on the CPU paths; the GL path is tied to the
+        // one context of the transform thread. The tiled path splits every frame into bands
+        // over the workers instead, so it never holds more frames than the pipeline needs.
+        bool UsesWorkerPool() const {
+            return this->Pipelined() && this->workers > 1 && !this->Tiled() && (this->planar || this->backend == Backend::CPU);
+        }
+
+        bool Pipelined() const {
+            return this->pipelined && this->budget_depth != 0;
+        }
+
+        int QueueDepth() const {
+            return this->budget_depth > 0 ? std::min(this->queue_depth, this->budget_depth) : this->queue_depth;
+        }
+
+        // Window of the reorder buffer: how many frames may be in flight past the oldest one
+        // the encoder still waits for.
+        int ReorderWindow() const {
+            return std::max(this->QueueDepth(), 2 * this->workers);
+        }
+
+        // Lowers the queue depth, or turns pipelining off, until the frames the tiled path
+        // keeps in flight fit memory_budget: the pipelined path holds queue_depth + 1 decoded
+        // and as many encoder frames, the serial one a single frame of each. Frames the
+        // decoder keeps as references are outside our control and not counted.
+        void FitMemoryBudget() {
+            this->budget_depth = -1;
+            if (!this->Tiled() || this->memory_budget == 0) {
+                return;
+            }
+            size_t decoded = static_cast<size_t>(std::max(av_image_get_buffer_size(in_codec_ctx->pix_fmt, this->frame_width, this->frame_height, 1), 0));
+            size_t encoded = static_cast<size_t>(std::max(av_image_get_buffer_size(out_codec_ctx->pix_fmt, this->frame_width, this->frame_height, 1), 0));
+            size_t scratch = this->planar_needs_conversion ? encoded : 0;
+            auto in_flight = [&](int depth) {
+                return depth > 0 ? (depth + 1) * (decoded + encoded) + scratch : decoded + encoded + scratch;
+            };
+
+            int depth = this->pipelined ? this->queue_depth : 0;
+            while (depth > 0 && in_flight(depth) > this->memory_budget) {
+                depth--;
+            }
+            if (depth == 0 && in_flight(0) > this->memory_budget) {
+                std::cerr << "Warning: One " << this->frame_width << "x" << this->frame_height << " frame needs " << in_flight(0) / (1 << 20)
+                          << " MiB, more than the memory budget; processing serially." << std::endl;
+            }
+            if (depth < (this->pipelined ? this->queue_depth : 0)) {
+                this->budget_depth = depth;
+            }
+            std::cout << "Memory budget: " << in_flight(depth) / (1 << 20) << " MiB of frames in flight of " << this->memory_budget / (1 << 20)
+                      << " MiB (" << (depth > 0 ? "queue depth " + std::to_string(depth) : std::string("serial")) << ")" << std::endl;
+        }
+
+        // Conversion contexts come from sws_getCachedContext, so a context left by the previous
+        // file is kept when the formats and sizes match.
+        int CreateScratch(TransformScratch& s) {
+            AVPixelFormat decoded = in_codec_ctx->pix_fmt;
+            if (this->PlanarPath()) {
+                if (this->planar_needs_conversion) {
+                    s.sws_ctx = sws_getCachedContext(s.sws_ctx,
+                        this->frame_width, this->frame_height, decoded,
+                        this->frame_width, this->frame_height, out_codec_ctx->pix_fmt,
+                        SWS_POINT, NULL, NULL, NULL
+                    );
+                    if (!s.sws_ctx) {
+                        std::cerr << "Error: Cannot create SwsContext for planar conversion." << std::endl;
+                        return -1;
+                    }
+                }
+                // Also used to restride decoded frames that do not match the prepared plans. The
+                // tiled remap reads any stride, so it only needs one for the conversion.
+                if (this->Tiled() && !this->planar_needs_conversion) {
+                    return 0;
+                }
+                s.planar_frame = AllocateFrame(out_codec_ctx->pix_fmt, this->frame_width, this->frame_height);
+                if (!s.planar_frame) {
+                    std::cerr << "Error: Failed to allocate planar frame." << std::endl;
+                    return -1;
+                }
+                return 0;
+            }
+            if (this->GpuYuv()) {
+                return 0;
+            }
 
-            this->out_sws_ctx = sws_getContext(
+            s.sws_ctx = sws_getCachedContext(s.sws_ctx,
+                this->frame_width, this->frame_height, decoded,
+                this->frame_width, this->frame_height, AV_PIX_FMT_RGB24,
+                SWS_POINT, NULL, NULL, NULL
+            );
+            if (!s.sws_ctx) {
+                std::cerr << "Error: Cannot create SwsContext for color conversion." << std::endl;
+                return -1;
+            }
+            s.out_sws_ctx = sws_getCachedContext(s.out_sws_ctx,
                 this->frame_width, this->frame_height, AV_PIX_FMT_RGB24,
                 out_codec_ctx->width, out_codec_ctx->height, out_codec_ctx->pix_fmt,
                 SWS_POINT, NULL, NULL, NULL
             );
-
-            if (!this->out_sws_ctx) {
+            if (!s.out_sws_ctx) {
                 std::cerr << "Error: Cannot create SwsContext for output conversion." << std::endl;
                 return -1;
             }
 
-            std::cout << "Starting video processing with OpenGL..." << std::endl;
-            std::cout << "Applying " << (applyShuffleEffect ? "Shuffle" : "Unshuffle") << " effect." << std::endl;
-            std::cout << "Offset map dimensions: " << map_width << "x" << map_height << std::endl;
+            if (this->backend == Backend::CPU) {
+                s.rgb_frame = AllocateFrame(AV_PIX_FMT_RGB24, this->frame_width, this->frame_height);
+                s.processed_rgb_frame = AllocateFrame(AV_PIX_FMT_RGB24, this->frame_width, this->frame_height);
+                if (!s.rgb_frame || !s.processed_rgb_frame) {
+                    std::cerr << "Error: Failed to allocate RGB frames." << std::endl;
+                    return -1;
+                }
+            }
+            return 0;
+        }
 
-            this->Process();
-            std::cout << "Finished processing. Total frames written: " << this->frameCount << std::endl;
-            av_write_trailer(out_fmt_ctx);
+        // Scratch sets of the transform stage plus the pool of encoder-format frames that
+        // carry finished frames to the encode stage.
+        int AllocateFrames() {
+            this->FitMemoryBudget();
+            this->out_packet = av_packet_alloc();
+            if (!this->out_packet) {
+                std::cerr << "Error: Failed to allocate output packet." << std::endl;
+                return -1;
+            }
+
+            this->scratch.resize(this->UsesWorkerPool() ? this->workers : 1);
+            for (TransformScratch& s : this->scratch) {
+                if (this->CreateScratch(s) != 0) {
+                    return -1;
+                }
+            }
 
+            // The remap plans depend on the seed, the frame size and the decoded layout only.
+            std::string key = this->MapKey() + "\n" + std::to_string(this->frame_width) + "x" + std::to_string(this->frame_height)
+                            + " " + std::to_string(in_codec_ctx->pix_fmt);
+            if (key != this->plan_key) {
+                this->plan_key.clear();
+                this->planar_remapper.pix_fmt = AV_PIX_FMT_NONE;
+                if (this->backend == Backend::CPU && !this->PlanarPath()) {
+                    try {
+                        this->cpu_remapper.Prepare(this->offset_map, this->tile_map, this->map_width, this->map_height, this->frame_width, this->frame_height, this->scratch[0].rgb_frame->linesize[0]);
+                    }
+                    catch (const std::runtime_error& e) {
+                        std::cerr << "Error preparing CPU remap: " << e.what() << std::endl;
+                        return -1;
+                    }
+                }
+                this->plan_key = key;
+            }
+            if (this->Tiled()) {
+                try {
+                    this->tiled_remapper.Prepare(this->offset_map, this->tile_map, this->map_width, this->map_height, out_codec_ctx->pix_fmt,
+                                                 this->frame_width, this->frame_height, this->planar_full_range);
+                }
+                catch (const std::runtime_error& e) {
+                    std::cerr << "Error preparing tiled remap: " << e.what() << std::endl;
+                    return -1;
+                }
+            }
+
+            int pool_size = 1;
+            if (this->UsesWorkerPool()) {
+                pool_size = this->ReorderWindow() + 1;
+            } else if (this->Pipelined()) {
+                pool_size = this->QueueDepth() + 1;
+            }
+            for (int i = 0; i < pool_size; i++) {
+                AVFrame* frame = AllocateFrame(out_codec_ctx->pix_fmt, out_codec_ctx->width, out_codec_ctx->height);
+                if (!frame) {
+                    std::cerr << "Error: Failed to allocate output frame." << std::endl;
+                    return -1;
+                }
+                frame->color_range = out_codec_ctx->color_range;
+                this->output_frames.push_back(frame);
+            }
             return 0;
         }
 
-        void Process() {
-            AVPacket* pkt = av_packet_alloc();
-            if (!pkt) {
-                std::cerr << "Error: Failed to allocate output packet." << std::endl;
-                return;
+        // The planar plans are built for the strides of the first frame that reaches them,
+        // normally a decoder buffer, so matching frames need no copy at all.
+        void PreparePlanar(const AVFrame* decoded) {
+            const AVFrame* layout = this->planar_needs_conversion ? this->scratch[0].planar_frame : decoded;
+            this->planar_remapper.Prepare(this->offset_map, this->tile_map, this->map_width, this->map_height, layout, this->planar_full_range);
+        }
+
+        // Transform stage. Finished frames leave through `emit` in input order: right away on
+        // the CPU paths, gl_ring_depth - 1 frames later on the GL path and up to two batches
+        // later on the batched GL path. `acquire` hands out a
+        // writable encoder-format frame, or nullptr when processing is being torn down.
+        // The CPU paths only touch `s` and read-only state, so they may run on any worker.
+        bool TransformFrame(AVFrame* decoded, TransformScratch& s, const std::function<AVFrame*()>& acquire, const std::function<void(AVFrame*)>& emit) {
+            const RotatedMap* map = s.map.get();
+            if (this->PlanarPath()) {
+                bool tiled = this->Tiled();
+                if (!tiled && this->planar_remapper.pix_fmt == AV_PIX_FMT_NONE) {
+                    this->PreparePlanar(decoded);
+                }
+                const PlanarRemapper& planar_remapper = map ? map->planar_remapper : this->planar_remapper;
+                const AVFrame* planar_src = decoded;
+                if (this->planar_needs_conversion) {
+                    sws_scale(s.sws_ctx, decoded->data, decoded->linesize, 0, this->frame_height, s.planar_frame->data, s.planar_frame->linesize);
+                    planar_src = s.planar_frame;
+                } else if (!tiled && !planar_remapper.Matches(decoded)) {
+                    av_image_copy(s.planar_frame->data, s.planar_frame->linesize, (const uint8_t**)decoded->data, decoded->linesize,
+                                  static_cast<AVPixelFormat>(s.planar_frame->format), this->frame_width, this->frame_height);
+                    planar_src = s.planar_frame;
+                }
+
+                AVFrame* out_frame = acquire();
+                if (!out_frame) return false;
+                CopyColour(decoded, out_frame);
+                if (tiled) {
+                    (map ? map->tiled_remapper : this->tiled_remapper).Apply(planar_src, out_frame, this->workers);
+                } else {
+                    planar_remapper.Apply(planar_src, out_frame);
+                }
+                emit(out_frame);
+                return true;
             }
 
-            AVFrame* out_frame = av_frame_alloc();
-            if (!out_frame) {
-                std::cerr << "Error: Failed to allocate output frame." << std::endl;
-                av_packet_free(&pkt);
-                return;
+            if (this->backend == Backend::CPU) {
+                AVFrame* out_frame = acquire();
+                if (!out_frame) return false;
+                sws_scale(s.sws_ctx, decoded->data, decoded->linesize, 0, this->frame_height, s.rgb_frame->data, s.rgb_frame->linesize);
+                (map ? map->cpu_remapper : this->cpu_remapper).Apply(s.rgb_frame, s.processed_rgb_frame);
+                sws_scale(s.out_sws_ctx, s.processed_rgb_frame->data, s.processed_rgb_frame->linesize, 0, this->frame_height, out_frame->data, out_frame->linesize);
+                emit(out_frame);
+                return true;
             }
 
-            out_frame->format = out_codec_ctx->pix_fmt;
-            out_frame->width = out_codec_ctx->width;
-            out_frame->height = out_codec_ctx->height;
-            if (av_frame_get_buffer(out_frame, 0) < 0) {
-                std::cerr << "Error: Failed to allocate output frame buffers." << std::endl;
-                av_frame_free(&out_frame);
-                av_packet_free(&pkt);
-                return;
+            if (map && map->index != this->gl_rotation && !this->SwapGLMap(*map, acquire, emit)) {
+                return false;
+            }
+            if (this->Batched()) {
+                return this->TransformBatched(decoded, s, acquire, emit);
+            }
+            if (this->GpuYuv()) {
+                if (!this->yuv_renderer.Submit(decoded, this->offsetMapTexture, this->VAO)) {
+                    std::cerr << "Error: Failed to map pixel upload buffer." << std::endl;
+                    return false;
+                }
+                if (this->yuv_renderer.Full()) {
+                    return this->FinishOldestYuv(acquire, emit);
+                }
+                return true;
             }
 
-            AVFrame* rgb_frame = av_frame_alloc();
-            if (!rgb_frame) {
-                std::cerr << "Error: Failed to allocate RGB frame." << std::endl;
-                av_frame_free(&out_frame);
-                av_packet_free(&pkt);
-                return;
+            uint8_t* upload = this->transfer_ring.BeginUpload();
+            if (!upload) {
+                std::cerr << "Error: Failed to map pixel upload buffer." << std::endl;
+                return false;
             }
+            uint8_t* upload_data[4] = {upload, nullptr, nullptr, nullptr};
+            int upload_linesize[4] = {this->transfer_ring.Stride(), 0, 0, 0};
+            sws_scale(s.sws_ctx, decoded->data, decoded->linesize, 0, this->frame_height, upload_data, upload_linesize);
+            this->transfer_ring.EndUpload(this->inputTexture);
 
-            rgb_frame->format = AV_PIX_FMT_RGB24;
-            rgb_frame->width = this->frame_width;
-            rgb_frame->height = this->frame_height;
-            if (av_frame_get_buffer(rgb_frame, 0) < 0) {
-                std::cerr << "Error: Failed to allocate RGB frame buffers." << std::endl;
-                av_frame_free(&out_frame);
-                av_frame_free(&rgb_frame);
-                av_packet_free(&pkt);
-                return;
+            this->DrawFrame();
+            this->transfer_ring.QueueReadback();
+
+            if (this->transfer_ring.Full()) {
+                return this->FinishOldestReadback(acquire, emit);
             }
+            return true;
+        }
 
-            AVFrame* processed_rgb_frame = av_frame_alloc();
-            if (!processed_rgb_frame) {
-                std::cerr << "Error: Failed to allocate processed RGB frame." << std::endl;
-                av_frame_free(&out_frame);
-                av_frame_free(&rgb_frame);
-                av_packet_free(&pkt);
-                return;
+        // Points the GL offset texture at a rotated map. A partly filled batch is drawn with the
+        // map it was filled for first.
+        bool SwapGLMap(const RotatedMap& map, const std::function<AVFrame*()>& acquire, const std::function<void(AVFrame*)>& emit) {
+            if (this->Batched() && this->batch_renderer.Filling() && !this->SubmitBatch(acquire, emit)) {
+                return false;
             }
-            
-            processed_rgb_frame->format = AV_PIX_FMT_RGB24;
-            processed_rgb_frame->width = this->frame_width;
-            processed_rgb_frame->height = this->frame_height;
-            if (av_frame_get_buffer(processed_rgb_frame, 0) < 0) {
-                std::cerr << "Error: Failed to allocate processed RGB frame buffers." << std::endl;
-                av_frame_free(&out_frame);
-                av_frame_free(&rgb_frame);
-                av_frame_free(&processed_rgb_frame);
-                av_packet_free(&pkt);
-                return;
+            auto started = std::chrono::steady_clock::now();
+            this->UploadOffsetMap(map.offset_map, map.tile_map);
+            this->gl_rotation = map.index;
+            this->gl_map_seed.clear();
+            this->rotation_swap_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+            return true;
+        }
+
+        // Map of the rotation period `frame` falls in, or null while maps do not rotate. Called
+        // once per frame in input order, before the frame goes to a transform.
+        std::shared_ptr<const RotatedMap> Rotate(const AVFrame* frame) {
+            if (this->rotate_mode == RotationMode::Off) {
+                return nullptr;
+            }
+            long number = this->first_frame + this->rotation_frames;
+        #ifdef AV_FRAME_FLAG_KEY
+            bool key = (frame->flags & AV_FRAME_FLAG_KEY) != 0;
+        #else
+            bool key = frame->key_frame != 0;
+        #endif
+            if (this->rotate_mode == RotationMode::Keyframes && key && this->rotation_frames > 0) {
+                this->rotation_keyframes++;
+            }
+            this->rotation_frames++;
+            long index = this->rotate_mode == RotationMode::Frames ? number / this->rotate_every : this->rotation_keyframes;
+            if (this->rotation_map && this->rotation_map->index == index) {
+                return this->rotation_map;
             }
 
-            while (av_read_frame(in_fmt_ctx, in_packet) >= 0) {
-                if (in_packet->stream_index == video_stream_index) {
-                    if (avcodec_send_packet(in_codec_ctx, in_packet) >= 0) {
-                        while (avcodec_receive_frame(in_codec_ctx, in_frame) >= 0) {
-                            sws_scale(sws_ctx, in_frame->data, in_frame->linesize, 0, this->frame_height, rgb_frame->data, rgb_frame->linesize);
+            if (!this->rotation.Running()) {
+                this->StartRotation(frame, index);
+            }
+            this->rotation_map = this->rotation.Get(index);
+            if (this->rotation_frames > 1) {
+                this->rotations++;
+                if (this->rotate_mode == RotationMode::Keyframes) this->rotation.MarkBoundary(number);
+            }
+            return this->rotation_map;
+        }
 
-                            glBindTexture(GL_TEXTURE_2D, this->inputTexture);
-                            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, this->frame_width, this->frame_height, 0, GL_RGB, GL_UNSIGNED_BYTE, rgb_frame->data[0]);
+        // The background thread prepares the remapper of the active path with the settings of
+        // the fixed one, all of which are known once the first frame is here.
+        void StartRotation(const AVFrame* frame, long first_index) {
+            int map_width = this->map_width;
+            int map_height = this->map_height;
+            int width = this->frame_width;
+            int height = this->frame_height;
+            MapRotation::Prepare prepare;
+            if (this->Tiled()) {
+                AVPixelFormat pix_fmt = out_codec_ctx->pix_fmt;
+                bool full_range = this->planar_full_range;
+                prepare = [=](RotatedMap& map) {
+                    map.tiled_remapper.Prepare(map.offset_map, map.tile_map, map_width, map_height, pix_fmt, width, height, full_range);
+                };
+            } else if (this->planar) {
+                if (this->planar_remapper.pix_fmt == AV_PIX_FMT_NONE) {
+                    this->PreparePlanar(frame);
+                }
+                AVPixelFormat pix_fmt = this->planar_remapper.pix_fmt;
+                std::array<int, 3> linesizes;
+                for (int c = 0; c < 3; c++) {
+                    linesizes[c] = this->planar_remapper.plans[c].src_linesize;
+                }
+                bool full_range = this->planar_full_range;
+                prepare = [=](RotatedMap& map) {
+                    map.planar_remapper.Prepare(map.offset_map, map.tile_map, map_width, map_height, pix_fmt, width, height, linesizes.data(), full_range);
+                };
+            } else if (this->backend == Backend::CPU) {
+                int linesize = this->scratch[0].rgb_frame->linesize[0];
+                prepare = [=](RotatedMap& map) {
+                    map.cpu_remapper.Prepare(map.offset_map, map.tile_map, map_width, map_height, width, height, linesize);
+                };
+            }
+            this->rotation.Start(this->seed, this->unshuffle ? MapDirection::Unshuffle : MapDirection::Shuffle, map_width, map_height,
+                                 this->map_format == MapFormat::Index, first_index, this->rotate_ahead, std::move(prepare));
+        }
 
-                            glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
-                            glViewport(0, 0, this->frame_width, this->frame_height);
-                            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-                            glClear(GL_COLOR_BUFFER_BIT);
+        // Stages the frame into the batch being filled and submits the batch once it is full.
+        bool TransformBatched(AVFrame* decoded, TransformScratch& s, const std::function<AVFrame*()>& acquire, const std::function<void(AVFrame*)>& emit) {
+            uint8_t* upload = this->batch_renderer.BeginFrame();
+            if (!upload) {
+                std::cerr << "Error: Failed to map pixel upload buffer." << std::endl;
+                return false;
+            }
+            uint8_t* upload_data[4] = {upload, nullptr, nullptr, nullptr};
+            int upload_linesize[4] = {this->batch_renderer.Stride(), 0, 0, 0};
+            sws_scale(s.sws_ctx, decoded->data, decoded->linesize, 0, this->frame_height, upload_data, upload_linesize);
+            this->batch_renderer.EndFrame();
+
+            if (this->batch_renderer.BatchReady()) {
+                return this->SubmitBatch(acquire, emit);
+            }
+            return true;
+        }
 
-                            glUseProgram(this->shaderProgram);
-                            glActiveTexture(GL_TEXTURE0);
-                            glBindTexture(GL_TEXTURE_2D, this->inputTexture);
-                            glUniform1i(glGetUniformLocation(this->shaderProgram, "ourTexture"), 0);
+        bool SubmitBatch(const std::function<AVFrame*()>& acquire, const std::function<void(AVFrame*)>& emit) {
+            this->batch_renderer.Submit(this->shaderProgram, this->offsetMapTexture, this->VAO);
+            if (this->batch_renderer.Full()) {
+                return this->FinishOldestBatch(acquire, emit);
+            }
+            return true;
+        }
+
+        bool FinishOldestBatch(const std::function<AVFrame*()>& acquire, const std::function<void(AVFrame*)>& emit) {
+            int frames = 0;
+            const uint8_t* pixels = this->batch_renderer.MapOldest(frames);
+            bool ok = pixels != nullptr;
+            if (!pixels) {
+                std::cerr << "Error: Failed to map pixel readback buffer." << std::endl;
+            }
+            for (int i = 0; ok && i < frames; i++) {
+                AVFrame* out_frame = acquire();
+                if (!out_frame) {
+                    ok = false;
+                    break;
+                }
+                const uint8_t* readback_data[4] = {pixels + this->batch_renderer.FrameBytes() * i, nullptr, nullptr, nullptr};
+                int readback_linesize[4] = {this->batch_renderer.Stride(), 0, 0, 0};
+                sws_scale(this->scratch[0].out_sws_ctx, readback_data, readback_linesize, 0, this->frame_height, out_frame->data, out_frame->linesize);
+                emit(out_frame);
+            }
+            this->batch_renderer.UnmapOldest();
+            return ok;
+        }
 
-                            glActiveTexture(GL_TEXTURE1);
-                            glBindTexture(GL_TEXTURE_2D, this->offsetMapTexture);
-                            glUniform1i(glGetUniformLocation(this->shaderProgram, "offsetMap"), 1);
+        bool FlushTransform(const std::function<AVFrame*()>& acquire, const std::function<void(AVFrame*)>& emit) {
+            if (this->gl_context.Active() && this->Batched()) {
+                if (this->batch_renderer.Filling()) {
+                    this->batch_renderer.Submit(this->shaderProgram, this->offsetMapTexture, this->VAO);
+                }
+                while (!this->batch_renderer.Empty()) {
+                    if (!this->FinishOldestBatch(acquire, emit)) return false;
+                }
+                return true;
+            }
+            while (this->gl_context.Active() && !this->transfer_ring.Empty()) {
+                if (!this->FinishOldestReadback(acquire, emit)) return false;
+            }
+            while (this->gl_context.Active() && !this->yuv_renderer.Empty()) {
+                if (!this->FinishOldestYuv(acquire, emit)) return false;
+            }
+            return true;
+        }
 
-                            glBindVertexArray(this->VAO);
-                            glDrawArrays(GL_TRIANGLES, 0, 6);
-                            glBindVertexArray(0);
+        bool FinishOldestYuv(const std::function<AVFrame*()>& acquire, const std::function<void(AVFrame*)>& emit) {
+            AVFrame* out_frame = acquire();
+            if (!out_frame) return false;
+            if (!this->yuv_renderer.ReadOldest(out_frame)) {
+                std::cerr << "Error: Failed to map pixel readback buffer." << std::endl;
+                return false;
+            }
+            emit(out_frame);
+            return true;
+        }
 
-                            glPixelStorei(GL_PACK_ALIGNMENT, 1);
-                            glReadPixels(0, 0, this->frame_width, this->frame_height, GL_RGB, GL_UNSIGNED_BYTE, processed_rgb_frame->data[0]);
-                            sws_scale(this->out_sws_ctx, processed_rgb_frame->data, processed_rgb_frame->linesize, 0, this->frame_height, out_frame->data, out_frame->linesize);
+        // Converts the oldest finished readback straight out of its mapped buffer.
+        bool FinishOldestReadback(const std::function<AVFrame*()>& acquire, const std::function<void(AVFrame*)>& emit) {
+            AVFrame* out_frame = acquire();
+            if (!out_frame) return false;
 
-                            out_frame->pts = this->frameCount;
+            const uint8_t* pixels = this->transfer_ring.MapOldest();
+            if (pixels) {
+                const uint8_t* readback_data[4] = {pixels, nullptr, nullptr, nullptr};
+                int readback_linesize[4] = {this->transfer_ring.Stride(), 0, 0, 0};
+                sws_scale(this->scratch[0].out_sws_ctx, readback_data, readback_linesize, 0, this->frame_height, out_frame->data, out_frame->linesize);
+            }
+            this->transfer_ring.UnmapOldest();
 
-                            int ret = avcodec_send_frame(out_codec_ctx, out_frame);
-                            if (ret >= 0) {
-                                while (avcodec_receive_packet(out_codec_ctx, pkt) >= 0) {
-                                    av_packet_rescale_ts(pkt, out_codec_ctx->time_base, out_stream->time_base);
-                                    pkt->stream_index = out_stream->index;
-                                    av_interleaved_write_frame(out_fmt_ctx, pkt);
-                                    av_packet_unref(pkt);
-                                }
-                            }
+            if (!pixels) {
+                std::cerr << "Error: Failed to map pixel readback buffer." << std::endl;
+                return false;
+            }
+            emit(out_frame);
+            return true;
+        }
 
-                            this->frameCount++;
-                            if (this->framesOveral > 0 && this->frameCount % 40 == 0) {
-                                std::cout << ((float)this->frameCount / (float)this->framesOveral) * 80.0 << std::endl;
-                            }
+        void EncodeFrame(AVFrame* out_frame) {
+            AVPacket* pkt = this->out_packet;
+            long number = this->first_frame + this->frameCount;
+            out_frame->pts = number + this->pts_offset;
+            if (this->rotate_mode == RotationMode::Keyframes) {
+                out_frame->pict_type = this->rotation.TakeBoundary(number) ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+            }
 
-                            glfwPollEvents();
-                            if (glfwWindowShouldClose(this->window)) break;
-                        }
-                    }
+            auto started = this->telemetry.Now();
+            uint64_t quality_ns = this->quality.ElapsedNs();
+            this->quality.Capture(out_frame);
+            int ret = avcodec_send_frame(out_codec_ctx, out_frame);
+            if (ret >= 0) {
+                while (avcodec_receive_packet(out_codec_ctx, pkt) >= 0) {
+                    this->quality.Packet(out_codec_ctx, pkt);
+                    av_packet_rescale_ts(pkt, out_codec_ctx->time_base, out_stream->time_base);
+                    pkt->stream_index = out_stream->index;
+                    this->telemetry.AddBytes(pkt->size);
+                    av_interleaved_write_frame(out_fmt_ctx, pkt);
+                    av_packet_unref(pkt);
                 }
-                av_packet_unref(in_packet);
             }
 
+            this->frameCount++;
+            this->audio.WriteUntil(this->frameCount * av_q2d(out_codec_ctx->time_base));
+            this->telemetry.AddSince(this->telemetry.encode, started);
+            if (this->quality.Active() && this->telemetry.enabled) {
+                this->telemetry.quality.Add(this->quality.ElapsedNs() - quality_ns);
+            }
+            if (this->encoded) {
+                this->encoded->fetch_add(1, std::memory_order_relaxed);
+            }
+            if (this->on_encoded) {
+                this->on_encoded();
+            }
+            if (!this->report_progress) {
+                return;
+            }
+            if (this->telemetry.enabled) {
+                const QueueStats* queues[] = {&this->decoded_stats, &this->transformed_stats, &this->reorder_stats};
+                this->telemetry.Frame(this->frameCount, queues, 3);
+            } else if (this->framesOveral > 0 && this->frameCount % 40 == 0) {
+                std::cout << ((float)this->frameCount / (float)this->framesOveral) * 80.0 << std::endl;
+            }
+        }
+
+        void FlushEncoder() {
+            AVPacket* pkt = this->out_packet;
             avcodec_send_frame(out_codec_ctx, NULL);
             while (avcodec_receive_packet(out_codec_ctx, pkt) >= 0) {
+                this->quality.Packet(out_codec_ctx, pkt);
                 av_packet_rescale_ts(pkt, out_codec_ctx->time_base, out_stream->time_base);
+                this->telemetry.AddBytes(pkt->size);
                 av_interleaved_write_frame(out_fmt_ctx, pkt);
                 av_packet_unref(pkt);
             }
+            this->quality.Flush();
+        }
+
+        // Polled once per batch on the batched path.
+        bool PollWindow() {
+            if (this->gl_context.Active() && ++this->polls % this->gl_batch == 0) {
+                return this->gl_context.Poll();
+            }
+            return true;
+        }
+
+        void Process() {
+            if (this->UsesWorkerPool()) {
+                this->ProcessParallel();
+            } else if (this->Pipelined()) {
+                this->ProcessPipelined();
+            } else {
+                this->ProcessSerial();
+            }
+            this->FlushEncoder();
+        }
+
+        // Decodes the input's video stream and hands every frame inside the segment to `take`,
+        // until the input ends, a frame lies past the segment or `take` returns false. At the
+        // end of the input the decoder is drained: with frame threading it holds back about one
+        // frame per thread, which would otherwise be lost from the end of every file.
+        template <typename Take>
+        void DecodeFrames(const std::atomic<bool>& stop, Take take) {
+            bool running = true;
+            auto decode_started = this->telemetry.Now();
+            auto receive = [&]() {
+                while (running && avcodec_receive_frame(in_codec_ctx, in_frame) >= 0) {
+                    this->telemetry.AddSince(this->telemetry.decode, decode_started);
+                    int position = this->SegmentPosition(in_frame);
+                    if (position != 0) {
+                        av_frame_unref(in_frame);
+                        running = position < 0;
+                        continue;
+                    }
+                    running = take(in_frame);
+                    decode_started = this->telemetry.Now();
+                }
+            };
+
+            while (running && !stop.load() && av_read_frame(in_fmt_ctx, in_packet) >= 0) {
+                decode_started = this->telemetry.Now();
+                if (in_packet->stream_index == video_stream_index && avcodec_send_packet(in_codec_ctx, in_packet) >= 0) {
+                    receive();
+                }
+                av_packet_unref(in_packet);
+            }
+            if (running && !stop.load() && avcodec_send_packet(in_codec_ctx, NULL) >= 0) {
+                decode_started = this->telemetry.Now();
+                receive();
+            }
+        }
+
+        void ProcessSerial() {
+            AVFrame* out_frame = this->output_frames[0];
+            auto acquire = [&]() -> AVFrame* {
+                return av_frame_make_writable(out_frame) < 0 ? nullptr : out_frame;
+            };
+            auto emit = [&](AVFrame* frame) {
+                this->EncodeFrame(frame);
+            };
+
+            const std::atomic<bool> stop{false};
+            this->DecodeFrames(stop, [&](AVFrame* frame) {
+                bool running = false;
+                auto transform_started = this->telemetry.Now();
+                try {
+                    this->scratch[0].map = this->Rotate(frame);
+                    running = this->TransformFrame(frame, this->scratch[0], acquire, emit);
+                }
+                catch (const std::runtime_error& e) {
+                    std::cerr << "Error transforming frame: " << e.what() << std::endl;
+                }
+                this->telemetry.AddSince(this->telemetry.transform, transform_started);
+                return this->PollWindow() && running;
+            });
+
+            this->FlushTransform(acquire, emit);
+        }
+
+        // Demux+decode, transform and encode+mux each get their own thread, linked by bounded
+        // SPSC queues of recycled frames. Decoded frames travel as AVFrame shells holding the
+        // decoder's buffers; finished frames come from output_frames. The transform stage stays
+        // on the calling thread because the GL context and GLFW events live there.
+        void ProcessPipelined() {
+            // Transform and encode always drain what is already queued, so they wait with a
+            // flag that never fires; only the decoder is told to stop early.
+            std::atomic<bool> stop_decoding{false};
+            const std::atomic<bool> drain{false};
+
+            int depth = this->QueueDepth();
+            SpscQueue<AVFrame*> decoded(depth);
+            SpscQueue<AVFrame*> decoded_free(depth + 1);
+            SpscQueue<AVFrame*> transformed(depth);
+            SpscQueue<AVFrame*> transformed_free(this->output_frames.size());
 
-            av_frame_free(&out_frame);
-            av_frame_free(&rgb_frame);
-            av_frame_free(&processed_rgb_frame);
-            av_packet_free(&pkt); 
+            std::vector<AVFrame*> shells;
+            for (int i = 0; i < depth + 1; i++) {
+                AVFrame* shell = av_frame_alloc();
+                if (!shell) {
+                    std::cerr << "Error: Failed to allocate decoded frame." << std::endl;
+                    for (AVFrame*& frame : shells) av_frame_free(&frame);
+                    return;
+                }
+                shells.push_back(shell);
+                decoded_free.TryPush(shell);
+            }
+            for (AVFrame* frame : this->output_frames) {
+                transformed_free.TryPush(frame);
+            }
+
+            this->decoded_stats = QueueStats{"decoded"};
+            this->transformed_stats = QueueStats{"transformed"};
+
+            std::thread decoder([&]() {
+                this->DecodeFrames(stop_decoding, [&](AVFrame* frame) {
+                    AVFrame* shell = nullptr;
+                    if (!decoded_free.Pop(shell, stop_decoding)) return false;
+                    av_frame_move_ref(shell, frame);
+                    return decoded.Push(shell, stop_decoding);
+                });
+                decoded.Push(nullptr, stop_decoding);
+            });
+
+            std::thread encoder([&]() {
+                AVFrame* frame = nullptr;
+                while (transformed.Pop(frame, drain) && frame) {
+                    this->EncodeFrame(frame);
+                    this->decoded_stats.Sample(decoded);
+                    this->transformed_stats.Sample(transformed);
+                    if (this->print_queue_stats && this->frameCount % 40 == 0) {
+                        std::cerr << "Queues: " << this->decoded_stats << ", " << this->transformed_stats << std::endl;
+                    }
+                    transformed_free.Push(frame, drain);
+                }
+            });
+
+            auto acquire = [&]() -> AVFrame* {
+                AVFrame* frame = nullptr;
+                if (!transformed_free.Pop(frame, drain)) return nullptr;
+                return av_frame_make_writable(frame) < 0 ? nullptr : frame;
+            };
+            auto emit = [&](AVFrame* frame) {
+                transformed.Push(frame, drain);
+            };
+
+            bool running = true;
+            AVFrame* frame = nullptr;
+            while (running && decoded.Pop(frame, drain) && frame) {
+                auto transform_started = this->telemetry.Now();
+                try {
+                    this->scratch[0].map = this->Rotate(frame);
+                    running = this->TransformFrame(frame, this->scratch[0], acquire, emit);
+                }
+                catch (const std::runtime_error& e) {
+                    std::cerr << "Error transforming frame: " << e.what() << std::endl;
+                    running = false;
+                }
+                this->telemetry.AddSince(this->telemetry.transform, transform_started);
+                av_frame_unref(frame);
+                decoded_free.Push(frame, drain);
+                running = this->PollWindow() && running;
+            }
+
+            stop_decoding = true;
+            this->FlushTransform(acquire, emit);
+            transformed.Push(nullptr, drain);
+
+            decoder.join();
+            encoder.join();
+
+            for (AVFrame*& shell : shells) {
+                av_frame_free(&shell);
+            }
+
+            if (this->print_queue_stats) {
+                std::cerr << "Queues: " << this->decoded_stats << ", " << this->transformed_stats << std::endl;
+            }
+        }
+
+        // Frame-parallel variant of ProcessPipelined for the CPU paths. The calling thread hands
+        // each decoded frame, tagged with its sequence number, to a work-stealing pool; workers
+        // transform into frames from a shared free list and the reorder buffer gives them back
+        // to the encoder thread in input order. The reorder window also bounds how far the
+        // workers run ahead, so memory stays at window + 1 output frames.
+        void ProcessParallel() {
+            std::atomic<bool> stop_decoding{false};
+            const std::atomic<bool> drain{false};
+            std::atomic<bool> failed{false};
+
+            size_t window = this->ReorderWindow();
+            int depth = this->QueueDepth();
+            SpscQueue<AVFrame*> decoded(depth);
+            SpscQueue<AVFrame*> decoded_free(depth + 1);
+            ReorderBuffer reorder(window);
+            FrameFreeList output_free;
+
+            // Decoder shells go straight back to the decoder; each task owns the references of
+            // its frame in inputs[sequence % window] until the transform is done.
+            std::vector<AVFrame*> shells;
+            std::vector<AVFrame*> inputs;
+            auto free_frames = [&]() {
+                for (AVFrame*& frame : shells) av_frame_free(&frame);
+                for (AVFrame*& frame : inputs) av_frame_free(&frame);
+            };
+            for (int i = 0; i < depth + 1; i++) {
+                AVFrame* shell = av_frame_alloc();
+                if (!shell) {
+                    std::cerr << "Error: Failed to allocate decoded frame." << std::endl;
+                    free_frames();
+                    return;
+                }
+                shells.push_back(shell);
+                decoded_free.TryPush(shell);
+            }
+            for (size_t i = 0; i < window; i++) {
+                AVFrame* input = av_frame_alloc();
+                if (!input) {
+                    std::cerr << "Error: Failed to allocate decoded frame." << std::endl;
+                    free_frames();
+                    return;
+                }
+                inputs.push_back(input);
+            }
+            for (AVFrame* frame : this->output_frames) {
+                output_free.Put(frame);
+            }
+
+            this->decoded_stats = QueueStats{"decoded"};
+            this->reorder_stats = QueueStats{"reorder"};
+
+            std::thread decoder([&]() {
+                this->DecodeFrames(stop_decoding, [&](AVFrame* frame) {
+                    AVFrame* shell = nullptr;
+                    if (!decoded_free.Pop(shell, stop_decoding)) return false;
+                    av_frame_move_ref(shell, frame);
+                    return decoded.Push(shell, stop_decoding);
+                });
+                decoded.Push(nullptr, stop_decoding);
+            });
+
+            // A failed frame still takes its turn, as nullptr, so the encoder keeps releasing
+            // slots and every worker can finish.
+            std::thread encoder([&]() {
+                AVFrame* frame = nullptr;
+                while (reorder.Next(frame)) {
+                    if (frame && !failed.load()) {
+                        this->EncodeFrame(frame);
+                        this->decoded_stats.Sample(decoded);
+                        this->reorder_stats.Sample(reorder);
+                        if (this->print_queue_stats && this->frameCount % 40 == 0) {
+                            std::cerr << "Queues: " << this->decoded_stats << ", " << this->reorder_stats << std::endl;
+                        }
+                    }
+                    if (frame) output_free.Put(frame);
+                    reorder.Release();
+                }
+            });
+
+            uint64_t submitted = 0;
+            {
+                WorkStealingPool pool(static_cast<int>(this->scratch.size()));
+
+                AVFrame* frame = nullptr;
+                while (!failed.load() && decoded.Pop(frame, drain) && frame) {
+                    std::shared_ptr<const RotatedMap> map;
+                    try {
+                        if (this->planar && this->planar_remapper.pix_fmt == AV_PIX_FMT_NONE) {
+                            this->PreparePlanar(frame);
+                        }
+                        map = this->Rotate(frame);
+                    }
+                    catch (const std::runtime_error& e) {
+                        std::cerr << "Error transforming frame: " << e.what() << std::endl;
+                        failed = true;
+                    }
+                    uint64_t sequence = submitted;
+                    reorder.WaitForSlot(sequence);
+                    AVFrame* input = inputs[sequence % window];
+                    av_frame_move_ref(input, frame);
+                    decoded_free.Push(frame, drain);
+                    if (failed.load()) {
+                        av_frame_unref(input);
+                        break;
+                    }
+
+                    pool.Submit([&, sequence, input, map](int worker) {
+                        AVFrame* result = nullptr;
+                        auto acquire = [&]() -> AVFrame* {
+                            AVFrame* out_frame = output_free.Take();
+                            if (av_frame_make_writable(out_frame) < 0) {
+                                output_free.Put(out_frame);
+                                return nullptr;
+                            }
+                            return out_frame;
+                        };
+                        auto emit = [&](AVFrame* out_frame) {
+                            result = out_frame;
+                        };
+                        auto transform_started = this->telemetry.Now();
+                        try {
+                            this->scratch[worker].map = map;
+                            if (!this->TransformFrame(input, this->scratch[worker], acquire, emit)) {
+                                failed = true;
+                            }
+                        }
+                        catch (const std::runtime_error& e) {
+                            std::cerr << "Error transforming frame: " << e.what() << std::endl;
+                            if (result) output_free.Put(result);
+                            result = nullptr;
+                            failed = true;
+                        }
+                        this->telemetry.AddSince(this->telemetry.transform, transform_started);
+                        av_frame_unref(input);
+                        reorder.Put(sequence, result);
+                    });
+                    submitted++;
+                }
+
+                stop_decoding = true;
+                reorder.Finish(submitted);
+                encoder.join();
+                if (this->print_queue_stats) {
+                    std::cerr << "Work stealing: " << pool.Steals() << " tasks stolen by " << pool.Size() << " workers" << std::endl;
+                }
+            }
+            decoder.join();
+            free_frames();
+
+            if (this->print_queue_stats) {
+                std::cerr << "Queues: " << this->decoded_stats << ", " << this->reorder_stats << std::endl;
+            }
         }
     };
-}
+}
\ No newline at end of file
@@ -0,0 +1,207 @@
+namespace UnsafeYT{
+    // Fixed set of worker threads, each with its own task deque. Submit() deals tasks out
+    // round-robin; a worker runs its own tasks oldest first and, once it runs dry, steals
+    // the newest task from another worker before going to sleep. Any number of threads may
+    // call Submit() at once.
+    class WorkStealingPool {
+    public:
+        using Task = std::function<void(int worker)>;
+
+        explicit WorkStealingPool(int workers) : queues(std::max(workers, 1)) {
+            for (int i = 0; i < static_cast<int>(this->queues.size()); i++) {
+                this->threads.emplace_back([this, i]() { this->Run(i); });
+            }
+        }
+
+        ~WorkStealingPool() {
+            {
+                std::lock_guard<std::mutex> lock(this->wake_mutex);
+                this->stopping = true;
+            }
+            this->wake.notify_all();
+            for (std::thread& thread : this->threads) {
+                thread.join();
+            }
+        }
+
+        int Size() const { return static_cast<int>(this->queues.size()); }
+
+        void Submit(Task task) {
+            WorkerQueue& queue = this->queues[this->next_queue.fetch_add(1, std::memory_order_relaxed) % this->queues.size()];
+            {
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.tasks.push_back(std::move(task));
+            }
+            {
+                std::lock_guard<std::mutex> lock(this->wake_mutex);
+                this->queued++;
+            }
+            this->wake.notify_one();
+        }
+
+        uint64_t Steals() const { return this->steals.load(std::memory_order_relaxed); }
+
+    private:
+        struct WorkerQueue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        bool Take(int worker, Task& task) {
+            {
+                WorkerQueue& own = this->queues[worker];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.tasks.empty()) {
+                    task = std::move(own.tasks.front());
+                    own.tasks.pop_front();
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < this->queues.size(); i++) {
+                WorkerQueue& victim = this->queues[(worker + i) % this->queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty()) {
+                    task = std::move(victim.tasks.back());
+                    victim.tasks.pop_back();
+                    this->steals.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void Run(int worker) {
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(this->wake_mutex);
+                    this->wake.wait(lock, [this]() { return this->stopping || this->queued > 0; });
+                    if (this->queued == 0) return;
+                    this->queued--;
+                }
+
+                // Every counted task is in some deque, so this finds one.
+                Task task;
+                while (!this->Take(worker, task)) {
+                    std::this_thread::yield();
+                }
+                task(worker);
+            }
+        }
+
+        std::vector<WorkerQueue> queues;
+        std::vector<std::thread> threads;
+        std::mutex wake_mutex;
+        std::condition_variable wake;
+        size_t queued = 0;
+        bool stopping = false;
+        std::atomic<size_t> next_queue{0};
+        std::atomic<uint64_t> steals{0};
+    };
+
+    // Puts frames finished out of order back into sequence order. At most `window` sequence
+    // numbers are in flight past the next one to be released, which bounds both the buffer
+    // and how far ahead of the encoder the workers may run.
+    class ReorderBuffer {
+    public:
+        explicit ReorderBuffer(size_t window) : slots(std::max<size_t>(window, 1)), filled(slots.size(), false) {}
+
+        // Blocks the submitter until `sequence` fits in the window.
+        void WaitForSlot(uint64_t sequence) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (sequence >= this->next + this->slots.size()) {
+                this->full_waits++;
+                this->changed.wait(lock, [&]() { return sequence < this->next + this->slots.size(); });
+            }
+        }
+
+        void Put(uint64_t sequence, AVFrame* frame) {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                size_t slot = sequence % this->slots.size();
+                this->slots[slot] = frame;
+                this->filled[slot] = true;
+                this->ready++;
+            }
+            this->changed.notify_all();
+        }
+
+        // Marks the end of the stream: no sequence number at or past `total` will be put.
+        void Finish(uint64_t total) {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->total = total;
+            }
+            this->changed.notify_all();
+        }
+
+        // Waits for the next frame in order; false once the stream is over. The frame may be
+        // nullptr if its worker failed. Call Release() when done with it.
+        bool Next(AVFrame*& frame) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            size_t slot = this->next % this->slots.size();
+            if (!this->filled[slot] && this->next < this->total) {
+                this->empty_waits++;
+                this->changed.wait(lock, [&]() { return this->filled[slot] || this->next >= this->total; });
+            }
+            if (!this->filled[slot]) {
+                return false;
+            }
+            frame = this->slots[slot];
+            return true;
+        }
+
+        void Release() {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->filled[this->next % this->slots.size()] = false;
+                this->next++;
+                this->ready--;
+            }
+            this->changed.notify_all();
+        }
+
+        size_t Size() const {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->ready;
+        }
+
+        size_t Capacity() const { return this->slots.size(); }
+
+        std::atomic<uint64_t> full_waits{0};
+        std::atomic<uint64_t> empty_waits{0};
+
+    private:
+        mutable std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<AVFrame*> slots;
+        std::vector<bool> filled;
+        uint64_t next = 0;
+        uint64_t total = std::numeric_limits<uint64_t>::max();
+        size_t ready = 0;
+    };
+
+    // Free list shared by every worker; frames go back once the encoder is done with them.
+    class FrameFreeList {
+    public:
+        void Put(AVFrame* frame) {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->frames.push_back(frame);
+            }
+            this->available.notify_one();
+        }
+
+        AVFrame* Take() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->available.wait(lock, [this]() { return !this->frames.empty(); });
+            AVFrame* frame = this->frames.back();
+            this->frames.pop_back();
+            return frame;
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable available;
+        std::vector<AVFrame*> frames;
+    };
+}
\ No newline at end of file
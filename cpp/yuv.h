@@ -0,0 +1,324 @@
+namespace UnsafeYT{
+    namespace detail {
+        // Row-major matrices between normalized Y'PbPr and R'G'B' for the luma weights of a
+        // colour space; anything unknown is treated as BT.601, as swscale does by default.
+        inline void yuv_matrices(AVColorSpace colorspace, float to_rgb[9], float to_yuv[9]) {
+            double kr = 0.299, kb = 0.114;
+            if (colorspace == AVCOL_SPC_BT709) {
+                kr = 0.2126; kb = 0.0722;
+            } else if (colorspace == AVCOL_SPC_BT2020_NCL) {
+                kr = 0.2627; kb = 0.0593;
+            }
+            double kg = 1.0 - kr - kb;
+            const double rgb[9] = {
+                1.0, 0.0,                          2.0 * (1.0 - kr),
+                1.0, -2.0 * kb * (1.0 - kb) / kg,  -2.0 * kr * (1.0 - kr) / kg,
+                1.0, 2.0 * (1.0 - kb),             0.0
+            };
+            const double yuv[9] = {
+                kr,                          kg,                          kb,
+                -kr / (2.0 * (1.0 - kb)),    -kg / (2.0 * (1.0 - kb)),    0.5,
+                0.5,                         -kg / (2.0 * (1.0 - kr)),    -kb / (2.0 * (1.0 - kr))
+            };
+            for (int i = 0; i < 9; i++) {
+                to_rgb[i] = static_cast<float>(rgb[i]);
+                to_yuv[i] = static_cast<float>(yuv[i]);
+            }
+        }
+    }
+
+    // GL transform that never leaves YUV on the CPU side. The decoder's Y, U and V planes are
+    // uploaded as three R8 textures; the fragment stage remaps, converts to RGB, inverts and
+    // converts back, rendering Y into a full-size R8 target and U and V into two chroma-size
+    // targets of one framebuffer. The planes are read back straight into the encoder's frame,
+    // so there is no sws_scale on the hot path and a 4:2:0 frame moves 1.5 bytes per pixel
+    // each way instead of 3.
+    //
+    // Every slot of the ring has its own upload and readback buffer and fence, as in
+    // PixelTransferRing. Rows in both are padded to a multiple of 64 bytes, so the transfers
+    // keep the default 4-byte alignment rules instead of GL_PACK_ALIGNMENT 1.
+    class YuvRenderer {
+    public:
+        // Output is always 4:2:0; any 8-bit planar input is resampled to it in the shader.
+        static bool Supports(AVPixelFormat pix_fmt) {
+            YuvLayout layout;
+            return PlanarRemapper::Describe(pix_fmt, layout) && layout.bytes == 1 && !layout.semi_planar;
+        }
+
+        int Init(GLuint program, AVPixelFormat in_fmt, AVPixelFormat out_fmt, int width, int height, int depth) {
+            if (!Supports(in_fmt) || !Supports(out_fmt)) {
+                std::cerr << "Error: The GL YUV path needs 8-bit planar YUV frames." << std::endl;
+                return -1;
+            }
+            this->program = program;
+            this->width = width;
+            this->height = height;
+            this->depth = std::max(depth, 1);
+            this->upload_bytes = Layout(this->inputs, in_fmt, width, height);
+            this->readback_bytes = Layout(this->outputs, out_fmt, width, height);
+            const AVPixFmtDescriptor* in_desc = av_pix_fmt_desc_get(in_fmt);
+            const AVPixFmtDescriptor* out_desc = av_pix_fmt_desc_get(out_fmt);
+
+            for (int c = 0; c < 3; c++) {
+                glGenTextures(1, &this->inputs[c].texture);
+                glBindTexture(GL_TEXTURE_2D, this->inputs[c].texture);
+                AllocatePlane(this->inputs[c].width, this->inputs[c].height);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+                glGenTextures(1, &this->outputs[c].texture);
+                glBindTexture(GL_TEXTURE_2D, this->outputs[c].texture);
+                AllocatePlane(this->outputs[c].width, this->outputs[c].height);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            glGenFramebuffers(1, &this->luma_fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, this->luma_fbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->outputs[0].texture, 0);
+            GLenum luma_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glGenFramebuffers(1, &this->chroma_fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, this->chroma_fbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->outputs[1].texture, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, this->outputs[2].texture, 0);
+            const GLenum chroma_buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+            glDrawBuffers(2, chroma_buffers);
+            GLenum chroma_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            if (luma_status != GL_FRAMEBUFFER_COMPLETE || chroma_status != GL_FRAMEBUFFER_COMPLETE) {
+                std::cerr << "ERROR::FRAMEBUFFER:: YUV framebuffers are not complete! Status: " << luma_status << ", " << chroma_status << std::endl;
+                return -1;
+            }
+
+            this->uploads.assign(this->depth, 0);
+            this->readbacks.assign(this->depth, 0);
+            this->fences.assign(this->depth, nullptr);
+            glGenBuffers(this->depth, this->uploads.data());
+            glGenBuffers(this->depth, this->readbacks.data());
+            for (int i = 0; i < this->depth; i++) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->uploads[i]);
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, this->upload_bytes, NULL, GL_STREAM_DRAW);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, this->readbacks[i]);
+                glBufferData(GL_PIXEL_PACK_BUFFER, this->readback_bytes, NULL, GL_STREAM_READ);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            if (glGetError() != GL_NO_ERROR) {
+                std::cerr << "Error: Failed to allocate YUV pixel buffer objects." << std::endl;
+                return -1;
+            }
+
+            glUseProgram(this->program);
+            glUniform1i(glGetUniformLocation(this->program, "planeY"), 0);
+            glUniform1i(glGetUniformLocation(this->program, "planeU"), 1);
+            glUniform1i(glGetUniformLocation(this->program, "planeV"), 2);
+            glUniform1i(glGetUniformLocation(this->program, "offsetMap"), 3);
+            glUniform1i(glGetUniformLocation(this->program, "tileMap"), 3);
+            glUniform2i(glGetUniformLocation(this->program, "chromaShift"), in_desc->log2_chroma_w, in_desc->log2_chroma_h);
+            glUseProgram(0);
+            this->chroma_pass_location = glGetUniformLocation(this->program, "chromaPass");
+            this->frame_size_location = glGetUniformLocation(this->program, "frameSize");
+            this->luma_shift_location = glGetUniformLocation(this->program, "lumaShift");
+            this->out_shift_w = out_desc->log2_chroma_w;
+            this->out_shift_h = out_desc->log2_chroma_h;
+            return 0;
+        }
+
+        // Colour conversion of the current file: the input's range, the output's range and the
+        // input's matrix for both directions, so only out-of-gamut values differ from inverting
+        // the planes directly.
+        void Configure(AVColorSpace colorspace, bool in_full_range, bool out_full_range) {
+            float to_rgb[9], to_yuv[9];
+            detail::yuv_matrices(colorspace, to_rgb, to_yuv);
+            glUseProgram(this->program);
+            glUniformMatrix3fv(glGetUniformLocation(this->program, "toRgb"), 1, GL_TRUE, to_rgb);
+            glUniformMatrix3fv(glGetUniformLocation(this->program, "toYuv"), 1, GL_TRUE, to_yuv);
+            glUniform3f(glGetUniformLocation(this->program, "inOffset"), in_full_range ? 0.0f : 16.0f, 128.0f, 128.0f);
+            glUniform3f(glGetUniformLocation(this->program, "inScale"), in_full_range ? 255.0f : 219.0f, in_full_range ? 255.0f : 224.0f, in_full_range ? 255.0f : 224.0f);
+            glUniform3f(glGetUniformLocation(this->program, "outOffset"), out_full_range ? 0.0f : 16.0f, 128.0f, 128.0f);
+            glUniform3f(glGetUniformLocation(this->program, "outScale"), out_full_range ? 255.0f : 219.0f, out_full_range ? 255.0f : 224.0f, out_full_range ? 255.0f : 224.0f);
+            glUseProgram(0);
+        }
+
+        void Release() {
+            for (GLsync& fence : this->fences) {
+                if (fence) glDeleteSync(fence);
+                fence = nullptr;
+            }
+            if (!this->uploads.empty()) glDeleteBuffers(static_cast<GLsizei>(this->uploads.size()), this->uploads.data());
+            if (!this->readbacks.empty()) glDeleteBuffers(static_cast<GLsizei>(this->readbacks.size()), this->readbacks.data());
+            this->uploads.clear();
+            this->readbacks.clear();
+            this->fences.clear();
+            for (int c = 0; c < 3; c++) {
+                glDeleteTextures(1, &this->inputs[c].texture);
+                glDeleteTextures(1, &this->outputs[c].texture);
+                this->inputs[c].texture = 0;
+                this->outputs[c].texture = 0;
+            }
+            glDeleteFramebuffers(1, &this->luma_fbo);
+            glDeleteFramebuffers(1, &this->chroma_fbo);
+            this->luma_fbo = 0;
+            this->chroma_fbo = 0;
+            this->head = 0;
+            this->pending = 0;
+        }
+
+        bool Full() const { return this->pending == this->depth; }
+        bool Empty() const { return this->pending == 0; }
+
+        // Uploads the planes of a decoded frame into the next slot, renders both passes and
+        // queues the readback of all three output planes.
+        bool Submit(const AVFrame* decoded, GLuint offset_map_texture, GLuint vao) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->uploads[this->head]);
+            uint8_t* upload = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, this->upload_bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+            if (!upload) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                return false;
+            }
+            for (int c = 0; c < 3; c++) {
+                const Plane& plane = this->inputs[c];
+                av_image_copy_plane(upload + plane.offset, plane.stride, decoded->data[c], decoded->linesize[c], plane.width, plane.height);
+            }
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            for (int c = 0; c < 3; c++) {
+                const Plane& plane = this->inputs[c];
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, plane.stride);
+                glBindTexture(GL_TEXTURE_2D, plane.texture);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, plane.width, plane.height, GL_RED, GL_UNSIGNED_BYTE, (void*)plane.offset);
+            }
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+            glUseProgram(this->program);
+            for (int c = 0; c < 3; c++) {
+                glActiveTexture(GL_TEXTURE0 + c);
+                glBindTexture(GL_TEXTURE_2D, this->inputs[c].texture);
+            }
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, offset_map_texture);
+            glBindVertexArray(vao);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, this->luma_fbo);
+            glViewport(0, 0, this->outputs[0].width, this->outputs[0].height);
+            glUniform1i(this->chroma_pass_location, 0);
+            glUniform2i(this->frame_size_location, this->outputs[0].width, this->outputs[0].height);
+            glUniform2i(this->luma_shift_location, 0, 0);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, this->chroma_fbo);
+            glViewport(0, 0, this->outputs[1].width, this->outputs[1].height);
+            glUniform1i(this->chroma_pass_location, 1);
+            glUniform2i(this->frame_size_location, this->outputs[1].width, this->outputs[1].height);
+            glUniform2i(this->luma_shift_location, this->out_shift_w, this->out_shift_h);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, this->readbacks[this->head]);
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            const GLuint sources[3] = {this->luma_fbo, this->chroma_fbo, this->chroma_fbo};
+            for (int c = 0; c < 3; c++) {
+                const Plane& plane = this->outputs[c];
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, sources[c]);
+                glReadBuffer(c == 2 ? GL_COLOR_ATTACHMENT1 : GL_COLOR_ATTACHMENT0);
+                glPixelStorei(GL_PACK_ROW_LENGTH, plane.stride);
+                glReadPixels(0, 0, plane.width, plane.height, GL_RED, GL_UNSIGNED_BYTE, (void*)plane.offset);
+            }
+            glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            this->fences[this->head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            this->head = (this->head + 1) % this->depth;
+            this->pending++;
+            return true;
+        }
+
+        // Waits for the oldest readback and copies its planes into `out`. The slot is freed
+        // either way; false if the buffer could not be mapped.
+        bool ReadOldest(AVFrame* out) {
+            int tail = (this->head + this->depth - this->pending) % this->depth;
+            GLsync& fence = this->fences[tail];
+            if (fence) {
+                GLenum status;
+                do {
+                    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+                } while (status == GL_TIMEOUT_EXPIRED);
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, this->readbacks[tail]);
+            const uint8_t* pixels = static_cast<const uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, this->readback_bytes, GL_MAP_READ_BIT));
+            if (pixels) {
+                for (int c = 0; c < 3; c++) {
+                    const Plane& plane = this->outputs[c];
+                    av_image_copy_plane(out->data[c], out->linesize[c], pixels + plane.offset, plane.stride, plane.width, plane.height);
+                }
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            this->pending--;
+            return pixels != nullptr;
+        }
+
+    private:
+        struct Plane {
+            int width = 0;
+            int height = 0;
+            int stride = 0;
+            size_t offset = 0;
+            GLuint texture = 0;
+        };
+
+        // Places the three planes of `pix_fmt` one after another with padded rows; returns the
+        // total size.
+        static GLsizeiptr Layout(std::array<Plane, 3>& planes, AVPixelFormat pix_fmt, int width, int height) {
+            const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
+            size_t offset = 0;
+            for (int c = 0; c < 3; c++) {
+                Plane& plane = planes[c];
+                int shift_w = c == 0 ? 0 : desc->log2_chroma_w;
+                int shift_h = c == 0 ? 0 : desc->log2_chroma_h;
+                plane.width = -((-width) >> shift_w);
+                plane.height = -((-height) >> shift_h);
+                plane.stride = (plane.width + 63) & ~63;
+                plane.offset = offset;
+                offset += static_cast<size_t>(plane.stride) * plane.height;
+            }
+            return static_cast<GLsizeiptr>(offset);
+        }
+
+        static void AllocatePlane(int width, int height) {
+            if (GLEW_ARB_texture_storage) {
+                glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, width, height);
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+            }
+        }
+
+        GLuint program = 0;
+        int width = 0;
+        int height = 0;
+        int depth = 0;
+        int head = 0;
+        int pending = 0;
+        int out_shift_w = 0;
+        int out_shift_h = 0;
+        GLint chroma_pass_location = -1;
+        GLint frame_size_location = -1;
+        GLint luma_shift_location = -1;
+        GLsizeiptr upload_bytes = 0;
+        GLsizeiptr readback_bytes = 0;
+        std::array<Plane, 3> inputs;
+        std::array<Plane, 3> outputs;
+        GLuint luma_fbo = 0;
+        GLuint chroma_fbo = 0;
+        std::vector<GLuint> uploads;
+        std::vector<GLuint> readbacks;
+        std::vector<GLsync> fences;
+    };
+}
@@ -38,39 +38,79 @@ const createWindow = () => {
     });
 }
 
+// One long-lived processor in batch mode takes every file, so the GL context, shader and
+// offset maps are set up once instead of once per file. Jobs go in as JSON lines on stdin;
+// records come back as JSON lines on stdout, tagged with the job id (the file's index).
+var batchProcess = null;
+
+const processor = () => {
+    if (batchProcess)
+        return batchProcess;
+
+    var processorName = "video_processor";
+
+    if (process.platform === "win32") 
+        processorName = "video_processor.exe";
+
+    const binaryPath = app.isPackaged
+        ? path.join(process.resourcesPath, processorName)
+        : path.join(__dirname, processorName);
+
+    // Parallel GL jobs need headless EGL contexts, which only Linux builds can have; the
+    // processor falls back to one job when it was built without them.
+    const args = ['--batch', '--telemetry', '--telemetry-interval=10'];
+    if (process.platform === "linux")
+        args.push('--jobs=2');
+
+    const child = spawn(binaryPath, args);
+    batchProcess = child;
+
+    // A chunk may end mid-line.
+    let pending = '';
+    child.stdout.on('data', (data) => {
+      pending += data.toString();
+      const lines = pending.split('\n');
+      pending = lines.pop();
+      for (const line of lines) {
+        if (!line.trim()) continue;
+        let record;
+        try {
+          record = JSON.parse(line);
+        } catch (err) {
+          console.error(`Unreadable processor line: ${line}`);
+          continue;
+        }
+        const index = Number(record.job);
+        if (record.event === 'progress' && record.percent >= 0) {
+          win.webContents.send('update-file-status', {percent: record.percent, index: index});
+        } else if (record.event === 'job' && record.ok) {
+          win.webContents.send('update-file-status', {percent: 'Finished processing', index: index});
+        } else if (record.event === 'job') {
+          console.error(`Job ${record.job} failed${record.error ? ': ' + record.error : ''}`);
+        }
+      }
+    });
+    
+    child.stderr.on('data', (data) => {
+      console.error(`Child process stderr: ${data.toString()}`);
+    });
+    
+    child.on('close', (code) => {
+      console.log(`Child process exited with code ${code}`);
+      if (batchProcess === child) batchProcess = null;
+    });
+    
+    child.on('error', (err) => {
+      console.error('Failed to start child process:', err);
+      if (batchProcess === child) batchProcess = null;
+    });
+    return child;
+}
+
 app.whenReady().then(() => {
     ipcMain.handle('encode', (trash, filePath, newFile, token, index) => {
-        var processorName = "video_processor";
-
-        if (process.platform === "win32") 
-            processorName = "video_processor.exe";
-
-        const binaryPath = app.isPackaged
-            ? path.join(process.resourcesPath, processorName)
-            : path.join(__dirname, processorName);
-
-        console.log(`${binaryPath} "${filePath}" "${newFile}" "${token}"`);
-
-        const child = spawn(binaryPath, [filePath, newFile, token]);
-
-        child.stdout.on('data', (data) => {
-          // 'data' will contain a Buffer, convert it to a string
-          console.log(`Child process stdout: ${data.toString()}`);
-          win.webContents.send('update-file-status', {percent: data.toString(), index: index});
-          // You can send this data to your Electron renderer process using IPC
-        });
-        
-        child.stderr.on('data', (data) => {
-          console.error(`Child process stderr: ${data.toString()}`);
-        });
-        
-        child.on('close', (code) => {
-          console.log(`Child process exited with code ${code}`);
-        });
-        
-        child.on('error', (err) => {
-          console.error('Failed to start child process:', err);
-        });
+        console.log(`job ${index}: "${filePath}" "${newFile}" "${token}"`);
+        processor().stdin.write(JSON.stringify({id: String(index), input: filePath, output: newFile, seed: token}) + '\n');
     })
 
     ipcMain.handle('ffmpeg', () => {
@@ -105,3 +145,8 @@ app.on('window-all-closed', () => {
     if (process.platform !== 'darwin') app.quit()
 })
 
+// Closing stdin lets the processor finish the jobs it has and exit.
+app.on('will-quit', () => {
+    if (batchProcess) batchProcess.stdin.end();
+})
+